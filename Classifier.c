@@ -0,0 +1,203 @@
+/**
+ * This file implements the frame classifier described in Classifier.h.  A frame's four
+ * addresses are packed into one 256-bit vector (or two 128-bit vectors), so every reference
+ * address is compared against all four addresses of a frame at once and the comparison
+ * results land directly in the frame's mask, four bits per reference.
+ *
+ * Each implementation is compiled for its own instruction set with the target attribute,
+ * so the file builds without special flags and runs on any x86-64 CPU.  Other architectures
+ * use the scalar implementation.
+ */
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define CLASSIFIER_X86
+#endif
+
+#include "Classifier.h"
+
+/**
+ * Classifies frames one address at a time.
+ */
+static void classifyFramesScalar(const Classifier *classifier, const FrameAddresses *frames, int count, uint32_t *masks) {
+  int      frameIndex;
+  int      reference;
+  int      address;
+  uint32_t mask;
+
+  for(frameIndex = 0; frameIndex < count; frameIndex++) {
+    mask = 0;
+
+    for(address = 0; address < CLASSIFY_ADDRESSES; address++) {
+      for(reference = 0; reference < classifier->referenceCount; reference++) {
+        if(MAC_EQUALS(frames[frameIndex].addresses[address], classifier->references[reference])) {
+          mask |= CLASSIFY_MATCH(reference, address);
+        }
+      }
+
+      if((frames[frameIndex].addresses[address] & (CLASSIFY_GROUP_BIT | CLASSIFY_NO_ADDRESS)) == CLASSIFY_GROUP_BIT) {
+        mask |= CLASSIFY_GROUP(address);
+      }
+    }
+
+    masks[frameIndex] = mask;
+  }
+}
+
+#ifdef CLASSIFIER_X86
+/**
+ * Compares two pairs of 64-bit lanes for equality using only SSE2, which has no 64-bit
+ * compare: both 32-bit halves of a lane must match.
+ */
+__attribute__((target("sse2")))
+static inline __m128i compareEqual64Sse2(__m128i left, __m128i right) {
+  __m128i halves = _mm_cmpeq_epi32(left, right);
+
+  return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+/**
+ * Classifies frames two addresses per 128-bit vector.
+ */
+__attribute__((target("sse2")))
+static void classifyFramesSse2(const Classifier *classifier, const FrameAddresses *frames, int count, uint32_t *masks) {
+  const __m128i groupBits = _mm_set1_epi64x(CLASSIFY_GROUP_BIT | CLASSIFY_NO_ADDRESS);
+  const __m128i groupOnly = _mm_set1_epi64x(CLASSIFY_GROUP_BIT);
+  __m128i       references[NETFREE_CLASSIFIER_MAX_REFERENCES];
+  __m128i       low;
+  __m128i       high;
+  uint32_t      mask;
+  int           frameIndex;
+  int           reference;
+
+  for(reference = 0; reference < classifier->referenceCount; reference++) {
+    references[reference] = _mm_set1_epi64x(classifier->references[reference]);
+  }
+
+  for(frameIndex = 0; frameIndex < count; frameIndex++) {
+    low = _mm_load_si128((const __m128i *) &frames[frameIndex].addresses[0]);
+    high = _mm_load_si128((const __m128i *) &frames[frameIndex].addresses[2]);
+
+    mask = 0;
+    for(reference = 0; reference < classifier->referenceCount; reference++) {
+      mask |= (uint32_t) (_mm_movemask_pd(_mm_castsi128_pd(compareEqual64Sse2(low, references[reference])))
+            | (_mm_movemask_pd(_mm_castsi128_pd(compareEqual64Sse2(high, references[reference]))) << 2)) << (reference * CLASSIFY_ADDRESSES);
+    }
+
+    mask |= (uint32_t) (_mm_movemask_pd(_mm_castsi128_pd(compareEqual64Sse2(_mm_and_si128(low, groupBits), groupOnly)))
+          | (_mm_movemask_pd(_mm_castsi128_pd(compareEqual64Sse2(_mm_and_si128(high, groupBits), groupOnly))) << 2)) << (NETFREE_CLASSIFIER_MAX_REFERENCES * CLASSIFY_ADDRESSES);
+
+    masks[frameIndex] = mask;
+  }
+}
+
+/**
+ * Classifies frames with all four addresses of a frame in one 256-bit vector.
+ */
+__attribute__((target("avx2")))
+static void classifyFramesAvx2(const Classifier *classifier, const FrameAddresses *frames, int count, uint32_t *masks) {
+  const __m256i groupBits = _mm256_set1_epi64x(CLASSIFY_GROUP_BIT | CLASSIFY_NO_ADDRESS);
+  const __m256i groupOnly = _mm256_set1_epi64x(CLASSIFY_GROUP_BIT);
+  __m256i       references[NETFREE_CLASSIFIER_MAX_REFERENCES];
+  __m256i       addresses;
+  uint32_t      mask;
+  int           frameIndex;
+  int           reference;
+
+  for(reference = 0; reference < classifier->referenceCount; reference++) {
+    references[reference] = _mm256_set1_epi64x(classifier->references[reference]);
+  }
+
+  for(frameIndex = 0; frameIndex < count; frameIndex++) {
+    addresses = _mm256_load_si256((const __m256i *) frames[frameIndex].addresses);
+
+    mask = 0;
+    for(reference = 0; reference < classifier->referenceCount; reference++) {
+      mask |= (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(addresses, references[reference]))) << (reference * CLASSIFY_ADDRESSES);
+    }
+
+    mask |= (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(addresses, groupBits), groupOnly))) << (NETFREE_CLASSIFIER_MAX_REFERENCES * CLASSIFY_ADDRESSES);
+
+    masks[frameIndex] = mask;
+  }
+}
+#endif
+
+/**
+ * Switches a classifier to one of its implementations.  Every implementation produces the
+ * same masks, so this is only needed to compare or benchmark them.
+ *
+ * @param classifier (Classifier *) - an initialized classifier
+ * @param implementation (const char *) - "scalar", "sse2" or "avx2"
+ *
+ * @return (int) 0 on success, -1 if the implementation is unknown or the CPU does not
+ *  support it
+ */
+int setClassifierImplementation(Classifier *classifier, const char *implementation) {
+  if(!strcmp(implementation, "scalar")) {
+    classifier->classify = classifyFramesScalar;
+    classifier->implementation = "scalar";
+
+    return 0;
+  }
+
+#ifdef CLASSIFIER_X86
+  __builtin_cpu_init();
+  if(!strcmp(implementation, "avx2") && __builtin_cpu_supports("avx2")) {
+    classifier->classify = classifyFramesAvx2;
+    classifier->implementation = "avx2";
+
+    return 0;
+  }
+
+  if(!strcmp(implementation, "sse2") && __builtin_cpu_supports("sse2")) {
+    classifier->classify = classifyFramesSse2;
+    classifier->implementation = "sse2";
+
+    return 0;
+  }
+#endif
+
+  return -1;
+}
+
+/**
+ * Initializes a classifier for the specified reference addresses and picks the fastest
+ * implementation the CPU supports.
+ *
+ * @param classifier (Classifier *) - the classifier to initialize
+ * @param references (const MacAddress *) - the addresses frames are compared against.  The
+ *  index of a reference is the reference argument of CLASSIFY_MATCH().
+ * @param referenceCount (int) - the number of references, at most
+ *  NETFREE_CLASSIFIER_MAX_REFERENCES
+ *
+ * @return (int) 0 on success, -1 if there are too many references
+ */
+int initClassifier(Classifier *classifier, const MacAddress *references, int referenceCount) {
+  if(referenceCount > NETFREE_CLASSIFIER_MAX_REFERENCES) {
+    return -1;
+  }
+
+  memset(classifier, 0, sizeof(Classifier));
+  memcpy(classifier->references, references, referenceCount * sizeof(MacAddress));
+  classifier->referenceCount = referenceCount;
+
+  if(setClassifierImplementation(classifier, "avx2") && setClassifierImplementation(classifier, "sse2")) {
+    setClassifierImplementation(classifier, "scalar");
+  }
+
+  return 0;
+}
+
+/**
+ * Classifies a batch of frames.
+ *
+ * @param classifier (const Classifier *) - the classifier to use
+ * @param frames (const FrameAddresses *) - the addresses of every frame
+ * @param count (int) - the number of frames
+ * @param masks (uint32_t *) - where the mask of every frame is stored
+ */
+void classifyFrames(const Classifier *classifier, const FrameAddresses *frames, int count, uint32_t *masks) {
+  classifier->classify(classifier, frames, count, masks);
+}
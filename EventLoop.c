@@ -0,0 +1,298 @@
+/**
+ * This file implements the event loop described in EventLoop.h.  Every source is registered
+ * with epoll with a pointer to its EventSource, and the loop's own eventfd is registered
+ * with a NULL pointer so a stop request only wakes the loop up.  The loop owns the timerfds
+ * and signalfds it creates and closes them when they are removed; descriptors added by the
+ * caller remain the caller's to close.
+ */
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "EventLoop.h"
+
+/**
+ * Initializes an event loop without any source.
+ *
+ * @param loop (EventLoop *) - the loop to initialize
+ *
+ * @return (int) 0 on success, -1 otherwise
+ */
+int initEventLoop(EventLoop *loop) {
+  struct epoll_event event;
+  int                slot;
+
+  memset(loop, 0, sizeof(EventLoop));
+  for(slot = 0; slot < NETFREE_EVENT_SOURCES; slot++) {
+    loop->sources[slot].descriptor = -1;
+  }
+
+  loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+  loop->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+
+  if(loop->epoll == -1 || loop->wake == -1 || epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->wake, &event)) {
+    destroyEventLoop(loop);
+
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Releases every resource held by the loop, including the timers and signalfds it created.
+ * The loop must not be running.
+ *
+ * @param loop (EventLoop *) - the loop to destroy
+ */
+void destroyEventLoop(EventLoop *loop) {
+  int slot;
+
+  for(slot = 0; slot < NETFREE_EVENT_SOURCES; slot++) {
+    if(loop->sources[slot].descriptor != -1 && loop->sources[slot].kind != EVENT_SOURCE_DESCRIPTOR) {
+      close(loop->sources[slot].descriptor);
+    }
+
+    loop->sources[slot].descriptor = -1;
+  }
+
+  if(loop->epoll != -1) {
+    close(loop->epoll);
+  }
+
+  if(loop->wake != -1) {
+    close(loop->wake);
+  }
+
+  loop->epoll = -1;
+  loop->wake = -1;
+}
+
+/**
+ * Registers a descriptor with the loop in a free slot.
+ *
+ * @return (int) the descriptor, or -1 if every slot is in use or epoll refused it
+ */
+static int addEventSource(EventLoop *loop, int descriptor, int kind, uint32_t events, EventHandler handler, void *context) {
+  struct epoll_event  event;
+  EventSource        *source = NULL;
+  int                 slot;
+
+  for(slot = 0; slot < NETFREE_EVENT_SOURCES && !source; slot++) {
+    if(loop->sources[slot].descriptor == -1) {
+      source = &loop->sources[slot];
+    }
+  }
+
+  if(!source || descriptor == -1) {
+    return -1;
+  }
+
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.ptr = source;
+  if(epoll_ctl(loop->epoll, EPOLL_CTL_ADD, descriptor, &event)) {
+    return -1;
+  }
+
+  source->descriptor = descriptor;
+  source->kind = kind;
+  source->handler = handler;
+  source->context = context;
+
+  return descriptor;
+}
+
+/**
+ * Calls handler whenever descriptor is ready.
+ *
+ * @param loop (EventLoop *) - the loop
+ * @param descriptor (int) - the descriptor to watch, which stays owned by the caller
+ * @param events (uint32_t) - the epoll events to watch for (EPOLLIN, ...)
+ * @param handler (EventHandler) - the function to call
+ * @param context (void *) - passed to handler
+ *
+ * @return (int) descriptor, or -1 if it could not be added
+ */
+int addEventDescriptor(EventLoop *loop, int descriptor, uint32_t events, EventHandler handler, void *context) {
+  return addEventSource(loop, descriptor, EVENT_SOURCE_DESCRIPTOR, events, handler, context);
+}
+
+/**
+ * Calls handler every interval milliseconds, starting interval milliseconds from now.  If
+ * the loop falls behind, the handler is called once with the number of intervals that
+ * elapsed.
+ *
+ * @param loop (EventLoop *) - the loop
+ * @param interval (int) - the interval, in milliseconds
+ * @param handler (EventHandler) - the function to call
+ * @param context (void *) - passed to handler
+ *
+ * @return (int) the timerfd, which identifies the timer to removeEventSource(), or -1 if
+ *  the timer could not be created
+ */
+int addEventTimer(EventLoop *loop, int interval, EventHandler handler, void *context) {
+  struct itimerspec timer;
+  int               descriptor;
+
+  if(interval <= 0) {
+    return -1;
+  }
+
+  descriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if(descriptor == -1) {
+    return -1;
+  }
+
+  timer.it_interval.tv_sec = interval / 1000;
+  timer.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+  timer.it_value = timer.it_interval;
+
+  if(timerfd_settime(descriptor, 0, &timer, NULL) || addEventSource(loop, descriptor, EVENT_SOURCE_TIMER, EPOLLIN, handler, context) == -1) {
+    close(descriptor);
+
+    return -1;
+  }
+
+  return descriptor;
+}
+
+/**
+ * Calls handler, with the signal's number, whenever one of the signals is received.  The
+ * signals are blocked in the calling thread; they must already be blocked in every other
+ * thread, or those threads may still take them the usual way.
+ *
+ * @param loop (EventLoop *) - the loop
+ * @param signals (sigset_t *) - the signals to receive
+ * @param handler (EventHandler) - the function to call
+ * @param context (void *) - passed to handler
+ *
+ * @return (int) the signalfd, or -1 if it could not be created
+ */
+int addEventSignals(EventLoop *loop, sigset_t *signals, EventHandler handler, void *context) {
+  int descriptor;
+
+  if(pthread_sigmask(SIG_BLOCK, signals, NULL)) {
+    return -1;
+  }
+
+  descriptor = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if(descriptor == -1) {
+    return -1;
+  }
+
+  if(addEventSource(loop, descriptor, EVENT_SOURCE_SIGNALS, EPOLLIN, handler, context) == -1) {
+    close(descriptor);
+
+    return -1;
+  }
+
+  return descriptor;
+}
+
+/**
+ * Stops watching a source.  Timers and signalfds are closed; other descriptors are not.
+ *
+ * @param loop (EventLoop *) - the loop
+ * @param descriptor (int) - the descriptor returned when the source was added
+ */
+void removeEventSource(EventLoop *loop, int descriptor) {
+  EventSource *source;
+
+  for(source = loop->sources; source < loop->sources + NETFREE_EVENT_SOURCES; source++) {
+    if(descriptor == -1 || source->descriptor != descriptor) {
+      continue;
+    }
+
+    epoll_ctl(loop->epoll, EPOLL_CTL_DEL, descriptor, NULL);
+    if(source->kind != EVENT_SOURCE_DESCRIPTOR) {
+      close(descriptor);
+    }
+
+    source->descriptor = -1;
+  }
+}
+
+/**
+ * Calls the handler of a ready source.
+ */
+static void dispatchEventSource(EventLoop *loop, EventSource *source, uint32_t events) {
+  struct signalfd_siginfo received;
+  uint64_t                expirations;
+
+  if(source->kind == EVENT_SOURCE_TIMER) {
+    if(read(source->descriptor, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+      source->handler(loop, source->context, expirations);
+    }
+  } else if(source->kind == EVENT_SOURCE_SIGNALS) {
+    while(source->descriptor != -1 && read(source->descriptor, &received, sizeof(received)) == sizeof(received)) {
+      source->handler(loop, source->context, received.ssi_signo);
+    }
+  } else {
+    source->handler(loop, source->context, events);
+  }
+}
+
+/**
+ * Waits for sources to become ready and calls their handlers until stopEventLoop() is
+ * called.
+ *
+ * @param loop (EventLoop *) - the loop to run
+ *
+ * @return (int) the status passed to stopEventLoop(), or -1 if waiting failed
+ */
+int runEventLoop(EventLoop *loop) {
+  struct epoll_event  events[NETFREE_EVENT_SOURCES + 1];
+  EventSource        *source;
+  int                 count;
+  int                 eventIndex;
+
+  while(!__atomic_load_n(&loop->stopped, __ATOMIC_ACQUIRE)) {
+    count = epoll_wait(loop->epoll, events, NETFREE_EVENT_SOURCES + 1, -1);
+    if(count == -1) {
+      if(errno == EINTR) {
+        continue;
+      }
+
+      return -1;
+    }
+
+    for(eventIndex = 0; eventIndex < count && !__atomic_load_n(&loop->stopped, __ATOMIC_ACQUIRE); eventIndex++) {
+      source = (EventSource *) events[eventIndex].data.ptr;
+
+      // A handler earlier in this round may have removed the source.
+      if(source && source->descriptor != -1) {
+        dispatchEventSource(loop, source, events[eventIndex].events);
+      }
+    }
+  }
+
+  return loop->status;
+}
+
+/**
+ * Makes runEventLoop() return status once the handler it is running, if any, returns.  Any
+ * thread may stop a loop, including the handlers of the loop itself.
+ *
+ * @param loop (EventLoop *) - the loop to stop
+ * @param status (int) - what runEventLoop() should return
+ */
+void stopEventLoop(EventLoop *loop, int status) {
+  uint64_t wake = 1;
+  ssize_t  written;
+
+  loop->status = status;
+  __atomic_store_n(&loop->stopped, 1, __ATOMIC_RELEASE);
+
+  written = write(loop->wake, &wake, sizeof(wake));
+  (void) written;
+}
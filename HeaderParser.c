@@ -0,0 +1,374 @@
+/**
+ * This file parses the headers described in HeaderParser.h.
+ *
+ * A radiotap header is a version byte, a pad byte, the header's length, and one or more
+ * 32-bit "present" bitmaps (each bitmap with bit 31 set is followed by another).  The data
+ * for every field whose bit is set follows the last bitmap, in bit order, each field aligned
+ * to its natural boundary relative to the start of the header.  Bits 29 and 30 switch the
+ * namespace of the next bitmap back to radiotap or to a vendor namespace, respectively.  A
+ * vendor namespace starts with a 6 byte header (OUI, sub-namespace and the length of the
+ * vendor's data) so that readers that do not understand it can skip its data entirely.
+ *
+ * An 802.11 header's layout depends only on its frame control field: the type and subtype
+ * say whether it is a data frame and whether it has a QoS field, To DS and From DS say
+ * whether there is a fourth address and which address is the BSSID, and the Order bit of a
+ * QoS data frame adds an HT control field.  frameLayouts holds that layout for every
+ * combination of the bits involved, computed at compile time, so decoding a frame is one
+ * table lookup and rejecting anything but a data frame costs nothing more.
+ */
+#include <stddef.h>
+#include <string.h>
+#include <endian.h>
+
+#include "HeaderParser.h"
+
+#define RADIOTAP_ALIGN(offset, alignment)   (((offset) + (alignment) - 1) & ~((alignment) - 1))
+#define RADIOTAP_VENDOR_HEADER_SIZE         6
+#define RADIOTAP_LAST_WANTED_FIELD          RADIOTAP_DBM_ANTSIGNAL
+
+#define WIFI_ADDR1_OFFSET                   4
+#define WIFI_ADDR2_OFFSET                   10
+#define WIFI_ADDR3_OFFSET                   16
+#define WIFI_BASE_HEADER_SIZE               24      // Frame control through sequence control
+#define WIFI_ADDR4_OFFSET                   24      // Only in frames with both To DS and From DS
+#define WIFI_IV_SIZE                        4       // WEP; TKIP and CCMP/GCMP add an extended IV
+#define WIFI_EXT_IV_SIZE                    8
+#define WIFI_EXT_IV                         0x20    // In the fourth byte of the IV
+
+typedef struct RadioTapFieldLayoutStruct {
+  u_int8_t alignment;
+  u_int8_t size;
+} RadioTapFieldLayout;
+
+/**
+ * The alignment and size of every field defined in the radiotap namespace.  A size of 0
+ * marks a field whose layout is unknown (or variable, like TLVs), past which a header cannot
+ * be walked.
+ */
+static const RadioTapFieldLayout radioTapFieldLayouts[32] = {
+  [RADIOTAP_TSFT]               = {8, 8},
+  [RADIOTAP_FLAGS]              = {1, 1},
+  [RADIOTAP_RATE]               = {1, 1},
+  [RADIOTAP_CHANNEL]            = {2, 4},
+  [RADIOTAP_FHSS]               = {1, 2},
+  [RADIOTAP_DBM_ANTSIGNAL]      = {1, 1},
+  [RADIOTAP_DBM_ANTNOISE]       = {1, 1},
+  [RADIOTAP_LOCK_QUALITY]       = {2, 2},
+  [RADIOTAP_TX_ATTENUATION]     = {2, 2},
+  [RADIOTAP_DB_TX_ATTENUATION]  = {2, 2},
+  [RADIOTAP_DBM_TX_POWER]       = {1, 1},
+  [RADIOTAP_ANTENNA]            = {1, 1},
+  [RADIOTAP_DB_ANTSIGNAL]       = {1, 1},
+  [RADIOTAP_DB_ANTNOISE]        = {1, 1},
+  [RADIOTAP_RX_FLAGS]           = {2, 2},
+  [RADIOTAP_TX_FLAGS]           = {2, 2},
+  [RADIOTAP_RTS_RETRIES]        = {1, 1},
+  [RADIOTAP_DATA_RETRIES]       = {1, 1},
+  [RADIOTAP_XCHANNEL]           = {4, 8},
+  [RADIOTAP_MCS]                = {1, 3},
+  [RADIOTAP_AMPDU_STATUS]       = {4, 8},
+  [RADIOTAP_VHT]                = {2, 12},
+  [RADIOTAP_TIMESTAMP]          = {8, 12},
+  [RADIOTAP_HE]                 = {2, 12},
+  [RADIOTAP_HE_MU]              = {2, 12},
+  [RADIOTAP_HE_MU_OTHER_USER]   = {2, 6},
+  [RADIOTAP_ZERO_LENGTH_PSDU]   = {1, 1},
+  [RADIOTAP_LSIG]               = {2, 4}
+};
+
+typedef struct FrameLayoutStruct {
+  u_int8_t headerLength;        // 0 for frames decodeFrame() rejects
+  u_int8_t bssidOffset;         // 0 if the frame carries no BSSID
+  u_int8_t typeAndSubtype;
+  u_int8_t flags;               // FRAME_QOS, FRAME_HT_CONTROL, FRAME_TO_DS and FRAME_FROM_DS
+} FrameLayout;
+
+/**
+ * frameLayouts is indexed by the first byte of the frame control field, with To DS and From
+ * DS as bits 8 and 9 and Order as bit 10 (see FRAME_LAYOUT_INDEX()).
+ */
+#define FRAME_LAYOUT_INDEX(fc0, fc1)  ((fc0) | (((fc1) & (WIFI_FC_TO_DS | WIFI_FC_FROM_DS)) << 8) | (((fc1) & WIFI_FC_ORDER) << 3))
+#define FRAME_LAYOUTS                 2048
+
+#define LAYOUT_FC0(index)             ((index) & 0xff)
+#define LAYOUT_DS(index)              (((index) >> 8) & 0x03)
+#define LAYOUT_ORDER(index)           (((index) >> 10) & 0x01)
+#define LAYOUT_IS_DATA(index)         (WIFI_FC_VERSION(LAYOUT_FC0(index)) == 0 && WIFI_FC_TYPE(LAYOUT_FC0(index)) == WIFI_TYPE_DATA)
+#define LAYOUT_IS_QOS(index)          ((WIFI_FC_SUBTYPE(LAYOUT_FC0(index)) & WIFI_SUBTYPE_QOS) != 0)
+#define LAYOUT_HAS_HTC(index)         (LAYOUT_IS_QOS(index) && LAYOUT_ORDER(index))
+
+#define FRAME_LAYOUT(index) { \
+  LAYOUT_IS_DATA(index) ? WIFI_BASE_HEADER_SIZE + (LAYOUT_DS(index) == 3 ? NETFREE_MAC_SIZE : 0) + (LAYOUT_IS_QOS(index) ? 2 : 0) + (LAYOUT_HAS_HTC(index) ? 4 : 0) : 0, \
+  LAYOUT_DS(index) == 0 ? WIFI_ADDR3_OFFSET : LAYOUT_DS(index) == 1 ? WIFI_ADDR1_OFFSET : LAYOUT_DS(index) == 2 ? WIFI_ADDR2_OFFSET : 0, \
+  (WIFI_FC_TYPE(LAYOUT_FC0(index)) << 4) | WIFI_FC_SUBTYPE(LAYOUT_FC0(index)), \
+  (LAYOUT_IS_QOS(index) ? FRAME_QOS : 0) | (LAYOUT_HAS_HTC(index) ? FRAME_HT_CONTROL : 0) | ((LAYOUT_DS(index) & 1) ? FRAME_TO_DS : 0) | ((LAYOUT_DS(index) & 2) ? FRAME_FROM_DS : 0) \
+}
+
+#define FRAME_LAYOUTS_4(index)        FRAME_LAYOUT(index), FRAME_LAYOUT((index) + 1), FRAME_LAYOUT((index) + 2), FRAME_LAYOUT((index) + 3)
+#define FRAME_LAYOUTS_16(index)       FRAME_LAYOUTS_4(index), FRAME_LAYOUTS_4((index) + 4), FRAME_LAYOUTS_4((index) + 8), FRAME_LAYOUTS_4((index) + 12)
+#define FRAME_LAYOUTS_64(index)       FRAME_LAYOUTS_16(index), FRAME_LAYOUTS_16((index) + 16), FRAME_LAYOUTS_16((index) + 32), FRAME_LAYOUTS_16((index) + 48)
+#define FRAME_LAYOUTS_256(index)      FRAME_LAYOUTS_64(index), FRAME_LAYOUTS_64((index) + 64), FRAME_LAYOUTS_64((index) + 128), FRAME_LAYOUTS_64((index) + 192)
+#define FRAME_LAYOUTS_1024(index)     FRAME_LAYOUTS_256(index), FRAME_LAYOUTS_256((index) + 256), FRAME_LAYOUTS_256((index) + 512), FRAME_LAYOUTS_256((index) + 768)
+
+static const FrameLayout frameLayouts[FRAME_LAYOUTS] = {
+  FRAME_LAYOUTS_1024(0), FRAME_LAYOUTS_1024(1024)
+};
+
+/**
+ * Reads a little-endian 32-bit word from a possibly unaligned location.
+ */
+static inline u_int32_t readLe32(const u_char *location) {
+  u_int32_t value;
+
+  memcpy(&value, location, sizeof(value));
+
+  return le32toh(value);
+}
+
+/**
+ * Prepares an iterator over the fields of a radiotap header.
+ *
+ * @param iterator (RadioTapIterator *) - the iterator to initialize
+ * @param packet (const u_char *) - the captured frame, starting with its radiotap header
+ * @param length (unsigned int) - the number of bytes captured
+ *
+ * @return (int) 0 on success.  -1 is returned if the header is truncated or malformed.
+ */
+int initRadioTapIterator(RadioTapIterator *iterator, const u_char *packet, unsigned int length) {
+  const RadioTapHeader *radioTapHeader = (const RadioTapHeader *) packet;
+  const u_char         *presentWord;
+  unsigned int          headerLength;
+
+  if(length < sizeof(RadioTapHeader) || radioTapHeader->version != 0) {
+    return -1;
+  }
+
+  headerLength = le16toh(radioTapHeader->headerLength);
+  if(headerLength < sizeof(RadioTapHeader) || headerLength > length) {
+    return -1;
+  }
+
+  iterator->header = packet;
+  iterator->end = packet + headerLength;
+
+  // The field data starts after the last present bitmap.
+  presentWord = packet + offsetof(RadioTapHeader, dataFieldsPresent);
+  while(readLe32(presentWord) & (1U << RADIOTAP_EXT)) {
+    presentWord += sizeof(u_int32_t);
+    if(presentWord + sizeof(u_int32_t) > iterator->end) {
+      return -1;
+    }
+  }
+
+  iterator->data = presentWord + sizeof(u_int32_t);
+  iterator->presentWord = readLe32(packet + offsetof(RadioTapHeader, dataFieldsPresent));
+  iterator->remainingBits = iterator->presentWord & ~(1U << RADIOTAP_EXT);
+  iterator->nextPresentWord = packet + offsetof(RadioTapHeader, dataFieldsPresent) + sizeof(u_int32_t);
+  iterator->vendorNamespaceEnd = NULL;
+  iterator->wordIndex = 0;
+  iterator->inVendorNamespace = 0;
+  iterator->nextNamespace = RADIOTAP_RADIOTAP_NAMESPACE;
+  iterator->fieldIndex = -1;
+  iterator->fieldData = NULL;
+  iterator->fieldSize = 0;
+
+  return 0;
+}
+
+/**
+ * Advances the iterator to the next field present in the radiotap namespace.  Fields of
+ * vendor namespaces are skipped as a whole using the length in the vendor namespace header.
+ *
+ * @param iterator (RadioTapIterator *) - the iterator to advance
+ *
+ * @return (int) 1 if the iterator now points at a field, 0 if every field has been visited,
+ *  or -1 if the header is truncated or contains a field whose layout is unknown
+ */
+int nextRadioTapField(RadioTapIterator *iterator) {
+  const RadioTapFieldLayout *layout;
+  unsigned int               offset;
+  int                        bit;
+
+  while(1) {
+    if(!iterator->remainingBits) {
+      if(!(iterator->presentWord & (1U << RADIOTAP_EXT))) {
+        return 0;
+      }
+
+      // Move on to the next present bitmap and the namespace it belongs to.
+      iterator->presentWord = readLe32(iterator->nextPresentWord);
+      iterator->remainingBits = iterator->presentWord & ~(1U << RADIOTAP_EXT);
+      iterator->nextPresentWord += sizeof(u_int32_t);
+      iterator->wordIndex++;
+
+      iterator->inVendorNamespace = (iterator->nextNamespace == RADIOTAP_VENDOR_NAMESPACE);
+      if(iterator->vendorNamespaceEnd) {
+        // A vendor namespace starts here; skip all of its data.
+        iterator->data = iterator->vendorNamespaceEnd;
+        iterator->vendorNamespaceEnd = NULL;
+      }
+
+      continue;
+    }
+
+    bit = __builtin_ctz(iterator->remainingBits);
+    iterator->remainingBits &= iterator->remainingBits - 1;
+
+    if(bit == RADIOTAP_RADIOTAP_NAMESPACE) {
+      iterator->nextNamespace = RADIOTAP_RADIOTAP_NAMESPACE;
+      continue;
+    }
+
+    if(bit == RADIOTAP_VENDOR_NAMESPACE) {
+      // The vendor namespace header is a field of the current namespace.
+      offset = RADIOTAP_ALIGN(iterator->data - iterator->header, 2);
+      if(iterator->header + offset + RADIOTAP_VENDOR_HEADER_SIZE > iterator->end) {
+        return -1;
+      }
+
+      iterator->data = iterator->header + offset + RADIOTAP_VENDOR_HEADER_SIZE;
+      iterator->vendorNamespaceEnd = iterator->data + (iterator->header[offset + 4] | (iterator->header[offset + 5] << 8));
+      if(iterator->vendorNamespaceEnd > iterator->end) {
+        return -1;
+      }
+
+      iterator->nextNamespace = RADIOTAP_VENDOR_NAMESPACE;
+      continue;
+    }
+
+    if(iterator->inVendorNamespace) {
+      // Its data was skipped as a whole when the namespace was entered.
+      continue;
+    }
+
+    layout = &radioTapFieldLayouts[bit];
+    if(!layout->size) {
+      return -1;
+    }
+
+    offset = RADIOTAP_ALIGN(iterator->data - iterator->header, layout->alignment);
+    if(iterator->header + offset + layout->size > iterator->end) {
+      return -1;
+    }
+
+    iterator->fieldIndex = bit;
+    iterator->fieldData = iterator->header + offset;
+    iterator->fieldSize = layout->size;
+    iterator->data = iterator->fieldData + layout->size;
+
+    return 1;
+  }
+}
+
+/**
+ * Extracts the TSFT, flags, rate, channel and antenna signal from a radiotap header in a
+ * single pass.  Only the first present bitmap is walked: every wanted field lives there, and
+ * later radiotap bitmaps only repeat fields per antenna.
+ *
+ * @param packet (const u_char *) - the captured frame, starting with its radiotap header
+ * @param length (unsigned int) - the number of bytes captured
+ * @param fields (RadioTapFields *) - where the extracted fields are stored
+ *
+ * @return (int) the length of the radiotap header (i.e. the offset of the 802.11 header) on
+ *  success, or -1 if the header is truncated or malformed
+ */
+int parseRadioTap(const u_char *packet, unsigned int length, RadioTapFields *fields) {
+  RadioTapIterator iterator;
+  u_int64_t        tsft;
+  u_int16_t        channel[2];
+  int              status;
+
+  fields->present = 0;
+
+  if(initRadioTapIterator(&iterator, packet, length)) {
+    return -1;
+  }
+
+  // Fields past the wanted ones are never read, so an unknown field there does not matter.
+  iterator.remainingBits &= (1U << (RADIOTAP_LAST_WANTED_FIELD + 1)) - 1;
+  iterator.presentWord &= ~(1U << RADIOTAP_EXT);
+
+  while((status = nextRadioTapField(&iterator)) > 0) {
+    switch(iterator.fieldIndex) {
+      case RADIOTAP_TSFT:
+        memcpy(&tsft, iterator.fieldData, sizeof(tsft));
+        fields->tsft = le64toh(tsft);
+        break;
+      case RADIOTAP_FLAGS:
+        fields->flags = iterator.fieldData[0];
+        break;
+      case RADIOTAP_RATE:
+        fields->rate = iterator.fieldData[0];
+        break;
+      case RADIOTAP_CHANNEL:
+        memcpy(channel, iterator.fieldData, sizeof(channel));
+        fields->channelFrequency = le16toh(channel[0]);
+        fields->channelFlags = le16toh(channel[1]);
+        break;
+      case RADIOTAP_DBM_ANTSIGNAL:
+        fields->antennaSignal = (int8_t) iterator.fieldData[0];
+        break;
+      default:
+        continue;
+    }
+
+    fields->present |= 1U << iterator.fieldIndex;
+  }
+
+  if(status < 0) {
+    return -1;
+  }
+
+  return iterator.end - iterator.header;
+}
+
+/**
+ * Decodes the header of an 802.11 frame into a FrameDescriptor.  Only data frames are
+ * decoded; every other frame is rejected by the same table lookup that decodes them.
+ *
+ * @param header (const u_char *) - the 802.11 header (what follows the radiotap header)
+ * @param length (unsigned int) - the number of bytes captured from header on
+ * @param descriptor (FrameDescriptor *) - where the decoded frame is stored
+ *
+ * @return (int) 0 on success, FRAME_REJECT_TYPE if the frame is not a data frame or
+ *  FRAME_REJECT_TRUNCATED if too little of it was captured
+ */
+int decodeFrame(const u_char *header, unsigned int length, FrameDescriptor *descriptor) {
+  const FrameLayout *layout;
+  unsigned int       payloadOffset;
+
+  if(length < 2) {
+    return FRAME_REJECT_TRUNCATED;
+  }
+
+  layout = &frameLayouts[FRAME_LAYOUT_INDEX(header[0], header[1])];
+  if(!layout->headerLength) {
+    return FRAME_REJECT_TYPE;
+  }
+
+  payloadOffset = layout->headerLength;
+  if(header[1] & WIFI_FC_PROTECTED) {
+    // The IV says whether it is followed by an extended IV.
+    if(length < payloadOffset + WIFI_IV_SIZE) {
+      return FRAME_REJECT_TRUNCATED;
+    }
+
+    payloadOffset += (header[payloadOffset + 3] & WIFI_EXT_IV) ? WIFI_EXT_IV_SIZE : WIFI_IV_SIZE;
+  }
+
+  if(length < payloadOffset) {
+    return FRAME_REJECT_TRUNCATED;
+  }
+
+  descriptor->receiver = packMac(header + WIFI_ADDR1_OFFSET);
+  descriptor->transmitter = packMac(header + WIFI_ADDR2_OFFSET);
+  descriptor->bssid = layout->bssidOffset ? packMac(header + layout->bssidOffset) : 0;
+  descriptor->address4 = ((layout->flags & (FRAME_TO_DS | FRAME_FROM_DS)) == (FRAME_TO_DS | FRAME_FROM_DS)) ? packMac(header + WIFI_ADDR4_OFFSET) : 0;
+  descriptor->type = layout->typeAndSubtype >> 4;
+  descriptor->subtype = layout->typeAndSubtype & 0x0f;
+  descriptor->flags = layout->flags | ((header[1] & WIFI_FC_RETRY) ? FRAME_RETRY : 0) | ((header[1] & WIFI_FC_PROTECTED) ? FRAME_PROTECTED : 0);
+  descriptor->headerLength = layout->headerLength;
+  descriptor->payloadOffset = payloadOffset;
+
+  return 0;
+}
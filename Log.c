@@ -0,0 +1,278 @@
+/**
+ * This file implements the logging described in Log.h.  A thread's LogRing is allocated the
+ * first time the thread logs after logging is started, and every ring is freed when logging
+ * is stopped.  Rings are remembered per thread together with the generation they belong to,
+ * so a thread that outlives a stop simply registers a new ring the next time it logs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "Log.h"
+
+#define LOG_OUTPUT_SIZE   16384   // Bytes the logging thread gathers before each write
+
+LogRing     *logRings[NETFREE_LOG_MAX_THREADS];
+int          logRingCount;
+int          logGeneration;
+int          loggingStarted = 0;
+int          stopLogger;
+pthread_t    loggerThread;
+
+__thread LogRing *threadLogRing;
+__thread int      threadLogGeneration;
+__thread int      threadLogRegistered;    // Whether the thread tried to register in threadLogGeneration
+
+/**
+ * Returns the calling thread's ring, registering one if the thread does not have one yet.  A
+ * thread that could not register does not try again until logging is restarted.
+ *
+ * @return (LogRing *) the ring, or NULL if NETFREE_LOG_MAX_THREADS rings are registered or
+ *  memory could not be allocated
+ */
+LogRing *currentLogRing() {
+  LogRing *ring;
+  int      ringIndex;
+
+  if(threadLogRegistered && threadLogGeneration == logGeneration) {
+    return threadLogRing;
+  }
+
+  threadLogRing = NULL;
+  threadLogGeneration = logGeneration;
+  threadLogRegistered = 1;
+
+  ring = (LogRing *) aligned_alloc(NETFREE_CACHE_LINE_SIZE, sizeof(LogRing));
+  if(!ring) {
+    return NULL;
+  }
+
+  // Only claim a slot while one is free, so failed registrations never push the count past the limit.
+  ringIndex = __atomic_load_n(&logRingCount, __ATOMIC_RELAXED);
+  do {
+    if(ringIndex >= NETFREE_LOG_MAX_THREADS) {
+      free(ring);
+
+      return NULL;
+    }
+  } while(!__atomic_compare_exchange_n(&logRingCount, &ringIndex, ringIndex + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  memset(ring, 0, sizeof(LogRing));
+  __atomic_store_n(&logRings[ringIndex], ring, __ATOMIC_RELEASE);
+  threadLogRing = ring;
+
+  return ring;
+}
+
+/**
+ * Appends a record, as a line of text, to the logging thread's output.
+ *
+ * @param output (char *) - the output, which must have room for the record
+ * @param used (size_t) - the number of bytes of output already used
+ * @param record (LogRecord *) - the record to append
+ *
+ * @return (size_t) the number of bytes of output used afterwards
+ */
+size_t appendLogRecord(char *output, size_t used, LogRecord *record) {
+  memcpy(output + used, record->message, record->length);
+  used += record->length;
+
+  if(record->suppressed) {
+    used += sprintf(output + used, " (%u similar messages suppressed)", record->suppressed);
+  }
+
+  output[used++] = '\n';
+
+  return used;
+}
+
+/**
+ * Writes every record waiting in the rings to stderr, with a single write per
+ * LOG_OUTPUT_SIZE bytes of output.
+ *
+ * @return (int) the number of records written
+ */
+int drainLogRings() {
+  char      output[LOG_OUTPUT_SIZE];
+  size_t    used = 0;
+  LogRing  *ring;
+  uint64_t  head;
+  uint64_t  tail;
+  uint64_t  dropped;
+  int       ringCount = __atomic_load_n(&logRingCount, __ATOMIC_RELAXED);
+  int       ringIndex;
+  int       written = 0;
+
+  for(ringIndex = 0; ringIndex < ringCount; ringIndex++) {
+    ring = __atomic_load_n(&logRings[ringIndex], __ATOMIC_ACQUIRE);
+    if(!ring) {
+      continue;
+    }
+
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    for(; head != tail; head++, written++) {
+      if(used + sizeof(LogRecord) + 64 > sizeof(output)) {
+        fwrite(output, 1, used, stderr);
+        used = 0;
+      }
+
+      used = appendLogRecord(output, used, &ring->records[head & (NETFREE_LOG_RING_SIZE - 1)]);
+    }
+
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+
+    dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    if(dropped) {
+      if(used + 64 > sizeof(output)) {
+        fwrite(output, 1, used, stderr);
+        used = 0;
+      }
+
+      used += sprintf(output + used, "(%lu log messages dropped)\n", (unsigned long) dropped);
+    }
+  }
+
+  if(used) {
+    fwrite(output, 1, used, stderr);
+  }
+
+  return written;
+}
+
+/**
+ * The start routine for the logging thread.  It drains the rings until stopLogging() is
+ * called, then drains them one last time.
+ *
+ * @param ptr (void *) - unused
+ */
+void *writeLog(void *ptr) {
+  struct timespec idleTime;
+
+  idleTime.tv_sec = 0;
+  idleTime.tv_nsec = NETFREE_LOG_FLUSH_US * 1000L;
+
+  while(!__atomic_load_n(&stopLogger, __ATOMIC_RELAXED)) {
+    if(!drainLogRings()) {
+      nanosleep(&idleTime, NULL);
+    }
+  }
+
+  drainLogRings();
+
+  return NULL;
+}
+
+/**
+ * Starts the logging thread.  From now on, messages are handed to it rather than written
+ * directly.
+ */
+void startLogging() {
+  if(loggingStarted) {
+    return;
+  }
+
+  __atomic_store_n(&stopLogger, 0, __ATOMIC_RELAXED);
+  if(pthread_create(&loggerThread, NULL, writeLog, NULL)) {
+    return;
+  }
+
+  __atomic_store_n(&loggingStarted, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Writes every message that is still waiting, stops the logging thread and frees the
+ * rings.  No other thread may log while logging is being stopped.
+ */
+void stopLogging() {
+  int ringIndex;
+
+  if(!loggingStarted) {
+    return;
+  }
+
+  __atomic_store_n(&loggingStarted, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&stopLogger, 1, __ATOMIC_RELAXED);
+  pthread_join(loggerThread, NULL);
+
+  for(ringIndex = 0; ringIndex < NETFREE_LOG_MAX_THREADS; ringIndex++) {
+    free(logRings[ringIndex]);
+    logRings[ringIndex] = NULL;
+  }
+
+  logRingCount = 0;
+  logGeneration++;
+}
+
+/**
+ * Logs a message from the specified call site, unless the site has reached its rate limit.
+ * This is normally called through NETFREE_LOG() and the macros built on it.
+ *
+ * @param site (LogSite *) - the call site
+ * @param format (const char *) - the printf-style format of the message
+ * @param ... - the values for format
+ */
+void logMessage(LogSite *site, const char *format, ...) {
+  struct timespec now;
+  LogRecord       directRecord;
+  LogRecord      *record;
+  LogRing        *ring = NULL;
+  char            output[sizeof(LogRecord) + 64];
+  va_list         args;
+  uint64_t        tail = 0;
+  int             length;
+
+  // A racing thread may let a message or two past the limit, which is harmless.
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+  if(__atomic_load_n(&site->window, __ATOMIC_RELAXED) != now.tv_sec) {
+    __atomic_store_n(&site->window, now.tv_sec, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+  }
+
+  if(__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) >= NETFREE_LOG_SITE_RATE) {
+    __atomic_add_fetch(&site->suppressed, 1, __ATOMIC_RELAXED);
+
+    return;
+  }
+
+  if(__atomic_load_n(&loggingStarted, __ATOMIC_ACQUIRE)) {
+    ring = currentLogRing();
+    if(!ring) {
+      return;
+    }
+
+    tail = ring->tail;
+    if(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == NETFREE_LOG_RING_SIZE) {
+      __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+
+      return;
+    }
+
+    record = &ring->records[tail & (NETFREE_LOG_RING_SIZE - 1)];
+  } else {
+    record = &directRecord;
+  }
+
+  va_start(args, format);
+  length = vsnprintf(record->message, NETFREE_LOG_MESSAGE_SIZE, format, args);
+  va_end(args);
+
+  if(length < 0) {
+    length = 0;
+  } else if(length >= NETFREE_LOG_MESSAGE_SIZE) {
+    length = NETFREE_LOG_MESSAGE_SIZE - 1;
+  }
+
+  record->length = length;
+  record->level = site->level;
+  record->suppressed = __atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+
+  if(ring) {
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+  } else {
+    fwrite(output, 1, appendLogRecord(output, 0, record), stderr);
+  }
+}
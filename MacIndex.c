@@ -0,0 +1,168 @@
+/**
+ * This file implements the MAC index described in MacIndex.h.  Removal uses backward shift
+ * deletion rather than tombstones: the entries following the removed one in its probe run
+ * are moved back into the hole whenever their home slot allows it, so lookups never have to
+ * step over deleted slots no matter how many stations come and go.
+ */
+#include <stdlib.h>
+
+#include "MacIndex.h"
+
+#define MAC_INDEX_FULL(index)  ((index)->length * 4 >= (index)->capacity * 3)
+
+/**
+ * Initializes an empty index.
+ *
+ * @param index (MacIndex *) - the index to initialize
+ * @param capacity (unsigned int) - the initial number of slots, rounded up to a power of 2 since
+ *                                   the probes wrap around with a mask
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
+ */
+int initMacIndex(MacIndex *index, unsigned int capacity) {
+  unsigned int  requested = capacity;
+
+  for(capacity = 1; capacity < requested; capacity <<= 1);
+
+  index->slots = (MacIndexSlot *) calloc(capacity, sizeof(MacIndexSlot));
+  index->capacity = capacity;
+  index->length = 0;
+
+  return index->slots ? 0 : -1;
+}
+
+/**
+ * Frees the memory held by the index.  The values are not freed.
+ *
+ * @param index (MacIndex *) - the index to destroy
+ */
+void destroyMacIndex(MacIndex *index) {
+  free(index->slots);
+
+  index->slots = NULL;
+  index->length = 0;
+}
+
+/**
+ * Finds the value stored for the specified key.
+ *
+ * @param index (MacIndex *) - the index to search
+ * @param key (uint64_t) - the key produced by STATION_KEY()
+ *
+ * @return (void *) the value, or NULL if the key is not in the index
+ */
+void *macIndexFind(MacIndex *index, uint64_t key) {
+  unsigned int  slot = STATION_HASH(key, index->capacity);
+  MacIndexSlot *current;
+
+  for(current = &index->slots[slot]; current->key; current = &index->slots[slot]) {
+    if(current->key == key) {
+      return current->value;
+    }
+
+    slot = (slot + 1) & (index->capacity - 1);
+  }
+
+  return NULL;
+}
+
+/**
+ * Doubles the number of slots in the index and rehashes every entry.
+ *
+ * @param index (MacIndex *) - the index to grow
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
+ */
+int growMacIndex(MacIndex *index) {
+  MacIndexSlot *oldSlots = index->slots;
+  unsigned int  oldCapacity = index->capacity;
+  unsigned int  slotIndex;
+  unsigned int  slot;
+
+  index->slots = (MacIndexSlot *) calloc(oldCapacity * 2, sizeof(MacIndexSlot));
+  if(!index->slots) {
+    index->slots = oldSlots;
+
+    return -1;
+  }
+
+  index->capacity = oldCapacity * 2;
+  for(slotIndex = 0; slotIndex < oldCapacity; slotIndex++) {
+    if(!oldSlots[slotIndex].key) {
+      continue;
+    }
+
+    for(slot = STATION_HASH(oldSlots[slotIndex].key, index->capacity); index->slots[slot].key; slot = (slot + 1) & (index->capacity - 1));
+
+    index->slots[slot] = oldSlots[slotIndex];
+  }
+
+  free(oldSlots);
+
+  return 0;
+}
+
+/**
+ * Stores value under the specified key, replacing any value already stored for it.
+ *
+ * @param index (MacIndex *) - the index to update
+ * @param key (uint64_t) - the key produced by STATION_KEY()
+ * @param value (void *) - the value to store
+ *
+ * @return (int) 0 on success, -1 if the index had to grow and memory could not be allocated
+ */
+int macIndexInsert(MacIndex *index, uint64_t key, void *value) {
+  unsigned int slot;
+
+  if(MAC_INDEX_FULL(index) && growMacIndex(index)) {
+    return -1;
+  }
+
+  for(slot = STATION_HASH(key, index->capacity); index->slots[slot].key; slot = (slot + 1) & (index->capacity - 1)) {
+    if(index->slots[slot].key == key) {
+      index->slots[slot].value = value;
+
+      return 0;
+    }
+  }
+
+  index->slots[slot].key = key;
+  index->slots[slot].value = value;
+  index->length++;
+
+  return 0;
+}
+
+/**
+ * Removes the specified key from the index, if it is present.
+ *
+ * @param index (MacIndex *) - the index to update
+ * @param key (uint64_t) - the key produced by STATION_KEY()
+ */
+void macIndexRemove(MacIndex *index, uint64_t key) {
+  unsigned int mask = index->capacity - 1;
+  unsigned int hole = STATION_HASH(key, index->capacity);
+  unsigned int slot;
+  unsigned int home;
+
+  for(; index->slots[hole].key != key; hole = (hole + 1) & mask) {
+    if(!index->slots[hole].key) {
+      return;
+    }
+  }
+
+  // Pull back every following entry of the run that would still be reachable from its home slot.
+  for(slot = (hole + 1) & mask; index->slots[slot].key; slot = (slot + 1) & mask) {
+    home = STATION_HASH(index->slots[slot].key, index->capacity);
+
+    // The entry may move only if its home is not cyclically within (hole, slot].
+    if(((slot - home) & mask) >= ((slot - hole) & mask)) {
+      index->slots[hole] = index->slots[slot];
+      hole = slot;
+    }
+  }
+
+  index->slots[hole].key = 0;
+  index->slots[hole].value = NULL;
+  index->length--;
+}
@@ -0,0 +1,210 @@
+/**
+ * This file implements the MAC queue notifications described in MacQueueEvents.h.  They do
+ * not depend on the queue's implementation: each queue reports its length, its top station
+ * and its evictions through notifyMacQueue(), and this file decides which subscriptions
+ * fire.  Subscriptions are only changed, and eventfds only written, with subscriptionLock
+ * held, so an eventfd is never written after it is closed.
+ */
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "MacQueueEvents.h"
+#include "MacQueue.h"
+
+typedef struct MacQueueSubscriptionStruct {
+  int   descriptor;       // -1 when the slot is free
+  int   events;
+  int   threshold;        // Only used by MAC_QUEUE_EVENT_LENGTH
+  int   armed;            // Whether the length is below threshold, so reaching it fires again
+} MacQueueSubscription;
+
+MacQueueSubscription macQueueSubscriptions[NETFREE_MAC_QUEUE_SUBSCRIBERS] = {[0 ... NETFREE_MAC_QUEUE_SUBSCRIBERS - 1] = {-1, 0, 0, 0}};
+pthread_mutex_t      subscriptionLock = PTHREAD_MUTEX_INITIALIZER;
+MacAddress           lastTop = 0;
+int                  macQueueWatchedEvents = 0;
+uint64_t             macQueueGeneration = 0;
+uint64_t             lastGeneration = 0;  // The generation of the newest report delivered
+
+/**
+ * Adds to a subscription's eventfd.  subscriptionLock must be held by the caller.
+ */
+static void signalSubscription(MacQueueSubscription *subscription, uint64_t count) {
+  ssize_t written;
+
+  // A full counter (a reader that never reads) loses the event rather than blocking the queue.
+  written = write(subscription->descriptor, &count, sizeof(count));
+  (void) written;
+}
+
+/**
+ * Recomputes the union of the subscribed events.  subscriptionLock must be held by the
+ * caller.
+ */
+static void updateWatchedEvents() {
+  int events = 0;
+  int slot;
+
+  for(slot = 0; slot < NETFREE_MAC_QUEUE_SUBSCRIBERS; slot++) {
+    if(macQueueSubscriptions[slot].descriptor != -1) {
+      events |= macQueueSubscriptions[slot].events;
+    }
+  }
+
+  __atomic_store_n(&macQueueWatchedEvents, events, __ATOMIC_RELAXED);
+}
+
+/**
+ * Subscribes to changes of the MAC queue.  A MAC_QUEUE_EVENT_LENGTH subscription fires when
+ * the queue reaches threshold stations, including right away if it already holds that many,
+ * and fires again only after the queue has dropped below threshold in between.
+ *
+ * @param events (int) - the MAC_QUEUE_EVENT_ flags to subscribe to
+ * @param threshold (int) - the number of stations MAC_QUEUE_EVENT_LENGTH waits for
+ *
+ * @return (int) a non-blocking eventfd that becomes readable when a subscribed event occurs,
+ *  or -1 if NETFREE_MAC_QUEUE_SUBSCRIBERS subscriptions exist or no eventfd could be created.
+ *  The eventfd is owned by the queue; release it with unsubscribeMacQueue().
+ */
+int subscribeMacQueue(int events, int threshold) {
+  MacQueueSubscription *subscription = NULL;
+  MacAddress            top = 0;
+  int                   length = macQueueLength();
+  int                   descriptor;
+  int                   slot;
+
+  // Read before locking: queues may hold their own locks while they notify.
+  macQueuePeek(&top);
+
+  pthread_mutex_lock(&subscriptionLock);
+  for(slot = 0; slot < NETFREE_MAC_QUEUE_SUBSCRIBERS && !subscription; slot++) {
+    if(macQueueSubscriptions[slot].descriptor == -1) {
+      subscription = &macQueueSubscriptions[slot];
+    }
+  }
+
+  if(!subscription || (subscription->descriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+    pthread_mutex_unlock(&subscriptionLock);
+
+    return -1;
+  }
+
+  subscription->events = events;
+  subscription->threshold = threshold;
+  subscription->armed = length < threshold;
+  if((events & MAC_QUEUE_EVENT_LENGTH) && !subscription->armed) {
+    signalSubscription(subscription, 1);
+  }
+
+  if((events & MAC_QUEUE_EVENT_TOP) && top) {
+    lastTop = top;
+  }
+
+  descriptor = subscription->descriptor;
+  updateWatchedEvents();
+  pthread_mutex_unlock(&subscriptionLock);
+
+  return descriptor;
+}
+
+/**
+ * Cancels a subscription and closes its eventfd.
+ *
+ * @param descriptor (int) - the eventfd returned by subscribeMacQueue()
+ */
+void unsubscribeMacQueue(int descriptor) {
+  int slot;
+
+  pthread_mutex_lock(&subscriptionLock);
+  for(slot = 0; slot < NETFREE_MAC_QUEUE_SUBSCRIBERS; slot++) {
+    if(descriptor != -1 && macQueueSubscriptions[slot].descriptor == descriptor) {
+      close(descriptor);
+      macQueueSubscriptions[slot].descriptor = -1;
+    }
+  }
+
+  updateWatchedEvents();
+  pthread_mutex_unlock(&subscriptionLock);
+}
+
+/**
+ * Blocks until a subscription fires, for callers that have nothing else to wait on.
+ *
+ * @param descriptor (int) - the eventfd returned by subscribeMacQueue()
+ * @param timeout (int) - the maximum time to wait, in milliseconds, or -1 to wait forever
+ *
+ * @return (int) the number of events since the last wait (which clears them), 0 if the
+ *  timeout expired first, or -1 on error
+ */
+int waitMacQueueEvent(int descriptor, int timeout) {
+  struct pollfd pollDescriptor = {descriptor, POLLIN, 0};
+  uint64_t      count;
+  int           status;
+
+  status = poll(&pollDescriptor, 1, timeout);
+  if(status <= 0) {
+    return status;
+  }
+
+  if(read(descriptor, &count, sizeof(count)) != sizeof(count)) {
+    return 0;
+  }
+
+  return count;
+}
+
+/**
+ * Reports a change of the MAC queue and fires the subscriptions it concerns.  Queues call
+ * this after a change, and only if MAC_QUEUE_WATCHED() says someone cares.  The length and
+ * top of a report older than the newest one delivered are ignored, so a late report cannot
+ * re-arm a subscription or bring back a previous top; its evictions still count.
+ *
+ * @param generation (uint64_t) - MAC_QUEUE_NEXT_GENERATION(), taken while the change was
+ *  made.  length and top must be read after it was taken
+ * @param length (int) - the number of stations in the queue
+ * @param top (MacAddress) - the station ranked first, or 0 if the queue is empty or no one
+ *  watches MAC_QUEUE_EVENT_TOP
+ * @param evicted (int) - the number of stations evicted by the change
+ */
+void notifyMacQueue(uint64_t generation, int length, MacAddress top, int evicted) {
+  MacQueueSubscription *subscription;
+  int                   topChanged;
+  int                   stale;
+
+  pthread_mutex_lock(&subscriptionLock);
+  stale = generation < lastGeneration;
+  if(!stale) {
+    lastGeneration = generation;
+  }
+
+  topChanged = !stale && top && top != lastTop;
+  if(topChanged) {
+    lastTop = top;
+  }
+
+  for(subscription = macQueueSubscriptions; subscription < macQueueSubscriptions + NETFREE_MAC_QUEUE_SUBSCRIBERS; subscription++) {
+    if(subscription->descriptor == -1) {
+      continue;
+    }
+
+    if((subscription->events & MAC_QUEUE_EVENT_LENGTH) && !stale) {
+      if(length < subscription->threshold) {
+        subscription->armed = 1;
+      } else if(subscription->armed) {
+        subscription->armed = 0;
+        signalSubscription(subscription, 1);
+      }
+    }
+
+    if((subscription->events & MAC_QUEUE_EVENT_TOP) && topChanged) {
+      signalSubscription(subscription, 1);
+    }
+
+    if((subscription->events & MAC_QUEUE_EVENT_EVICTED) && evicted > 0) {
+      signalSubscription(subscription, evicted);
+    }
+  }
+  pthread_mutex_unlock(&subscriptionLock);
+}
@@ -32,209 +32,1282 @@
  *
  * If both n_P and t_P are 0, the queue will act as a normal queue, which is unlikely to
  * result in favorable results.
+ *
+ * When NETFREE_DECAYED_PRIORITY is defined, the priority is instead the number of packets
+ * received from the device with each packet's weight decaying exponentially with its age:
+ *
+ *      S(t) = sum over packets i of e^(-L * (t - t_i))
+ *
+ * Where L = ln(2) / NETFREE_DECAY_HALF_LIFE.  Factoring out a fixed epoch t_0 (the time of
+ * the first packet recorded) gives S(t) = e^(-L * (t - t_0)) * sum e^(L * (t_i - t_0)).  The
+ * first factor is the same for every device, so the order of the devices is the order of
+ * the second, which never changes as time passes.  The queue stores its logarithm:
+ *
+ *      P = ln(sum e^(L * (t_i - t_0)))
+ *
+ * so recording a packet only raises the priority of the device that sent it, and devices
+ * that have gone quiet sink below active ones without ever being touched.  Working in the
+ * log domain keeps the values representable however long the scanner runs.
+ *
+ * The queue is split into NETFREE_QUEUE_SHARDS shards chosen by a hash of the MAC address.
+ * Each shard has its own lock, MacIndex and element slab, so writers touching different
+ * stations rarely contend.  Within a shard, stations are partitioned by the BSSID they were
+ * last heard with (see MacQueue.h): every partition the shard holds stations of has its own
+ * indexed d-ary max-heap (NETFREE_HEAP_ARITY children per node), and the shard ranks those
+ * heaps by their top elements.  Every element remembers its position in its heap, so a
+ * change in priority only sifts that element up or down: recording packets and dequeuing are
+ * O(log n) in the size of the partition, and a station moving to another network stays in
+ * its shard.  The BSSIDs are numbered in a registry shared by the shards; partitionLock
+ * guards it, and a shard only takes that lock the first time it hears a BSSID.
+ *
+ * Readers never take a lock.  After every change a shard publishes its top element and its
+ * length, and so does each of its partitions, under a sequence lock: the sequence is odd
+ * while the writer updates the published values, so a reader that sees the same even
+ * sequence before and after reading them knows it read a consistent pair.  macQueuePeek()
+ * and dequeueMac() compare the published tops of the shards, the queries of one BSSID
+ * compare the published tops of its partition in every shard, and the lengths are sums of
+ * the published lengths.
  */
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <pthread.h>
 
 #include "PriorityMacQueue.h"
+#include "MacQueueEvents.h"
+#include "MacIndex.h"
+#include "StationSlab.h"
 #include "mac.h"
 
 #ifndef MAC_PRIORITY
   #define MAC_PRIORITY(timesReceived, lastReceived)  (NETFREE_REVCOUNT_WEIGHT * timesReceived) + (NETFREE_TIMEDELTA_WEIGHT * lastReceived)
 #endif
 
-typedef struct PriorityMacElementStruct {
-  struct PriorityMacElementStruct *next;
+#define DECAY_RATE                  (M_LN2 / NETFREE_DECAY_HALF_LIFE)
+
+// Any time may be recorded, including negative ones, so the unset epoch is one no packet has.
+#define QUEUE_EPOCH_UNSET           INT64_MIN
+
+#define HEAP_PARENT(position)       (((position) - 1) / NETFREE_HEAP_ARITY)
+#define HEAP_FIRST_CHILD(position)  ((position) * NETFREE_HEAP_ARITY + 1)
+
+// The MacIndex hashes with the middle bits of the product, so shards use the top bits.
+#define QUEUE_SHARD(key)            ((unsigned int) (((key) * 0x9e3779b97f4a7c15ULL) >> 56) & (NETFREE_QUEUE_SHARDS - 1))
+
+// An element's key holds the number of its partition above the bits STATION_KEY() uses.
+#define ELEMENT_PARTITION_SHIFT     52
+#define ELEMENT_KEY(element)        ((element)->key & ((1ULL << ELEMENT_PARTITION_SHIFT) - 1))
+#define ELEMENT_PARTITION(element)  ((int) ((element)->key >> ELEMENT_PARTITION_SHIFT))
+
+_Static_assert(NETFREE_MAX_PARTITIONS <= (1 << (64 - ELEMENT_PARTITION_SHIFT)), "Partition numbers must fit in an element's key");
 
-  char   *macAddress;
-  int     packetsReceived;
-  double  lastUpdated;
-  double  priority;
+/**
+ * An element is exactly 32 bytes (two per cache line) and holds its MAC address inline.
+ * Elements are carved out of a StationSlab, so adding a station usually reuses the memory of
+ * a dequeued one rather than allocating.
+ */
+typedef struct PriorityMacElementStruct {
+  uint64_t  key;              // STATION_KEY() of the MAC address, plus the partition's number
+  int64_t   lastUpdated;      // CLOCK_MONOTONIC nanoseconds
+  double    priority;
+  uint32_t  packetsReceived;
+  uint32_t  heapIndex;
 } PriorityMacElement;
 
-PriorityMacElement *queueHead = NULL;
-pthread_mutex_t queueMutex;
+_Static_assert(sizeof(PriorityMacElement) == 32, "PriorityMacElement should fill half a cache line");
 
-int length;
+/**
+ * The top element and length a shard or partition last published.  They are written with
+ * the shard's lock held and read without it under sequence.
+ */
+typedef struct PublishedTopStruct {
+  unsigned int  sequence;
+  uint64_t      top;                        // 0 when empty
+  double        priority;
+  int           length;
+} PublishedTop;
+
+/**
+ * The stations of one partition that belong to one shard.
+ */
+typedef struct ShardPartitionStruct {
+  // Only touched with the shard's lock held.
+  int                   number;             // Index in partitionBssids
+  int                   rank;               // Position in the shard's ranking
+  int                   changed;            // Whether it is waiting in the shard's changed list
+  double                topPriority;        // Priority of the top element as ranked, -INFINITY when empty
+  PriorityMacElement  **heap;
+  unsigned int          heapCapacity;
+  int                   length;
+
+  PublishedTop          published __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+} ShardPartition;
+
+typedef struct QueueShardStruct {
+  // Only touched with lock held.
+  pthread_mutex_t       lock __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+  MacIndex              index;              // STATION_KEY() of a MAC address to its element
+  MacIndex              bssids;             // STATION_KEY() of a BSSID to its entry in partitionBssids
+  StationSlab           slab;
+  int                   length;
+
+  // Stored with release once ready, so readers may follow them without the lock.
+  ShardPartition       *partitions[NETFREE_MAX_PARTITIONS];
+
+  // The shard's partitions as a max-heap on topPriority, and those changed since published.
+  ShardPartition       *ranking[NETFREE_MAX_PARTITIONS];
+  int                   rankingLength;
+  ShardPartition       *changed[NETFREE_MAX_PARTITIONS];
+  int                   changedCount;
+
+  PublishedTop          published __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+} QueueShard;
+
+QueueShard *queueShards = NULL;
+
+pthread_mutex_t partitionLock = PTHREAD_MUTEX_INITIALIZER;
+MacAddress      partitionBssids[NETFREE_MAX_PARTITIONS];
+int             partitionCount = 0;         // Stored with release once the BSSID is set
+MacIndex        partitionIndex;             // STATION_KEY() of a BSSID to its entry in partitionBssids
+
+int64_t queueEpoch;                         // The time of the first packet recorded
+int     stationCount;                       // Stations in every shard; only kept under NETFREE_MAX_STATIONS
+
+/**
+ * Finds the number of a BSSID's partition.  partitionLock is taken, so the caller may hold
+ * a shard's lock but not partitionLock.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param create (int) - whether to add a partition for a BSSID that has none
+ *
+ * @return (int) the number of the partition, or -1 if the BSSID has none and create is 0.
+ *  Stations of a BSSID that can no longer get a partition of its own go to partition 0.
+ */
+int findPartition(MacAddress bssid, int create) {
+  MacAddress *entry;
+  int         number;
+
+  if(!bssid) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&partitionLock);
+  entry = (MacAddress *) macIndexFind(&partitionIndex, STATION_KEY(bssid));
+  if(entry) {
+    number = entry - partitionBssids;
+  } else if(!create) {
+    number = -1;
+  } else if(partitionCount == NETFREE_MAX_PARTITIONS || macIndexInsert(&partitionIndex, STATION_KEY(bssid), &partitionBssids[partitionCount])) {
+    number = 0;
+  } else {
+    number = partitionCount;
+    partitionBssids[number] = bssid;
+    __atomic_store_n(&partitionCount, number + 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&partitionLock);
+
+  return number;
+}
+
+/**
+ * Adds a partition to a shard.  The shard's lock must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard
+ * @param number (int) - the number of the partition
+ *
+ * @return (ShardPartition *) the partition, or NULL if memory could not be allocated
+ */
+ShardPartition *createShardPartition(QueueShard *shard, int number) {
+  ShardPartition *partition;
+
+  partition = (ShardPartition *) aligned_alloc(NETFREE_CACHE_LINE_SIZE, sizeof(ShardPartition));
+  if(!partition) {
+    return NULL;
+  }
+
+  memset(partition, 0, sizeof(ShardPartition));
+  partition->number = number;
+  partition->topPriority = -INFINITY;
+  partition->heapCapacity = NETFREE_HEAP_SIZE;
+  partition->heap = (PriorityMacElement **) malloc(partition->heapCapacity * sizeof(PriorityMacElement *));
+  if(!partition->heap) {
+    free(partition);
+
+    return NULL;
+  }
+
+  // An empty partition ranks below every other, so it starts at the bottom.
+  partition->rank = shard->rankingLength;
+  shard->ranking[shard->rankingLength++] = partition;
+
+  __atomic_store_n(&shard->partitions[number], partition, __ATOMIC_RELEASE);
+
+  return partition;
+}
+
+/**
+ * Finds a shard's partition for a BSSID, creating it if needed.  Stations heard without a
+ * BSSID, or with a BSSID that no longer gets a partition of its own, go to partition 0.  The
+ * shard's lock must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard
+ * @param bssid (MacAddress) - the BSSID, or 0 if it is unknown
+ *
+ * @return (ShardPartition *) the partition
+ */
+ShardPartition *partitionFor(QueueShard *shard, MacAddress bssid) {
+  ShardPartition *partition;
+  MacAddress     *entry;
+  int             number = 0;
+
+  if(bssid) {
+    // The shard remembers the BSSIDs it has heard, so it rarely needs partitionLock.
+    entry = (MacAddress *) macIndexFind(&shard->bssids, STATION_KEY(bssid));
+    if(entry) {
+      number = entry - partitionBssids;
+    } else {
+      number = findPartition(bssid, 1);
+      if(macIndexInsert(&shard->bssids, STATION_KEY(bssid), &partitionBssids[number])) {
+        // The BSSID is still placed correctly; it is only looked up under partitionLock again.
+      }
+    }
+  }
+
+  partition = shard->partitions[number];
+  if(!partition) {
+    partition = createShardPartition(shard, number);
+  }
+
+  return partition ? partition : shard->partitions[0];
+}
 
 /**
  * Initializes the queue for use.
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
  */
-void initMacQueue() {
-  queueHead = (PriorityMacElement *) calloc(1, sizeof(PriorityMacElement));
-  length = 0;
+int initMacQueue() {
+  QueueShard *shard;
+
+  partitionBssids[0] = 0;
+  partitionCount = 1;
+  queueEpoch = QUEUE_EPOCH_UNSET;
+  stationCount = 0;
+
+  if(initMacIndex(&partitionIndex, NETFREE_MAX_PARTITIONS * 2)) {
+    return -1;
+  }
+
+  queueShards = (QueueShard *) aligned_alloc(NETFREE_CACHE_LINE_SIZE, NETFREE_QUEUE_SHARDS * sizeof(QueueShard));
+  if(!queueShards) {
+    destroyMacIndex(&partitionIndex);
+
+    return -1;
+  }
 
-  pthread_mutex_init(&queueMutex, NULL);
+  // Every lock exists before anything can fail, so destroyMacQueue() can undo a partial start.
+  memset(queueShards, 0, NETFREE_QUEUE_SHARDS * sizeof(QueueShard));
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS; shard++) {
+    pthread_mutex_init(&shard->lock, NULL);
+  }
+
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS; shard++) {
+    // Every shard has partition 0, the one stations fall back to.
+    if(initMacIndex(&shard->index, NETFREE_MAC_INDEX_SIZE) || initMacIndex(&shard->bssids, NETFREE_MAX_PARTITIONS * 2) ||
+       initStationSlab(&shard->slab, sizeof(PriorityMacElement), 0) || !createShardPartition(shard, 0)) {
+      destroyMacQueue();
+
+      return -1;
+    }
+  }
+
+  return 0;
 }
 
 /**
  * Destroys the queue and frees any memory allocated for it.
  */
 void destroyMacQueue() {
-  PriorityMacElement *current = queueHead;
-  PriorityMacElement *previous;
+  QueueShard *shard;
+  int         rank;
+
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS; shard++) {
+    pthread_mutex_lock(&shard->lock);
+    for(rank = 0; rank < shard->rankingLength; rank++) {
+      free(shard->ranking[rank]->heap);
+      free(shard->ranking[rank]);
+    }
+
+    destroyStationSlab(&shard->slab);
+    destroyMacIndex(&shard->bssids);
+    destroyMacIndex(&shard->index);
+    pthread_mutex_unlock(&shard->lock);
+
+    pthread_mutex_destroy(&shard->lock);
+  }
+
+  free(queueShards);
+  queueShards = NULL;
+
+  pthread_mutex_lock(&partitionLock);
+  partitionCount = 0;
+  destroyMacIndex(&partitionIndex);
+  pthread_mutex_unlock(&partitionLock);
+}
+
+/**
+ * Publishes a top element and a length for lock-free readers.  The lock of the shard they
+ * belong to must be held by the caller.
+ *
+ * @param published (PublishedTop *) - where they are published
+ * @param top (uint64_t) - the key of the top element, or 0 if there is none
+ * @param priority (double) - the priority of the top element
+ * @param length (int) - the number of elements
+ */
+void publishTop(PublishedTop *published, uint64_t top, double priority, int length) {
+  unsigned int sequence = published->sequence;
+
+  __atomic_store_n(&published->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  __atomic_store_n(&published->top, top, __ATOMIC_RELAXED);
+  __atomic_store(&published->priority, &priority, __ATOMIC_RELAXED);
+  __atomic_store_n(&published->length, length, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&published->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Reads a published top element, retrying while a writer is publishing.
+ *
+ * @param published (PublishedTop *) - what to read
+ * @param priority (double *) - where the priority of the top element is stored
+ *
+ * @return (uint64_t) the key of the top element, or 0 if there is none
+ */
+uint64_t readPublishedTop(PublishedTop *published, double *priority) {
+  unsigned int sequence;
+  uint64_t     top;
+
+  do {
+    sequence = __atomic_load_n(&published->sequence, __ATOMIC_ACQUIRE);
+
+    top = __atomic_load_n(&published->top, __ATOMIC_RELAXED);
+    __atomic_load(&published->priority, priority, __ATOMIC_RELAXED);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while((sequence & 1) || sequence != __atomic_load_n(&published->sequence, __ATOMIC_RELAXED));
+
+  return top;
+}
+
+/**
+ * Moves a partition to the position in its shard's ranking that matches the priority of its
+ * top element.  The shard's lock must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard that holds the partition
+ * @param partition (ShardPartition *) - the partition whose topPriority changed
+ */
+void rankPartition(QueueShard *shard, ShardPartition *partition) {
+  ShardPartition **ranking = shard->ranking;
+  int              position = partition->rank;
+  int              child;
+  int              lastChild;
+  int              largest;
+
+  while(position > 0 && ranking[HEAP_PARENT(position)]->topPriority < partition->topPriority) {
+    ranking[position] = ranking[HEAP_PARENT(position)];
+    ranking[position]->rank = position;
+    position = HEAP_PARENT(position);
+  }
+
+  while((child = HEAP_FIRST_CHILD(position)) < shard->rankingLength) {
+    lastChild = child + NETFREE_HEAP_ARITY;
+    if(lastChild > shard->rankingLength) {
+      lastChild = shard->rankingLength;
+    }
+
+    for(largest = child++; child < lastChild; child++) {
+      if(ranking[child]->topPriority > ranking[largest]->topPriority) {
+        largest = child;
+      }
+    }
+
+    if(ranking[largest]->topPriority <= partition->topPriority) {
+      break;
+    }
+
+    ranking[position] = ranking[largest];
+    ranking[position]->rank = position;
+    position = largest;
+  }
+
+  ranking[position] = partition;
+  partition->rank = position;
+}
+
+/**
+ * Remembers that a partition changed, so publishChanges() publishes it.  The shard's lock
+ * must be held by the caller.
+ */
+static inline void partitionChanged(QueueShard *shard, ShardPartition *partition) {
+  if(!partition->changed) {
+    partition->changed = 1;
+    shard->changed[shard->changedCount++] = partition;
+  }
+}
+
+/**
+ * Publishes every partition of a shard changed since the last call, ranks them again and
+ * publishes the shard.  The shard's lock must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard that changed
+ *
+ * @return (uint64_t) the generation of the changes, for reportChanges(), or 0 if no one
+ *  watches the queue's length or top
+ */
+uint64_t publishChanges(QueueShard *shard) {
+  ShardPartition *partition;
+  int             changedIndex;
+
+  for(changedIndex = 0; changedIndex < shard->changedCount; changedIndex++) {
+    partition = shard->changed[changedIndex];
+    partition->changed = 0;
+
+    if(partition->length) {
+      partition->topPriority = partition->heap[0]->priority;
+      publishTop(&partition->published, ELEMENT_KEY(partition->heap[0]), partition->topPriority, partition->length);
+    } else {
+      partition->topPriority = -INFINITY;
+      publishTop(&partition->published, 0, 0, 0);
+    }
+
+    rankPartition(shard, partition);
+  }
+
+  shard->changedCount = 0;
+
+  partition = shard->ranking[0];
+  if(partition->length) {
+    publishTop(&shard->published, ELEMENT_KEY(partition->heap[0]), partition->topPriority, shard->length);
+  } else {
+    publishTop(&shard->published, 0, 0, 0);
+  }
+
+  return MAC_QUEUE_WATCHED(MAC_QUEUE_EVENT_LENGTH | MAC_QUEUE_EVENT_TOP) ? MAC_QUEUE_NEXT_GENERATION() : 0;
+}
+
+/**
+ * Moves an element toward the top of its partition's heap until its parent has at least
+ * its priority.  The shard's lock must be held by the caller.
+ *
+ * @param partition (ShardPartition *) - the partition that holds the element
+ * @param element (PriorityMacElement *) - the element whose priority increased
+ */
+void siftUp(ShardPartition *partition, PriorityMacElement *element) {
+  PriorityMacElement **heap = partition->heap;
+  unsigned int         position = element->heapIndex;
+  PriorityMacElement  *parent;
+
+  while(position > 0) {
+    parent = heap[HEAP_PARENT(position)];
+    if(parent->priority >= element->priority) {
+      break;
+    }
+
+    heap[position] = parent;
+    parent->heapIndex = position;
+    position = HEAP_PARENT(position);
+  }
+
+  heap[position] = element;
+  element->heapIndex = position;
+}
+
+/**
+ * Moves an element toward the bottom of its partition's heap until none of its children has
+ * a greater priority.  The shard's lock must be held by the caller.
+ *
+ * @param partition (ShardPartition *) - the partition that holds the element
+ * @param element (PriorityMacElement *) - the element whose priority decreased
+ */
+void siftDown(ShardPartition *partition, PriorityMacElement *element) {
+  PriorityMacElement **heap = partition->heap;
+  unsigned int         length = partition->length;
+  unsigned int         position = element->heapIndex;
+  unsigned int         child;
+  unsigned int         lastChild;
+  unsigned int         largest;
+
+  while((child = HEAP_FIRST_CHILD(position)) < length) {
+    lastChild = child + NETFREE_HEAP_ARITY;
+    if(lastChild > length) {
+      lastChild = length;
+    }
+
+    for(largest = child++; child < lastChild; child++) {
+      if(heap[child]->priority > heap[largest]->priority) {
+        largest = child;
+      }
+    }
+
+    if(heap[largest]->priority <= element->priority) {
+      break;
+    }
+
+    heap[position] = heap[largest];
+    heap[position]->heapIndex = position;
+    position = largest;
+  }
+
+  heap[position] = element;
+  element->heapIndex = position;
+}
+
+/**
+ * Adds an element to a partition's heap, growing the heap if it is full.  The shard's lock
+ * must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard that holds the partition
+ * @param partition (ShardPartition *) - the partition the element joins
+ * @param element (PriorityMacElement *) - the element, whose priority must be set
+ *
+ * @return (int) 0 on success, -1 if the heap could not grow
+ */
+int heapInsert(QueueShard *shard, ShardPartition *partition, PriorityMacElement *element) {
+  PriorityMacElement **heap;
+
+  if((unsigned int) partition->length == partition->heapCapacity) {
+    heap = (PriorityMacElement **) realloc(partition->heap, partition->heapCapacity * 2 * sizeof(PriorityMacElement *));
+    if(!heap) {
+      return -1;
+    }
+
+    partition->heap = heap;
+    partition->heapCapacity *= 2;
+  }
+
+  element->key = ELEMENT_KEY(element) | ((uint64_t) partition->number << ELEMENT_PARTITION_SHIFT);
+  element->heapIndex = partition->length++;
+  siftUp(partition, element);
+
+  shard->length++;
+  partitionChanged(shard, partition);
+
+  return 0;
+}
+
+/**
+ * Takes an element out of its partition's heap.  The shard's lock must be held by the
+ * caller.
+ *
+ * @param shard (QueueShard *) - the shard that holds the partition
+ * @param partition (ShardPartition *) - the partition that holds the element
+ * @param element (PriorityMacElement *) - the element to remove
+ */
+void heapRemove(QueueShard *shard, ShardPartition *partition, PriorityMacElement *element) {
+  PriorityMacElement *last;
+
+  // Move the last element into the hole and let it find its place.
+  partition->length--;
+  if(element->heapIndex != (unsigned int) partition->length) {
+    last = partition->heap[partition->length];
+    last->heapIndex = element->heapIndex;
+    partition->heap[last->heapIndex] = last;
+
+    siftUp(partition, last);
+    siftDown(partition, last);
+  }
+
+  shard->length--;
+  partitionChanged(shard, partition);
+}
+
+/**
+ * Computes ln(e^a + e^b) without overflowing when a or b is large.
+ */
+static inline double logAddExp(double a, double b) {
+  if(a < b) {
+    return b + log1p(exp(a - b));
+  }
+
+  return a + log1p(exp(b - a));
+}
+
+/**
+ * Computes the priority of an element after packets have been recorded for it.  The
+ * element's packet count and last update time must already include the new packets.
+ *
+ * @param element (PriorityMacElement *) - the element being updated.  Its priority must be
+ *  -INFINITY if it was just created.
+ * @param weight (double) - the weight of the packets just recorded, as of timeReceived.
+ *  This is their number unless they are restored from a snapshot
+ * @param timeReceived (int64_t) - the time, in nanoseconds, at which the last of these
+ *  packets was received
+ *
+ * @return (double) the element's new priority
+ */
+double macPriority(PriorityMacElement *element, double weight, int64_t timeReceived) {
+#ifdef NETFREE_DECAYED_PRIORITY
+  int64_t epoch = __atomic_load_n(&queueEpoch, __ATOMIC_RELAXED);
 
-  pthread_mutex_lock(&queueMutex);
-  while(current->next) {
-    previous = current;
-    current = current->next;
+  if(epoch == QUEUE_EPOCH_UNSET) {
+    // The first packet recorded by any shard fixes the epoch for all of them.
+    __atomic_compare_exchange_n(&queueEpoch, &epoch, timeReceived, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    epoch = __atomic_load_n(&queueEpoch, __ATOMIC_RELAXED);
+  }
 
-    free(previous->macAddress);
-    free(previous);
+  return logAddExp(element->priority, log(weight) + DECAY_RATE * NS_TO_SECONDS(timeReceived - epoch));
+#else
+  return MAC_PRIORITY(element->packetsReceived, NS_TO_SECONDS(element->lastUpdated));
+#endif
+}
+
+/**
+ * Takes an element for a new station from a shard's slab.  The stations of every shard
+ * count toward NETFREE_MAX_STATIONS, so a busy shard can use the room a quiet one leaves.
+ * The shard's lock must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard the station belongs to
+ *
+ * @return (PriorityMacElement *) the element, or NULL if the queue is full or memory could
+ *  not be allocated
+ */
+static PriorityMacElement *allocateElement(QueueShard *shard) {
+  PriorityMacElement *element;
+
+  if(NETFREE_MAX_STATIONS && __atomic_add_fetch(&stationCount, 1, __ATOMIC_RELAXED) > NETFREE_MAX_STATIONS) {
+    __atomic_sub_fetch(&stationCount, 1, __ATOMIC_RELAXED);
+
+    return NULL;
   }
 
-  if(current != queueHead) {
-    free(current->macAddress);
+  element = (PriorityMacElement *) stationSlabAlloc(&shard->slab);
+  if(!element && NETFREE_MAX_STATIONS) {
+    __atomic_sub_fetch(&stationCount, 1, __ATOMIC_RELAXED);
   }
 
-  free(current);
+  return element;
+}
 
-  queueHead = NULL;
-  pthread_mutex_unlock(&queueMutex);
+/**
+ * Returns the element of a station that left the queue to its shard's slab.  The shard's
+ * lock must be held by the caller.
+ *
+ * @param shard (QueueShard *) - the shard the station belonged to
+ * @param element (PriorityMacElement *) - the element, which is in no heap or index
+ */
+static void freeElement(QueueShard *shard, PriorityMacElement *element) {
+  stationSlabFree(&shard->slab, element);
 
-  pthread_mutex_destroy(&queueMutex);
+  if(NETFREE_MAX_STATIONS) {
+    __atomic_sub_fetch(&stationCount, 1, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * Records packets from the specified MAC address, adding the address to its shard if it is
+ * new, and moves the address to the position matching its new priority.  An address heard
+ * with a BSSID other than the one of its partition moves to that BSSID's partition.  A new
+ * address is ignored if the queue already holds NETFREE_MAX_STATIONS addresses.  The
+ * shard's lock must be held by the caller, who is also responsible for publishing the
+ * changes afterwards.
+ *
+ * @param shard (QueueShard *) - the shard that owns key
+ * @param key (uint64_t) - the STATION_KEY() of the device's MAC address
+ * @param bssid (MacAddress) - the BSSID the packets were sent in, or 0 if it is unknown
+ * @param packets (uint32_t) - the number of packets received from the device
+ * @param weight (double) - the weight of those packets, as of timeReceived (see macPriority())
+ * @param timeReceived (int64_t) - the time, in nanoseconds, at which the last of these
+ *  packets was received
+ */
+void updateMac(QueueShard *shard, uint64_t key, MacAddress bssid, uint32_t packets, double weight, int64_t timeReceived) {
+  PriorityMacElement *current;
+  ShardPartition     *partition;
+  ShardPartition     *target;
+  double              previousPriority;
+
+  current = (PriorityMacElement *) macIndexFind(&shard->index, key);
+  if(current) {
+    partition = shard->partitions[ELEMENT_PARTITION(current)];
+    target = (bssid && bssid != partitionBssids[partition->number]) ? partitionFor(shard, bssid) : partition;
+
+    current->packetsReceived += packets;
+    if(timeReceived > current->lastUpdated) {
+      current->lastUpdated = timeReceived;
+    }
+
+    previousPriority = current->priority;
+    current->priority = macPriority(current, weight, timeReceived);
+
+    if(target != partition) {
+      heapRemove(shard, partition, current);
+
+      // The old partition just gave up a slot, so it can always take the element back.
+      if(heapInsert(shard, target, current)) {
+        heapInsert(shard, partition, current);
+      }
+    } else if(current->priority > previousPriority) {
+      siftUp(partition, current);
+      partitionChanged(shard, partition);
+    } else if(current->priority < previousPriority) {
+      siftDown(partition, current);
+      partitionChanged(shard, partition);
+    }
+
+    return;
+  }
+
+  // This is a new MAC address.
+  current = allocateElement(shard);
+  if(!current) {
+    return;
+  }
+
+  current->key = key;
+  current->packetsReceived = packets;
+  current->lastUpdated = timeReceived;
+  current->priority = -INFINITY;
+  current->priority = macPriority(current, weight, timeReceived);
+
+  partition = partitionFor(shard, bssid);
+  if(heapInsert(shard, partition, current)) {
+    freeElement(shard, current);
+
+    return;
+  }
+
+  // A station the index cannot find would be added a second time by its next packet.
+  if(macIndexInsert(&shard->index, key, current)) {
+    heapRemove(shard, partition, current);
+    freeElement(shard, current);
+  }
+}
+
+/**
+ * Reports the queue's length and top station to the subscriptions that watch them.  No
+ * shard lock may be held by the caller.
+ *
+ * @param generation (uint64_t) - what publishChanges() returned for the changes
+ */
+static void reportChanges(uint64_t generation) {
+  MacAddress top = 0;
+
+  if(!generation) {
+    return;
+  }
+
+  if(MAC_QUEUE_WATCHED(MAC_QUEUE_EVENT_TOP)) {
+    macQueuePeek(&top);
+  }
+
+  notifyMacQueue(generation, macQueueLength(), top, 0);
 }
 
 /**
  * Adds a new MAC address to the queue and assigns it an appropriate priority based on the
  * number of packets received by the given MAC address and the last time a transmission was
- * received by the device.
+ * received by the device.  The address goes to the partition of stations without a BSSID
+ * unless it is already in the queue.
  *
- * @param macAddress (char *) - the 6 character MAC address for the device
- * @param timestamp (double) - the time at which the transmission was received.  If 0 or a
- *  negative number, the time will be calculated before the MAC is enqueued.
+ * @param macAddress (MacAddress) - the MAC address of the device
+ * @param timestamp (int64_t) - the CLOCK_MONOTONIC time, in nanoseconds, at which the
+ *  transmission was received.  If 0 or a negative number, the time will be calculated before
+ *  the MAC is enqueued.
  */
-void enqueueMac(char *macAddress, double timestamp) {
-  PriorityMacElement *current;
-  PriorityMacElement *previous;
-  PriorityMacElement *oldPrevious;
-  PriorityMacElement *last;
-  int                 priority;
-  double              timeReceived;
+void enqueueMac(MacAddress macAddress, int64_t timestamp) {
+  uint64_t    key = STATION_KEY(macAddress);
+  QueueShard *shard = &queueShards[QUEUE_SHARD(key)];
+  int64_t     timeReceived;
+  uint64_t    generation;
 
   timeReceived = timestamp;
   if(timestamp <= 0) {
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
 
-    timeReceived = (double) now.tv_sec + (1.0e-9 * now.tv_nsec);
+    timeReceived = TIMESPEC_TO_NS(now);
   }
 
-  priority = MAC_PRIORITY(1, timeReceived);     // Priority if the MAC address is new.
+  pthread_mutex_lock(&shard->lock);
+  updateMac(shard, key, 0, 1, 1, timeReceived);
+  generation = publishChanges(shard);
+  pthread_mutex_unlock(&shard->lock);
 
-  pthread_mutex_lock(&queueMutex);
-  previous = queueHead;
-  for(current = queueHead; current->next && !macEquals(current->next->macAddress, macAddress); current = current->next) {
-    // I cannot predict what the priority will be if this MAC address already exists, but I can for a new MAC address.
-    // So, I'll determine what the index of a new MAC address will be here to reduce that case's complexity since for
-    // this case memory must be allocated, which can be timely.
-    if(current->next->priority < priority && !previous) {
-      previous = current;
+  reportChanges(generation);
+}
+
+/**
+ * Applies a batch of MacRecords.  The records are first grouped by shard so that every
+ * shard's lock is taken (and the shard published) at most once per NETFREE_BATCH_SIZE
+ * records.  Records without a timestamp share a single clock read, and the index slot of
+ * the record NETFREE_PREFETCH_DISTANCE ahead in a shard is prefetched while the current
+ * record is applied.
+ *
+ * @param records (MacRecord *) - the records to apply
+ * @param count (int) - the number of records
+ */
+void enqueueMacBatch(MacRecord *records, int count) {
+  uint64_t    keys[NETFREE_BATCH_SIZE];
+  uint16_t    order[NETFREE_BATCH_SIZE];
+  int         shardStart[NETFREE_QUEUE_SHARDS + 1];
+  int         shardIndex;
+  int         recordIndex;
+  int         position;
+  int         batchCount;
+  int64_t     now = 0;
+  uint64_t    generation = 0;
+  QueueShard *shard;
+  MacRecord  *record;
+
+  for(; count > 0; records += batchCount, count -= batchCount) {
+    batchCount = (count < NETFREE_BATCH_SIZE) ? count : NETFREE_BATCH_SIZE;
+
+    // Counting sort of the records by shard.
+    memset(shardStart, 0, sizeof(shardStart));
+    for(recordIndex = 0; recordIndex < batchCount; recordIndex++) {
+      keys[recordIndex] = STATION_KEY(records[recordIndex].macAddress);
+      shardStart[QUEUE_SHARD(keys[recordIndex]) + 1]++;
+
+      if(records[recordIndex].timestamp <= 0 && now <= 0) {
+        struct timespec clock;
+        clock_gettime(CLOCK_MONOTONIC, &clock);
+
+        now = TIMESPEC_TO_NS(clock);
+      }
     }
-  }
 
-  if(!previous) {
-    previous = current;
+    for(shardIndex = 0; shardIndex < NETFREE_QUEUE_SHARDS; shardIndex++) {
+      shardStart[shardIndex + 1] += shardStart[shardIndex];
+    }
+
+    for(recordIndex = 0; recordIndex < batchCount; recordIndex++) {
+      order[shardStart[QUEUE_SHARD(keys[recordIndex])]++] = recordIndex;
+    }
+
+    // Each shard's records now end at shardStart[shard] and start where the previous shard's end.
+    for(shardIndex = 0, position = 0; shardIndex < NETFREE_QUEUE_SHARDS; shardIndex++) {
+      if(position == shardStart[shardIndex]) {
+        continue;
+      }
+
+      shard = &queueShards[shardIndex];
+      pthread_mutex_lock(&shard->lock);
+      for(; position < shardStart[shardIndex]; position++) {
+        if(position + NETFREE_PREFETCH_DISTANCE < shardStart[shardIndex]) {
+          MAC_INDEX_PREFETCH(&shard->index, keys[order[position + NETFREE_PREFETCH_DISTANCE]]);
+        }
+
+        record = &records[order[position]];
+        updateMac(shard, keys[order[position]], record->bssid, record->packets, record->packets, (record->timestamp > 0) ? record->timestamp : now);
+      }
+
+      generation = publishChanges(shard);
+      pthread_mutex_unlock(&shard->lock);
+    }
   }
 
-  oldPrevious = current;
-  current = current->next;
+  reportChanges(generation);
+}
 
-  if(current) {
-    // Found the MAC address.
-    current->packetsReceived++;
-    current->lastUpdated = timeReceived;
-    current->priority = MAC_PRIORITY(current->packetsReceived, timeReceived);
+/**
+ * Finds the shard whose published top element has the highest priority, without locking.
+ *
+ * @param number (int) - the number of the partition whose top elements are compared, or -1
+ *  to compare the tops of the whole shards
+ * @param top (uint64_t *) - where the key of that element is stored
+ *
+ * @return (QueueShard *) the shard, or NULL if every shard (or its partition) is empty
+ */
+QueueShard *highestShard(int number, uint64_t *top) {
+  QueueShard     *shard;
+  QueueShard     *highest = NULL;
+  ShardPartition *partition;
+  PublishedTop   *published;
+  uint64_t        shardTop;
+  double          priority;
+  double          highestPriority = 0;
 
-    // Find the appropriate location for this address and add it.
-    for(previous = queueHead; previous->next && previous->next->priority >= current->priority; previous = previous->next);
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS; shard++) {
+    published = &shard->published;
+    if(number != -1) {
+      if(!(partition = __atomic_load_n(&shard->partitions[number], __ATOMIC_ACQUIRE))) {
+        continue;
+      }
 
-    oldPrevious->next = current->next;
-    current->next = previous->next;
-    previous->next = current;
-  } else {
-    // This is a new MAC address.
-    current = (PriorityMacElement *) calloc(1, sizeof(PriorityMacElement));
+      published = &partition->published;
+    }
 
-    current->macAddress = (char *) malloc(NETFREE_MAC_SIZE);
-    strncpy(current->macAddress, macAddress, NETFREE_MAC_SIZE);
+    shardTop = readPublishedTop(published, &priority);
+    if(shardTop && (!highest || priority > highestPriority)) {
+      highest = shard;
+      highestPriority = priority;
+      *top = shardTop;
+    }
+  }
 
-    current->packetsReceived = 1;
-    current->lastUpdated = timeReceived;
-    current->priority = priority;
+  return highest;
+}
 
-    current->next = previous->next;
-    previous->next = current;
+/**
+ * Sums the lengths a partition last published in every shard, without locking.
+ *
+ * @param number (int) - the number of the partition
+ *
+ * @return (int) the number of stations in the partition
+ */
+int partitionLength(int number) {
+  ShardPartition *partition;
+  int             length = 0;
+  int             shardIndex;
 
-    length++;
+  for(shardIndex = 0; shardIndex < NETFREE_QUEUE_SHARDS; shardIndex++) {
+    if((partition = __atomic_load_n(&queueShards[shardIndex].partitions[number], __ATOMIC_ACQUIRE))) {
+      length += __atomic_load_n(&partition->published.length, __ATOMIC_RELAXED);
+    }
   }
-  pthread_mutex_unlock(&queueMutex);
+
+  return length;
 }
 
 /**
- * Determines the first MAC address in the queue.  The MAC address is copied to macAddress,
- * which should have NETFREE_MAC_SIZE bytes.  If NETFREE_MAC_SIZE bytes are not allocated
- * to pointer, the behavior is undefined.  If there are no remaining MAC addresses, NULL is
- * returned and macAddress is left unmodified.  The string will not be NULL terminated.
+ * Determines the first MAC address in the queue without taking any lock.  The MAC address is
+ * copied to macAddress.  If there are no remaining MAC addresses, NULL is returned and
+ * macAddress is left unmodified.
  *
- * @param macAddress (char *) - a pointer to NETFREE_MAC_SIZE bytes of memory where the copy
- *  of the MAC address can be stored
+ * @param macAddress (MacAddress *) - where the MAC address should be stored
  *
- * @return (char *) macAddress
+ * @return (MacAddress *) macAddress
  */
-char *macQueuePeek(char *macAddress) {
-  pthread_mutex_lock(&queueMutex);
-  if(!queueHead->next || !queueHead->next->macAddress) {
-    pthread_mutex_unlock(&queueMutex);
+MacAddress *macQueuePeek(MacAddress *macAddress) {
+  uint64_t top;
 
+  if(!highestShard(-1, &top)) {
     return NULL;
   }
 
-  strncpy(macAddress, queueHead->next->macAddress, NETFREE_MAC_SIZE);
-  pthread_mutex_unlock(&queueMutex);
+  *macAddress = STATION_KEY_MAC(top);
 
   return macAddress;
 }
 
 /**
- * Returns the length of the queue.
+ * Returns the length of the queue without taking any lock.  The length is the sum of the
+ * lengths last published by the shards.
  *
  * @return (int) the length of the queue
  */
 int macQueueLength() {
+  QueueShard *shard;
+  int         length = 0;
+
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS; shard++) {
+    length += __atomic_load_n(&shard->published.length, __ATOMIC_RELAXED);
+  }
+
   return length;
 }
 
 /**
- * Removes the first MAC address in the queue and returns it.  The returned MAC address will
- * not be NULL terminated.
+ * Returns the number of bytes the queue holds for its stations: the shards, their
+ * partitions and heaps, the indexes and the slabs' chunks.  Each shard is locked while it is
+ * measured.
  *
- * @param macAddress (char *) - either NULL or a pointer to NETFREE_MAC_SIZE bytes of memory
- *  where a copy of the MAC address can be stored.  If macAddress is NULL, the MAC address
- *  will not be set
+ * @return (size_t) the memory used by the queue, in bytes
+ */
+size_t macQueueMemory() {
+  QueueShard *shard;
+  size_t      memory = NETFREE_QUEUE_SHARDS * sizeof(QueueShard);
+  int         rank;
+
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS; shard++) {
+    pthread_mutex_lock(&shard->lock);
+    for(rank = 0; rank < shard->rankingLength; rank++) {
+      memory += sizeof(ShardPartition) + shard->ranking[rank]->heapCapacity * sizeof(PriorityMacElement *);
+    }
+
+    memory += (shard->index.capacity + shard->bssids.capacity) * sizeof(MacIndexSlot);
+    memory += shard->slab.reserved;
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  pthread_mutex_lock(&partitionLock);
+  memory += partitionIndex.capacity * sizeof(MacIndexSlot);
+  pthread_mutex_unlock(&partitionLock);
+
+  return memory;
+}
+
+/**
+ * Lists the BSSIDs whose partitions hold stations, without locking.  The stations heard
+ * without a BSSID are listed as BSSID 0.
  *
- * @return (char *) macAddress
+ * @param bssids (MacAddress *) - where the BSSIDs are stored
+ * @param capacity (int) - the number of BSSIDs that fit in bssids
+ *
+ * @return (int) the number of BSSIDs stored
  */
-char *dequeueMac(char *macAddress) {
-  PriorityMacElement *top;
+int macQueuePartitions(MacAddress *bssids, int capacity) {
+  int partitions = __atomic_load_n(&partitionCount, __ATOMIC_ACQUIRE);
+  int count = 0;
+  int number;
 
-  if(macAddress) {
-    macQueuePeek(macAddress);
+  for(number = 0; number < partitions && count < capacity; number++) {
+    if(partitionLength(number)) {
+      bssids[count++] = partitionBssids[number];
+    }
   }
 
-  pthread_mutex_lock(&queueMutex);
-  if(queueHead->next) {
-    top = queueHead->next;
+  return count;
+}
 
-    queueHead->next = top->next;
+/**
+ * Returns the number of stations last heard with a BSSID, without locking once the BSSID's
+ * partition is found.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ *
+ * @return (int) the number of stations in the BSSID's partition
+ */
+int macQueuePartitionLength(MacAddress bssid) {
+  int number = findPartition(bssid, 0);
 
-    strncpy(macAddress, top->macAddress, NETFREE_MAC_SIZE);
+  return (number == -1) ? 0 : partitionLength(number);
+}
 
-    free(top->macAddress);
-    free(top);
+/**
+ * Determines the first MAC address among the stations last heard with a BSSID, without
+ * locking once the BSSID's partition is found.  If there are none, NULL is returned and
+ * macAddress is left unmodified.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param macAddress (MacAddress *) - where the MAC address should be stored
+ *
+ * @return (MacAddress *) macAddress
+ */
+MacAddress *macQueuePartitionPeek(MacAddress bssid, MacAddress *macAddress) {
+  int      number = findPartition(bssid, 0);
+  uint64_t top;
+
+  if(number == -1 || !highestShard(number, &top)) {
+    return NULL;
   }
-  pthread_mutex_unlock(&queueMutex);
+
+  *macAddress = STATION_KEY_MAC(top);
 
   return macAddress;
-}
\ No newline at end of file
+}
+
+/**
+ * Copies the state of the stations of a partition.  The shard's lock must be held by the
+ * caller.
+ *
+ * @return (int) the number of states stored
+ */
+static int exportPartition(ShardPartition *partition, StationState *states, int capacity) {
+  PriorityMacElement *element;
+  StationState       *state;
+  int                 count = 0;
+  int                 position;
+
+  for(position = 0; position < partition->length && count < capacity; position++) {
+    element = partition->heap[position];
+    state = &states[count++];
+
+    state->macAddress = STATION_KEY_MAC(ELEMENT_KEY(element));
+    state->packets = element->packetsReceived;
+    state->error = 0;
+    state->lastReceived = element->lastUpdated;
+#ifdef NETFREE_DECAYED_PRIORITY
+    // Undo the factoring out of the epoch (see the top of this file).
+    state->weight = exp(element->priority - DECAY_RATE * NS_TO_SECONDS(element->lastUpdated - queueEpoch));
+#else
+    state->weight = element->packetsReceived;
+#endif
+    state->bssid = partitionBssids[partition->number];
+  }
+
+  return count;
+}
+
+/**
+ * Copies the state of the stations in the queue, shard by shard, in no particular order.
+ * Each shard is locked while it is copied, so the copy of a shard is consistent but shards
+ * may be copied at slightly different times.
+ *
+ * @param states (StationState *) - where the states are stored
+ * @param capacity (int) - the number of states that fit in states
+ *
+ * @return (int) the number of states stored.  If it equals capacity, there may have been
+ *  more stations than fit.
+ */
+int exportMacQueue(StationState *states, int capacity) {
+  QueueShard *shard;
+  int         count = 0;
+  int         rank;
+
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS && count < capacity; shard++) {
+    pthread_mutex_lock(&shard->lock);
+    for(rank = 0; rank < shard->rankingLength && count < capacity; rank++) {
+      count += exportPartition(shard->ranking[rank], states + count, capacity - count);
+    }
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  return count;
+}
+
+/**
+ * Copies the state of the stations last heard with a BSSID, in no particular order.  Only
+ * that BSSID's stations are visited, one shard at a time.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param states (StationState *) - where the states are stored
+ * @param capacity (int) - the number of states that fit in states
+ *
+ * @return (int) the number of states stored.  If it equals capacity, there may have been
+ *  more stations than fit.
+ */
+int exportMacQueuePartition(MacAddress bssid, StationState *states, int capacity) {
+  QueueShard *shard;
+  int         number = findPartition(bssid, 0);
+  int         count = 0;
+
+  if(number == -1) {
+    return 0;
+  }
+
+  for(shard = queueShards; shard < queueShards + NETFREE_QUEUE_SHARDS && count < capacity; shard++) {
+    pthread_mutex_lock(&shard->lock);
+    if(shard->partitions[number]) {
+      count += exportPartition(shard->partitions[number], states + count, capacity - count);
+    }
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  return count;
+}
+
+/**
+ * Records the state of stations, typically exported by an earlier run, as if the packets
+ * they describe had just been received.  A station already in the queue has the state added
+ * to what it holds.
+ *
+ * @param states (StationState *) - the states to record
+ * @param count (int) - the number of states
+ */
+void importMacQueue(StationState *states, int count) {
+  uint64_t    key;
+  uint64_t    generation = 0;
+  QueueShard *shard;
+  int         stateIndex;
+
+  for(stateIndex = 0; stateIndex < count; stateIndex++) {
+    if(!states[stateIndex].packets || !(states[stateIndex].weight > 0)) {
+      continue;
+    }
+
+    key = STATION_KEY(states[stateIndex].macAddress);
+    shard = &queueShards[QUEUE_SHARD(key)];
+
+    pthread_mutex_lock(&shard->lock);
+    updateMac(shard, key, states[stateIndex].bssid, states[stateIndex].packets, states[stateIndex].weight, states[stateIndex].lastReceived);
+    generation = publishChanges(shard);
+    pthread_mutex_unlock(&shard->lock);
+  }
+
+  reportChanges(generation);
+}
+
+/**
+ * Removes the top element of a partition and frees it.  The shard's lock must be held by
+ * the caller, who is also responsible for publishing the change, and the partition may not
+ * be empty.
+ *
+ * @return (MacAddress) the MAC address of the element removed
+ */
+static MacAddress removeTop(QueueShard *shard, ShardPartition *partition) {
+  PriorityMacElement *top = partition->heap[0];
+  uint64_t            key = ELEMENT_KEY(top);
+
+  heapRemove(shard, partition, top);
+  macIndexRemove(&shard->index, key);
+  freeElement(shard, top);
+
+  return STATION_KEY_MAC(key);
+}
+
+/**
+ * Removes the top element of the shard or partition with the highest published top.  If
+ * another thread empties the chosen one first, the next best is tried.
+ *
+ * @param number (int) - the number of the partition to dequeue from, or -1 for any
+ * @param macAddress (MacAddress *) - either NULL or where the MAC address should be stored
+ *
+ * @return (MacAddress *) macAddress, or NULL if there was nothing to remove
+ */
+static MacAddress *dequeueHighest(int number, MacAddress *macAddress) {
+  QueueShard     *shard;
+  ShardPartition *partition;
+  MacAddress      removed;
+  uint64_t        publishedTop;
+  uint64_t        generation;
+
+  while((shard = highestShard(number, &publishedTop))) {
+    pthread_mutex_lock(&shard->lock);
+
+    // Every change is published before the lock is released, so the ranking is current.
+    partition = (number == -1) ? shard->ranking[0] : shard->partitions[number];
+    if(!partition->length) {
+      pthread_mutex_unlock(&shard->lock);
+      continue;
+    }
+
+    removed = removeTop(shard, partition);
+    generation = publishChanges(shard);
+    pthread_mutex_unlock(&shard->lock);
+
+    if(macAddress) {
+      *macAddress = removed;
+    }
+
+    reportChanges(generation);
+
+    return macAddress;
+  }
+
+  return NULL;
+}
+
+/**
+ * Removes the first MAC address in the queue and returns it.  If another thread empties the
+ * chosen shard first, the next best shard is tried.
+ *
+ * @param macAddress (MacAddress *) - either NULL or where the MAC address should be stored.
+ *  If macAddress is NULL, the MAC address will not be set
+ *
+ * @return (MacAddress *) macAddress, or NULL if the queue was empty
+ */
+MacAddress *dequeueMac(MacAddress *macAddress) {
+  return dequeueHighest(-1, macAddress);
+}
+
+/**
+ * Removes the first MAC address among the stations last heard with a BSSID and returns it.
+ * Only the shards' tops for that BSSID are compared, and only the chosen shard is locked.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param macAddress (MacAddress *) - either NULL or where the MAC address should be stored.
+ *  If macAddress is NULL, the MAC address will not be set
+ *
+ * @return (MacAddress *) macAddress, or NULL if no station was left in the partition
+ */
+MacAddress *dequeueMacFromPartition(MacAddress bssid, MacAddress *macAddress) {
+  int number = findPartition(bssid, 0);
+
+  if(number == -1) {
+    return NULL;
+  }
+
+  return dequeueHighest(number, macAddress);
+}
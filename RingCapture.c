@@ -0,0 +1,242 @@
+/**
+ * This file implements a zero-copy capture backend built on an AF_PACKET TPACKET_V3 ring.
+ * The kernel writes frames directly into a memory-mapped ring of blocks.  Rather than being
+ * notified of every frame, the reader is handed a whole block once the kernel retires it
+ * (either because the block is full or because NETFREE_RING_RETIRE_MS has passed).  Frames
+ * are parsed in place and the block is then returned to the kernel.
+ *
+ * Unlike libpcap, this backend does not put the interface into monitor mode.  The interface
+ * must already be in monitor mode (e.g. "iw dev <iface> set type monitor") so that the
+ * frames carry radiotap headers.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/if_ether.h>
+
+#include "RingCapture.h"
+
+/**
+ * Determines whether the specified interface delivers radiotap frames, which is the case
+ * only if the interface is in monitor mode.
+ *
+ * @param sock (int) - any open socket
+ * @param iface (char *) - the name of the interface to check
+ *
+ * @return (int) 1 if the interface is in monitor mode, 0 otherwise
+ */
+int isMonitorInterface(int sock, char *iface) {
+  struct ifreq ifr;
+
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+
+  if(ioctl(sock, SIOCGIFHWADDR, &ifr)) {
+    return 0;
+  }
+
+  return ifr.ifr_hwaddr.sa_family == ARPHRD_IEEE80211_RADIOTAP;
+}
+
+/**
+ * Opens a TPACKET_V3 ring on the specified interface.  The interface must already be in
+ * monitor mode.
+ *
+ * @param ring (RingCapture *) - the ring to initialize
+ * @param iface (char *) - the name of the interface from which frames should be captured
+ *
+ * @return (int) 0 on success.  Otherwise, a negative integer is returned.
+ */
+int initRingCapture(RingCapture *ring, char *iface) {
+  struct sockaddr_ll  address;
+  unsigned int        ifaceIndex;
+  int                 version = TPACKET_V3;
+
+  memset(ring, 0, sizeof(RingCapture));
+  ring->socket = -1;
+
+  ifaceIndex = if_nametoindex(iface);
+  if(!ifaceIndex) {
+    return -1;
+  }
+
+  // Protocol 0 receives nothing until bind() attaches the socket to the interface, so no
+  // frame from another interface lands in the ring in between.
+  ring->socket = socket(AF_PACKET, SOCK_RAW, 0);
+  if(ring->socket == -1) {
+    return -2;
+  }
+
+  if(!isMonitorInterface(ring->socket, iface)) {
+    destroyRingCapture(ring);
+
+    return -3;
+  }
+
+  if(setsockopt(ring->socket, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) {
+    destroyRingCapture(ring);
+
+    return -4;
+  }
+
+  ring->request.tp_block_size = NETFREE_RING_BLOCK_SIZE;
+  ring->request.tp_block_nr = NETFREE_RING_BLOCK_COUNT;
+  ring->request.tp_frame_size = NETFREE_RING_FRAME_SIZE;
+  ring->request.tp_frame_nr = (NETFREE_RING_BLOCK_SIZE / NETFREE_RING_FRAME_SIZE) * NETFREE_RING_BLOCK_COUNT;
+  ring->request.tp_retire_blk_tov = NETFREE_RING_RETIRE_MS;
+
+  if(setsockopt(ring->socket, SOL_PACKET, PACKET_RX_RING, &ring->request, sizeof(ring->request))) {
+    destroyRingCapture(ring);
+
+    return -5;
+  }
+
+  ring->map = mmap(NULL, ring->request.tp_block_size * ring->request.tp_block_nr, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, ring->socket, 0);
+  if(ring->map == MAP_FAILED) {
+    ring->map = NULL;
+    destroyRingCapture(ring);
+
+    return -6;
+  }
+
+  memset(&address, 0, sizeof(address));
+  address.sll_family = AF_PACKET;
+  address.sll_protocol = htons(ETH_P_ALL);
+  address.sll_ifindex = ifaceIndex;
+
+  if(bind(ring->socket, (struct sockaddr *) &address, sizeof(address))) {
+    destroyRingCapture(ring);
+
+    return -7;
+  }
+
+  return 0;
+}
+
+/**
+ * Unmaps the ring and closes its socket.
+ *
+ * @param ring (RingCapture *) - the ring to destroy
+ */
+void destroyRingCapture(RingCapture *ring) {
+  if(ring->map) {
+    munmap(ring->map, ring->request.tp_block_size * ring->request.tp_block_nr);
+    ring->map = NULL;
+  }
+
+  if(ring->socket != -1) {
+    close(ring->socket);
+    ring->socket = -1;
+  }
+}
+
+/**
+ * Attaches a classic BPF program to the ring's socket so unwanted frames are dropped by the
+ * kernel before they are written to the ring.
+ *
+ * @param ring (RingCapture *) - the ring to filter
+ * @param filter (struct sock_fprog *) - the program to attach
+ *
+ * @return (int) 0 on success, nonzero otherwise
+ */
+int ringCaptureSetFilter(RingCapture *ring, struct sock_fprog *filter) {
+  return setsockopt(ring->socket, SOL_SOCKET, SO_ATTACH_FILTER, filter, sizeof(struct sock_fprog));
+}
+
+/**
+ * Adds the ring's socket to a PACKET_FANOUT group.  Every socket bound to the same
+ * interface with the same group ID receives a share of the interface's frames, spread
+ * according to NETFREE_FANOUT_MODE.
+ *
+ * @param ring (RingCapture *) - the ring to add to the group
+ * @param groupId (int) - the 16-bit ID of the fanout group
+ *
+ * @return (int) 0 on success, nonzero otherwise
+ */
+int ringCaptureJoinFanout(RingCapture *ring, int groupId) {
+  int fanout = (groupId & 0xffff) | (NETFREE_FANOUT_MODE << 16);
+
+  return setsockopt(ring->socket, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout));
+}
+
+/**
+ * Hands every block retired by the kernel to handler, in order, until
+ * ringCaptureBreakLoop() is called.  Each block is returned to the kernel as soon as the
+ * handler returns, so the handler must not keep pointers into the block.
+ *
+ * @param ring (RingCapture *) - the ring from which blocks should be read
+ * @param handler (RingBlockHandler) - the function that parses a retired block
+ * @param context (void *) - passed through to handler
+ *
+ * @return (int) 0 when the loop was broken, a negative integer if polling failed
+ */
+int ringCaptureLoop(RingCapture *ring, RingBlockHandler handler, void *context) {
+  struct tpacket_block_desc *block;
+  struct pollfd              pollDescriptor;
+
+  pollDescriptor.fd = ring->socket;
+  pollDescriptor.events = POLLIN | POLLERR;
+  pollDescriptor.revents = 0;
+
+  ring->breakLoop = 0;
+  while(!ring->breakLoop) {
+    block = (struct tpacket_block_desc *) (ring->map + (ring->currentBlock * ring->request.tp_block_size));
+
+    if(!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+      if(poll(&pollDescriptor, 1, NETFREE_RING_POLL_MS) == -1) {
+        return -1;
+      }
+
+      continue;
+    }
+
+    handler(context, block);
+
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    ring->currentBlock = (ring->currentBlock + 1) % ring->request.tp_block_nr;
+  }
+
+  return 0;
+}
+
+/**
+ * Causes ringCaptureLoop() to return after the block it is currently processing (or within
+ * NETFREE_RING_POLL_MS if it is waiting for the kernel).
+ *
+ * @param ring (RingCapture *) - the ring whose loop should stop
+ */
+void ringCaptureBreakLoop(RingCapture *ring) {
+  ring->breakLoop = 1;
+}
+
+/**
+ * Reads how many frames the kernel has passed to the ring, and how many of those it dropped
+ * because the ring was full, since the last call.  Reading the counts resets them.
+ *
+ * @param ring (RingCapture *) - the ring whose counts should be read
+ * @param received (unsigned int *) - where the number of frames that passed the filter is
+ *  stored, including the dropped ones
+ * @param dropped (unsigned int *) - where the number of dropped frames is stored
+ *
+ * @return (int) 0 on success, nonzero otherwise
+ */
+int ringCaptureStatistics(RingCapture *ring, unsigned int *received, unsigned int *dropped) {
+  struct tpacket_stats_v3 statistics;
+  socklen_t               length = sizeof(statistics);
+
+  if(getsockopt(ring->socket, SOL_PACKET, PACKET_STATISTICS, &statistics, &length)) {
+    return -1;
+  }
+
+  *received = statistics.tp_packets;
+  *dropped = statistics.tp_drops;
+
+  return 0;
+}
@@ -0,0 +1,264 @@
+/**
+ * This file implements the MAC queue snapshots described in Snapshot.h.  Saving exports the
+ * queue into a buffer and writes it out with two write() calls; loading maps the file and
+ * imports its records in batches, so the file is never copied as a whole.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <libgen.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Snapshot.h"
+#include "MacQueue.h"
+
+_Static_assert(sizeof(SnapshotHeader) == 32, "SnapshotHeader is part of the file format");
+_Static_assert(sizeof(StationState) == 40, "StationState is part of the file format");
+
+// Version 1 records ended before StationState.bssid.
+#define SNAPSHOT_V1_RECORD_SIZE   32
+
+/**
+ * Returns how far CLOCK_REALTIME is ahead of CLOCK_MONOTONIC, in nanoseconds.
+ */
+int64_t realtimeOffset() {
+  struct timespec realtime;
+  struct timespec monotonic;
+
+  clock_gettime(CLOCK_REALTIME, &realtime);
+  clock_gettime(CLOCK_MONOTONIC, &monotonic);
+
+  return TIMESPEC_TO_NS(realtime) - TIMESPEC_TO_NS(monotonic);
+}
+
+/**
+ * Writes all of a buffer, retrying short and interrupted writes.
+ *
+ * @return (int) 0 on success, -1 otherwise
+ */
+int writeFully(int descriptor, const void *buffer, size_t length) {
+  const char *position = (const char *) buffer;
+  ssize_t     written;
+
+  while(length) {
+    written = write(descriptor, position, length);
+    if(written < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+
+      return -1;
+    }
+
+    position += written;
+    length -= written;
+  }
+
+  return 0;
+}
+
+/**
+ * Flushes the directory holding path to disk, so a rename into it survives a crash.
+ *
+ * @return (int) 0 on success, -1 otherwise
+ */
+int syncDirectory(const char *path) {
+  char *copy = strdup(path);
+  int   descriptor;
+  int   result = -1;
+
+  if(!copy) {
+    return -1;
+  }
+
+  descriptor = open(dirname(copy), O_RDONLY | O_DIRECTORY);
+  if(descriptor != -1) {
+    result = fsync(descriptor);
+    close(descriptor);
+  }
+
+  free(copy);
+
+  return result;
+}
+
+/**
+ * Saves the state of every station in the MAC queue.  The snapshot is written to path.tmp
+ * and renamed to path once it is safely on disk.
+ *
+ * @param path (const char *) - the file to save the snapshot to
+ *
+ * @return (int) the number of stations saved, or -1 if the snapshot could not be written (in
+ *  which case any earlier snapshot at path is left untouched)
+ */
+int saveSnapshot(const char *path) {
+  SnapshotHeader  header;
+  struct timespec now;
+  StationState   *states = NULL;
+  StationState   *grown;
+  char           *temporaryPath;
+  int64_t         offset;
+  int             capacity = macQueueLength() + 64;
+  int             count;
+  int             stateIndex;
+  int             descriptor;
+  int             result = -1;
+
+  // The queue may grow while it is exported; retry until everything fits.
+  for(;;) {
+    grown = (StationState *) realloc(states, capacity * sizeof(StationState));
+    if(!grown) {
+      free(states);
+
+      return -1;
+    }
+
+    states = grown;
+    count = exportMacQueue(states, capacity);
+    if(count < capacity) {
+      break;
+    }
+
+    capacity *= 2;
+  }
+
+  offset = realtimeOffset();
+  for(stateIndex = 0; stateIndex < count; stateIndex++) {
+    states[stateIndex].lastReceived += offset;
+  }
+
+  memcpy(header.magic, NETFREE_SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = NETFREE_SNAPSHOT_VERSION;
+  header.recordSize = sizeof(StationState);
+  header.recordCount = count;
+  clock_gettime(CLOCK_REALTIME, &now);
+  header.savedAt = TIMESPEC_TO_NS(now);
+
+  temporaryPath = (char *) malloc(strlen(path) + sizeof(".tmp"));
+  if(!temporaryPath) {
+    free(states);
+
+    return -1;
+  }
+
+  sprintf(temporaryPath, "%s.tmp", path);
+
+  descriptor = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if(descriptor != -1) {
+    if(!writeFully(descriptor, &header, sizeof(header)) && !writeFully(descriptor, states, count * sizeof(StationState)) && !fsync(descriptor)) {
+      result = count;
+    }
+
+    if(close(descriptor)) {
+      result = -1;
+    }
+
+    if(result < 0 || rename(temporaryPath, path)) {
+      unlink(temporaryPath);
+      result = -1;
+    } else {
+      // The snapshot is complete either way; this only makes the rename itself durable.
+      syncDirectory(path);
+    }
+  }
+
+  free(temporaryPath);
+  free(states);
+
+  return result;
+}
+
+/**
+ * Restores the stations of a snapshot into the MAC queue (see importMacQueue()).  The file
+ * is mapped rather than read, and the records are imported NETFREE_BATCH_SIZE at a time.
+ * Times are clamped to the monotonic clock's range so far: a station last heard before the
+ * machine booted is restored as heard when the clock started, and one from the future (the
+ * wall clock went back) as heard now.
+ *
+ * @param path (const char *) - the snapshot file
+ *
+ * @return (int) the number of stations restored, -1 if the file could not be opened or
+ *  mapped, or -2 if it is not a snapshot this version can read
+ */
+int loadSnapshot(const char *path) {
+  StationState    batch[NETFREE_BATCH_SIZE];
+  SnapshotHeader *header;
+  struct stat     status;
+  struct timespec monotonic;
+  const char     *records;
+  void           *mapping;
+  int64_t         offset;
+  int64_t         now;
+  uint64_t        recordIndex;
+  int             batchCount;
+  int             stateIndex;
+  int             descriptor;
+  int             result;
+
+  descriptor = open(path, O_RDONLY | O_CLOEXEC);
+  if(descriptor == -1) {
+    return -1;
+  }
+
+  if(fstat(descriptor, &status)) {
+    close(descriptor);
+
+    return -1;
+  }
+
+  if(status.st_size < (off_t) sizeof(SnapshotHeader)) {
+    close(descriptor);
+
+    return -2;
+  }
+
+  mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if(mapping == MAP_FAILED) {
+    return -1;
+  }
+
+  header = (SnapshotHeader *) mapping;
+  records = (const char *) mapping + sizeof(SnapshotHeader);
+
+  // Later versions only append fields to the records, so any version can be read.
+  if(memcmp(header->magic, NETFREE_SNAPSHOT_MAGIC, sizeof(header->magic)) || header->version < 1 || header->recordSize < SNAPSHOT_V1_RECORD_SIZE ||
+     header->recordCount > (status.st_size - sizeof(SnapshotHeader)) / header->recordSize || header->recordCount > INT32_MAX) {
+    munmap(mapping, status.st_size);
+
+    return -2;
+  }
+
+  madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+
+  offset = realtimeOffset();
+  clock_gettime(CLOCK_MONOTONIC, &monotonic);
+  now = TIMESPEC_TO_NS(monotonic);
+  for(recordIndex = 0; recordIndex < header->recordCount; recordIndex += batchCount) {
+    batchCount = (header->recordCount - recordIndex < NETFREE_BATCH_SIZE) ? header->recordCount - recordIndex : NETFREE_BATCH_SIZE;
+
+    for(stateIndex = 0; stateIndex < batchCount; stateIndex++) {
+      // Fields the file's version did not have yet are left 0.
+      memset(&batch[stateIndex], 0, sizeof(StationState));
+      memcpy(&batch[stateIndex], records + (recordIndex + stateIndex) * header->recordSize, (header->recordSize < sizeof(StationState)) ? header->recordSize : sizeof(StationState));
+      batch[stateIndex].lastReceived -= offset;
+      if(batch[stateIndex].lastReceived < 0) {
+        batch[stateIndex].lastReceived = 0;
+      } else if(batch[stateIndex].lastReceived > now) {
+        batch[stateIndex].lastReceived = now;
+      }
+    }
+
+    importMacQueue(batch, batchCount);
+  }
+
+  result = header->recordCount;
+  munmap(mapping, status.st_size);
+
+  return result;
+}
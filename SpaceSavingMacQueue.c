@@ -0,0 +1,779 @@
+/**
+ * This file implements the MacQueue.h interface with a fixed memory budget using the
+ * Space-Saving algorithm (Metwally, Agrawal and El Abbadi).  At most NETFREE_SPACE_SAVING_SIZE
+ * stations are tracked.  When a packet arrives from an untracked station and every counter
+ * is in use, the station with the smallest count is evicted and the newcomer inherits its
+ * count as the error of its own estimate:
+ *
+ *      count = min + packets, error = min
+ *
+ * Every estimate overcounts by at most its error, and any station that sent more than N / K
+ * of the N packets seen is guaranteed to be tracked.  No memory is allocated after
+ * initMacQueue(), so the footprint stays flat however many (randomized) addresses pass by.
+ *
+ * The counters are kept in a binary min-heap so the eviction candidate is always at the
+ * top.  Counts only grow, so recording packets only ever sifts a counter down.  Peeking and
+ * dequeuing look for the largest count with a linear scan over the counters; both are rare
+ * compared to recording packets.  Ties are broken by the most recent packet.
+ *
+ * Every counter also records the partition of the BSSID its station was last heard with
+ * (see MacQueue.h), and the counters of each partition are linked in a list, by index, that
+ * is updated whenever a counter changes partition, is evicted or is moved.  The queries
+ * about a single partition walk that list, so they only visit the partition's counters.
+ *
+ * Select this implementation instead of PriorityMacQueue.c with "make MAC_QUEUE=SpaceSavingMacQueue".
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "SpaceSavingMacQueue.h"
+#include "MacQueueEvents.h"
+#include "MacIndex.h"
+#include "mac.h"
+
+#define SPACE_SAVING_PARENT(position)       (((position) - 1) / 2)
+#define SPACE_SAVING_FIRST_CHILD(position)  ((position) * 2 + 1)
+
+typedef struct SpaceSavingCounterStruct {
+  uint64_t  key;              // STATION_KEY() of the MAC address
+  int64_t   lastUpdated;      // CLOCK_MONOTONIC nanoseconds
+  uint32_t  count;
+  uint32_t  error;
+  uint32_t  heapIndex;
+  uint32_t  partition;        // Index of the BSSID in partitionBssids
+  int32_t   previous;         // Index of the previous counter of the partition, or -1
+  int32_t   next;             // Index of the next counter of the partition, or -1
+} SpaceSavingCounter;
+
+SpaceSavingCounter  *counters = NULL;
+SpaceSavingCounter **counterHeap = NULL;
+StationEstimate *estimateScratch = NULL;
+MacIndex counterIndex;
+pthread_mutex_t counterMutex;
+
+int counterCount;          // Written under counterMutex, but read without it by macQueueLength()
+int evictedSinceReport;    // Evictions not yet reported to the subscriptions
+
+// Partition 0 holds the stations heard without a BSSID, and those of BSSIDs seen once
+// NETFREE_MAX_PARTITIONS partitions exist.
+MacAddress partitionBssids[NETFREE_MAX_PARTITIONS];
+int        partitionLengths[NETFREE_MAX_PARTITIONS];
+int        partitionHeads[NETFREE_MAX_PARTITIONS];    // Index of the first counter of each partition, or -1
+int        partitionCount;
+MacIndex   partitionIndex;   // STATION_KEY() of a BSSID to its entry in partitionBssids
+
+/**
+ * Initializes the queue for use.  All of the memory the queue will ever use is allocated
+ * here.
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
+ */
+int initMacQueue() {
+  int status;
+
+  pthread_mutex_init(&counterMutex, NULL);
+
+  counters = (SpaceSavingCounter *) calloc(NETFREE_SPACE_SAVING_SIZE, sizeof(SpaceSavingCounter));
+  counterHeap = (SpaceSavingCounter **) calloc(NETFREE_SPACE_SAVING_SIZE, sizeof(SpaceSavingCounter *));
+  estimateScratch = (StationEstimate *) calloc(NETFREE_SPACE_SAVING_SIZE, sizeof(StationEstimate));
+
+  // Twice the counters keeps the index below its load limit, so it never grows.
+  status = initMacIndex(&counterIndex, NETFREE_SPACE_SAVING_SIZE * 2);
+  status |= initMacIndex(&partitionIndex, NETFREE_MAX_PARTITIONS * 2);
+  __atomic_store_n(&counterCount, 0, __ATOMIC_RELAXED);
+  evictedSinceReport = 0;
+
+  partitionBssids[0] = 0;
+  partitionLengths[0] = 0;
+  partitionHeads[0] = -1;
+  partitionCount = 1;
+
+  // destroyMacQueue() frees whatever was allocated.
+  if(status || !counters || !counterHeap || !estimateScratch) {
+    destroyMacQueue();
+
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Destroys the queue and frees any memory allocated for it.
+ */
+void destroyMacQueue() {
+  pthread_mutex_lock(&counterMutex);
+  free(counters);
+  free(counterHeap);
+  free(estimateScratch);
+
+  counters = NULL;
+  counterHeap = NULL;
+  estimateScratch = NULL;
+  __atomic_store_n(&counterCount, 0, __ATOMIC_RELAXED);
+  destroyMacIndex(&counterIndex);
+  destroyMacIndex(&partitionIndex);
+  partitionCount = 0;
+  pthread_mutex_unlock(&counterMutex);
+
+  pthread_mutex_destroy(&counterMutex);
+}
+
+/**
+ * Determines whether counter a should sit above counter b in the min-heap.
+ */
+static inline int counterBelow(SpaceSavingCounter *a, SpaceSavingCounter *b) {
+  return a->count < b->count || (a->count == b->count && a->lastUpdated < b->lastUpdated);
+}
+
+/**
+ * Places a counter at the specified heap position.
+ */
+static inline void placeCounter(SpaceSavingCounter *counter, unsigned int position) {
+  counterHeap[position] = counter;
+  counter->heapIndex = position;
+}
+
+/**
+ * Moves a counter toward the top of the heap while it is smaller than its parent.
+ * counterMutex must be held by the caller.
+ *
+ * @param counter (SpaceSavingCounter *) - the counter to move
+ */
+void siftCounterUp(SpaceSavingCounter *counter) {
+  unsigned int position = counter->heapIndex;
+
+  while(position > 0 && counterBelow(counter, counterHeap[SPACE_SAVING_PARENT(position)])) {
+    placeCounter(counterHeap[SPACE_SAVING_PARENT(position)], position);
+    position = SPACE_SAVING_PARENT(position);
+  }
+
+  placeCounter(counter, position);
+}
+
+/**
+ * Moves a counter toward the bottom of the heap while one of its children is smaller.
+ * counterMutex must be held by the caller.
+ *
+ * @param counter (SpaceSavingCounter *) - the counter to move
+ */
+void siftCounterDown(SpaceSavingCounter *counter) {
+  unsigned int position = counter->heapIndex;
+  unsigned int child;
+
+  while((child = SPACE_SAVING_FIRST_CHILD(position)) < (unsigned int) counterCount) {
+    if(child + 1 < (unsigned int) counterCount && counterBelow(counterHeap[child + 1], counterHeap[child])) {
+      child++;
+    }
+
+    if(!counterBelow(counterHeap[child], counter)) {
+      break;
+    }
+
+    placeCounter(counterHeap[child], position);
+    position = child;
+  }
+
+  placeCounter(counter, position);
+}
+
+/**
+ * Finds the partition of a BSSID.  counterMutex must be held by the caller.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param create (int) - whether to add a partition for a BSSID that has none
+ *
+ * @return (int) the number of the partition, or -1 if the BSSID has none and create is 0
+ */
+int findPartition(MacAddress bssid, int create) {
+  MacAddress *entry;
+
+  if(!bssid) {
+    return 0;
+  }
+
+  entry = (MacAddress *) macIndexFind(&partitionIndex, STATION_KEY(bssid));
+  if(entry) {
+    return entry - partitionBssids;
+  }
+
+  if(!create) {
+    return -1;
+  }
+
+  if(partitionCount == NETFREE_MAX_PARTITIONS) {
+    return 0;
+  }
+
+  partitionBssids[partitionCount] = bssid;
+  partitionLengths[partitionCount] = 0;
+  partitionHeads[partitionCount] = -1;
+  macIndexInsert(&partitionIndex, STATION_KEY(bssid), &partitionBssids[partitionCount]);
+
+  return partitionCount++;
+}
+
+/**
+ * Adds a counter to the list of a partition.  counterMutex must be held by the caller.
+ *
+ * @param counter (SpaceSavingCounter *) - the counter, which may not be in any list
+ * @param partition (int) - the partition it joins
+ */
+void linkCounter(SpaceSavingCounter *counter, int partition) {
+  int32_t index = counter - counters;
+
+  counter->partition = partition;
+  counter->previous = -1;
+  counter->next = partitionHeads[partition];
+  if(counter->next != -1) {
+    counters[counter->next].previous = index;
+  }
+
+  partitionHeads[partition] = index;
+  partitionLengths[partition]++;
+}
+
+/**
+ * Takes a counter out of the list of its partition.  counterMutex must be held by the
+ * caller.
+ *
+ * @param counter (SpaceSavingCounter *) - the counter
+ */
+void unlinkCounter(SpaceSavingCounter *counter) {
+  if(counter->previous != -1) {
+    counters[counter->previous].next = counter->next;
+  } else {
+    partitionHeads[counter->partition] = counter->next;
+  }
+
+  if(counter->next != -1) {
+    counters[counter->next].previous = counter->previous;
+  }
+
+  partitionLengths[counter->partition]--;
+}
+
+/**
+ * Finds the counter with the largest count.  Only the counters of the partition are visited
+ * when one is given.  counterMutex must be held by the caller.
+ *
+ * @param partition (int) - the partition to look in, or -1 to look at every counter
+ *
+ * @return (SpaceSavingCounter *) the largest counter, or NULL if no station is tracked
+ */
+SpaceSavingCounter *largestCounter(int partition) {
+  SpaceSavingCounter *largest = NULL;
+  SpaceSavingCounter *counter;
+  int32_t             index;
+
+  if(partition != -1) {
+    for(index = partitionHeads[partition]; index != -1; index = counters[index].next) {
+      if(!largest || counterBelow(largest, &counters[index])) {
+        largest = &counters[index];
+      }
+    }
+
+    return largest;
+  }
+
+  for(counter = counters; counter < counters + counterCount; counter++) {
+    if(!largest || counterBelow(largest, counter)) {
+      largest = counter;
+    }
+  }
+
+  return largest;
+}
+
+/**
+ * Releases counterMutex and reports the changes made while it was held to the
+ * subscriptions that watch them.  Finding the top station takes a scan over the counters,
+ * so it is only done while someone watches MAC_QUEUE_EVENT_TOP.  The report is taken, and
+ * its generation with it, before the mutex is released.  counterMutex must be held by the
+ * caller.
+ */
+static void unlockAndReport() {
+  SpaceSavingCounter *largest;
+  MacAddress          top = 0;
+  uint64_t            generation = 0;
+  int                 length = counterCount;
+  int                 evicted = evictedSinceReport;
+  int                 watched = MAC_QUEUE_WATCHED(MAC_QUEUE_EVENT_LENGTH | MAC_QUEUE_EVENT_TOP | MAC_QUEUE_EVENT_EVICTED);
+
+  if(watched) {
+    generation = MAC_QUEUE_NEXT_GENERATION();
+  }
+
+  if((watched & MAC_QUEUE_EVENT_TOP) && (largest = largestCounter(-1))) {
+    top = STATION_KEY_MAC(largest->key);
+  }
+
+  evictedSinceReport = 0;
+  pthread_mutex_unlock(&counterMutex);
+
+  if(watched) {
+    notifyMacQueue(generation, length, top, evicted);
+  }
+}
+
+/**
+ * Records packets from the specified MAC address, evicting the smallest counter if the
+ * address is not tracked and every counter is in use.  An address heard with a BSSID other
+ * than the one of its partition moves to that BSSID's partition.  counterMutex must be held
+ * by the caller.
+ *
+ * @param macAddress (MacAddress) - the MAC address of the device
+ * @param bssid (MacAddress) - the BSSID the packets were sent in, or 0 if it is unknown
+ * @param packets (uint32_t) - the number of packets received from the device
+ * @param timeReceived (int64_t) - the time, in nanoseconds, at which the last of these
+ *  packets was received
+ *
+ * @return (SpaceSavingCounter *) the counter now tracking the address
+ */
+SpaceSavingCounter *updateMac(MacAddress macAddress, MacAddress bssid, uint32_t packets, int64_t timeReceived) {
+  SpaceSavingCounter *counter;
+  uint64_t            key = STATION_KEY(macAddress);
+  int                 partition;
+
+  counter = (SpaceSavingCounter *) macIndexFind(&counterIndex, key);
+  if(!counter) {
+    if(counterCount < NETFREE_SPACE_SAVING_SIZE) {
+      counter = &counters[counterCount];
+      counter->count = 0;
+      counter->error = 0;
+      counter->lastUpdated = 0;
+      counter->heapIndex = counterCount;
+      __atomic_store_n(&counterCount, counterCount + 1, __ATOMIC_RELAXED);
+
+      counter->key = key;
+      linkCounter(counter, findPartition(bssid, 1));
+      macIndexInsert(&counterIndex, key, counter);
+      siftCounterUp(counter);
+    } else {
+      // Evict the smallest counter; the newcomer may have sent up to that many packets unseen.
+      counter = counterHeap[0];
+      macIndexRemove(&counterIndex, counter->key);
+
+      counter->error = counter->count;
+      counter->key = key;
+      evictedSinceReport++;
+      macIndexInsert(&counterIndex, key, counter);
+
+      partition = findPartition(bssid, 1);
+      if(partition != (int) counter->partition) {
+        unlinkCounter(counter);
+        linkCounter(counter, partition);
+      }
+    }
+  } else if(bssid && partitionBssids[counter->partition] != bssid) {
+    // BSSIDs seen once every partition is taken share partition 0, whose BSSID is 0.
+    partition = findPartition(bssid, 1);
+    if(partition != (int) counter->partition) {
+      unlinkCounter(counter);
+      linkCounter(counter, partition);
+    }
+  }
+
+  counter->count += packets;
+  if(timeReceived > counter->lastUpdated) {
+    counter->lastUpdated = timeReceived;
+  }
+
+  siftCounterDown(counter);
+
+  return counter;
+}
+
+/**
+ * Records a single packet from the specified MAC address.  The address goes to the partition
+ * of stations without a BSSID unless it is already tracked.
+ *
+ * @param macAddress (MacAddress) - the MAC address of the device
+ * @param timestamp (int64_t) - the CLOCK_MONOTONIC time, in nanoseconds, at which the
+ *  transmission was received.  If 0 or a negative number, the time will be calculated before
+ *  the MAC is enqueued.
+ */
+void enqueueMac(MacAddress macAddress, int64_t timestamp) {
+  int64_t timeReceived;
+
+  timeReceived = timestamp;
+  if(timestamp <= 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    timeReceived = TIMESPEC_TO_NS(now);
+  }
+
+  pthread_mutex_lock(&counterMutex);
+  updateMac(macAddress, 0, 1, timeReceived);
+  unlockAndReport();
+}
+
+/**
+ * Applies a batch of MacRecords under a single acquisition of the queue's lock.  Records
+ * without a timestamp share a single clock read.
+ *
+ * @param records (MacRecord *) - the records to apply
+ * @param count (int) - the number of records
+ */
+void enqueueMacBatch(MacRecord *records, int count) {
+  MacRecord *record;
+  MacRecord *end = records + count;
+  int64_t    now = 0;
+
+  if(count <= 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&counterMutex);
+  for(record = records; record < end; record++) {
+    if(record + NETFREE_PREFETCH_DISTANCE < end) {
+      MAC_INDEX_PREFETCH(&counterIndex, STATION_KEY(record[NETFREE_PREFETCH_DISTANCE].macAddress));
+    }
+
+    if(record->timestamp <= 0 && now <= 0) {
+      struct timespec clock;
+      clock_gettime(CLOCK_MONOTONIC, &clock);
+
+      now = TIMESPEC_TO_NS(clock);
+    }
+
+    updateMac(record->macAddress, record->bssid, record->packets, (record->timestamp > 0) ? record->timestamp : now);
+  }
+  unlockAndReport();
+}
+
+/**
+ * Determines the tracked MAC address with the largest count.  The MAC address is copied to
+ * macAddress.  If there are no tracked MAC addresses, NULL is returned and macAddress is left
+ * unmodified.
+ *
+ * @param macAddress (MacAddress *) - where the MAC address should be stored
+ *
+ * @return (MacAddress *) macAddress
+ */
+MacAddress *macQueuePeek(MacAddress *macAddress) {
+  SpaceSavingCounter *largest;
+
+  pthread_mutex_lock(&counterMutex);
+  largest = largestCounter(-1);
+  if(!largest) {
+    pthread_mutex_unlock(&counterMutex);
+
+    return NULL;
+  }
+
+  *macAddress = STATION_KEY_MAC(largest->key);
+  pthread_mutex_unlock(&counterMutex);
+
+  return macAddress;
+}
+
+/**
+ * Returns the number of tracked MAC addresses, which never exceeds
+ * NETFREE_SPACE_SAVING_SIZE.  The count is read without taking counterMutex, so it may
+ * already be out of date when it is returned.
+ *
+ * @return (int) the length of the queue
+ */
+int macQueueLength() {
+  return __atomic_load_n(&counterCount, __ATOMIC_RELAXED);
+}
+
+/**
+ * Returns the number of bytes the queue holds for its counters.  The queue never grows, so
+ * this is fixed once the queue is initialized.
+ *
+ * @return (size_t) the memory used by the queue, in bytes
+ */
+size_t macQueueMemory() {
+  return NETFREE_SPACE_SAVING_SIZE * (sizeof(SpaceSavingCounter) + sizeof(SpaceSavingCounter *) + sizeof(StationEstimate)) + counterIndex.capacity * sizeof(MacIndexSlot);
+}
+
+/**
+ * Copies the state of the tracked stations, in no particular order.
+ *
+ * @param states (StationState *) - where the states are stored
+ * @param capacity (int) - the number of states that fit in states
+ *
+ * @return (int) the number of states stored.  If it equals capacity, there may have been
+ *  more stations than fit.
+ */
+int exportMacQueue(StationState *states, int capacity) {
+  SpaceSavingCounter *counter;
+  StationState       *state = states;
+
+  pthread_mutex_lock(&counterMutex);
+  for(counter = counters; counter < counters + counterCount && state < states + capacity; counter++, state++) {
+    state->macAddress = STATION_KEY_MAC(counter->key);
+    state->packets = counter->count;
+    state->error = counter->error;
+    state->lastReceived = counter->lastUpdated;
+    state->weight = counter->count;
+    state->bssid = partitionBssids[counter->partition];
+  }
+  pthread_mutex_unlock(&counterMutex);
+
+  return state - states;
+}
+
+/**
+ * Lists the BSSIDs whose partitions hold stations.  The stations heard without a BSSID are
+ * listed as BSSID 0.
+ *
+ * @param bssids (MacAddress *) - where the BSSIDs are stored
+ * @param capacity (int) - the number of BSSIDs that fit in bssids
+ *
+ * @return (int) the number of BSSIDs stored
+ */
+int macQueuePartitions(MacAddress *bssids, int capacity) {
+  int count = 0;
+  int partition;
+
+  pthread_mutex_lock(&counterMutex);
+  for(partition = 0; partition < partitionCount && count < capacity; partition++) {
+    if(partitionLengths[partition]) {
+      bssids[count++] = partitionBssids[partition];
+    }
+  }
+  pthread_mutex_unlock(&counterMutex);
+
+  return count;
+}
+
+/**
+ * Returns the number of tracked stations last heard with a BSSID.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ *
+ * @return (int) the number of stations in the BSSID's partition
+ */
+int macQueuePartitionLength(MacAddress bssid) {
+  int partition;
+  int length = 0;
+
+  pthread_mutex_lock(&counterMutex);
+  if((partition = findPartition(bssid, 0)) != -1) {
+    length = partitionLengths[partition];
+  }
+  pthread_mutex_unlock(&counterMutex);
+
+  return length;
+}
+
+/**
+ * Determines the MAC address with the largest count among the stations last heard with a
+ * BSSID.  If there are none, NULL is returned and macAddress is left unmodified.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param macAddress (MacAddress *) - where the MAC address should be stored
+ *
+ * @return (MacAddress *) macAddress
+ */
+MacAddress *macQueuePartitionPeek(MacAddress bssid, MacAddress *macAddress) {
+  SpaceSavingCounter *largest = NULL;
+  int                 partition;
+
+  pthread_mutex_lock(&counterMutex);
+  if((partition = findPartition(bssid, 0)) != -1 && (largest = largestCounter(partition))) {
+    *macAddress = STATION_KEY_MAC(largest->key);
+  }
+  pthread_mutex_unlock(&counterMutex);
+
+  return largest ? macAddress : NULL;
+}
+
+/**
+ * Copies the state of the tracked stations last heard with a BSSID, in no particular order.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param states (StationState *) - where the states are stored
+ * @param capacity (int) - the number of states that fit in states
+ *
+ * @return (int) the number of states stored.  If it equals capacity, there may have been
+ *  more stations than fit.
+ */
+int exportMacQueuePartition(MacAddress bssid, StationState *states, int capacity) {
+  SpaceSavingCounter *counter;
+  StationState       *state = states;
+  int                 partition;
+  int32_t             index;
+
+  pthread_mutex_lock(&counterMutex);
+  partition = findPartition(bssid, 0);
+  for(index = (partition != -1) ? partitionHeads[partition] : -1; index != -1 && state < states + capacity; index = counter->next) {
+    counter = &counters[index];
+    state->macAddress = STATION_KEY_MAC(counter->key);
+    state->packets = counter->count;
+    state->error = counter->error;
+    state->lastReceived = counter->lastUpdated;
+    state->weight = counter->count;
+    state->bssid = bssid;
+    state++;
+  }
+  pthread_mutex_unlock(&counterMutex);
+
+  return state - states;
+}
+
+/**
+ * Records the state of stations, typically exported by an earlier run, as if the packets
+ * they describe had just been received.  Each station's error is carried over, so the
+ * restored estimates keep their guarantees.
+ *
+ * @param states (StationState *) - the states to record
+ * @param count (int) - the number of states
+ */
+void importMacQueue(StationState *states, int count) {
+  SpaceSavingCounter *counter;
+  StationState       *state;
+
+  pthread_mutex_lock(&counterMutex);
+  for(state = states; state < states + count; state++) {
+    if(!state->packets) {
+      continue;
+    }
+
+    counter = updateMac(state->macAddress, state->bssid, state->packets, state->lastReceived);
+    counter->error += state->error;
+  }
+  unlockAndReport();
+}
+
+/**
+ * Stops tracking a counter's station.  counterMutex must be held by the caller.
+ *
+ * @param counter (SpaceSavingCounter *) - the counter to release
+ *
+ * @return (MacAddress) the MAC address the counter tracked
+ */
+static MacAddress removeCounter(SpaceSavingCounter *counter) {
+  SpaceSavingCounter *last;
+  MacAddress          macAddress = STATION_KEY_MAC(counter->key);
+  unsigned int        position;
+
+  macIndexRemove(&counterIndex, counter->key);
+  unlinkCounter(counter);
+
+  // Fill the hole in the heap with its last counter.
+  position = counter->heapIndex;
+  __atomic_store_n(&counterCount, counterCount - 1, __ATOMIC_RELAXED);
+  if(position != (unsigned int) counterCount) {
+    last = counterHeap[counterCount];
+    placeCounter(last, position);
+    siftCounterUp(last);
+    siftCounterDown(last);
+  }
+
+  // Keep the counters contiguous by moving the last one into the freed slot.
+  last = &counters[counterCount];
+  if(counter != last) {
+    *counter = *last;
+    counterHeap[counter->heapIndex] = counter;
+    macIndexInsert(&counterIndex, counter->key, counter);
+
+    // Its neighbors in the partition's list still point to the slot it left.
+    if(counter->previous != -1) {
+      counters[counter->previous].next = counter - counters;
+    } else {
+      partitionHeads[counter->partition] = counter - counters;
+    }
+
+    if(counter->next != -1) {
+      counters[counter->next].previous = counter - counters;
+    }
+  }
+
+  return macAddress;
+}
+
+/**
+ * Stops tracking the MAC address with the largest count and returns it.
+ *
+ * @param macAddress (MacAddress *) - either NULL or where the MAC address should be stored.
+ *  If macAddress is NULL, the MAC address will not be set
+ *
+ * @return (MacAddress *) macAddress, or NULL if the queue was empty
+ */
+MacAddress *dequeueMac(MacAddress *macAddress) {
+  SpaceSavingCounter *largest;
+  MacAddress          removed;
+
+  pthread_mutex_lock(&counterMutex);
+  largest = largestCounter(-1);
+  if(largest) {
+    removed = removeCounter(largest);
+    if(macAddress) {
+      *macAddress = removed;
+    }
+  }
+  unlockAndReport();
+
+  return largest ? macAddress : NULL;
+}
+
+/**
+ * Stops tracking the MAC address with the largest count among the stations last heard with
+ * a BSSID and returns it.
+ *
+ * @param bssid (MacAddress) - the BSSID, or 0 for the stations heard without one
+ * @param macAddress (MacAddress *) - either NULL or where the MAC address should be stored.
+ *  If macAddress is NULL, the MAC address will not be set
+ *
+ * @return (MacAddress *) macAddress, or NULL if no station was left in the partition
+ */
+MacAddress *dequeueMacFromPartition(MacAddress bssid, MacAddress *macAddress) {
+  SpaceSavingCounter *largest = NULL;
+  MacAddress          removed;
+  int                 partition;
+
+  pthread_mutex_lock(&counterMutex);
+  if((partition = findPartition(bssid, 0)) != -1 && (largest = largestCounter(partition))) {
+    removed = removeCounter(largest);
+    if(macAddress) {
+      *macAddress = removed;
+    }
+  }
+  unlockAndReport();
+
+  return largest ? macAddress : NULL;
+}
+
+/**
+ * Compares two StationEstimates so that larger counts sort first.
+ */
+static int compareEstimates(const void *a, const void *b) {
+  uint32_t left = ((const StationEstimate *) a)->count;
+  uint32_t right = ((const StationEstimate *) b)->count;
+
+  return (left < right) - (left > right);
+}
+
+/**
+ * Reports the tracked stations with the largest counts, largest first.
+ *
+ * @param estimates (StationEstimate *) - where at least k estimates can be stored
+ * @param k (int) - the maximum number of stations to report
+ *
+ * @return (int) the number of estimates stored
+ */
+int spaceSavingTopK(StationEstimate *estimates, int k) {
+  int slot;
+  int reported;
+
+  pthread_mutex_lock(&counterMutex);
+  for(slot = 0; slot < counterCount; slot++) {
+    estimateScratch[slot].macAddress = STATION_KEY_MAC(counters[slot].key);
+    estimateScratch[slot].count = counters[slot].count;
+    estimateScratch[slot].error = counters[slot].error;
+  }
+
+  qsort(estimateScratch, counterCount, sizeof(StationEstimate), compareEstimates);
+
+  reported = (counterCount < k) ? counterCount : k;
+  memcpy(estimates, estimateScratch, reported * sizeof(StationEstimate));
+  pthread_mutex_unlock(&counterMutex);
+
+  return reported;
+}
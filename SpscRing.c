@@ -0,0 +1,135 @@
+/**
+ * This file implements the single-producer/single-consumer ring described in SpscRing.h.
+ * head and tail only ever increase; a record's slot is its index masked by the capacity.
+ * The producer publishes records with a release store of tail, and the consumer frees
+ * slots with a release store of head, so neither side needs a lock.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "SpscRing.h"
+
+/**
+ * Initializes an empty ring.
+ *
+ * @param ring (SpscRing *) - the ring to initialize
+ * @param capacity (unsigned int) - the number of records the ring can hold, which must be a
+ *  power of 2
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
+ */
+int initSpscRing(SpscRing *ring, unsigned int capacity) {
+  memset(ring, 0, sizeof(SpscRing));
+
+  ring->records = (MacRecord *) aligned_alloc(NETFREE_CACHE_LINE_SIZE, capacity * sizeof(MacRecord));
+  ring->mask = capacity - 1;
+
+  return ring->records ? 0 : -1;
+}
+
+/**
+ * Frees the memory held by the ring.  Neither the producer nor the consumer may use the
+ * ring afterwards.
+ *
+ * @param ring (SpscRing *) - the ring to destroy
+ */
+void destroySpscRing(SpscRing *ring) {
+  free(ring->records);
+
+  ring->records = NULL;
+}
+
+/**
+ * Appends records to the ring.  May only be called by the producer.  This function never
+ * blocks: if the ring does not have room for every record, the records that do not fit are
+ * dropped and added to the ring's overflow count.
+ *
+ * @param ring (SpscRing *) - the ring to append to
+ * @param records (MacRecord *) - the records to append
+ * @param count (int) - the number of records
+ *
+ * @return (int) the number of records appended
+ */
+int spscRingPush(SpscRing *ring, MacRecord *records, int count) {
+  uint64_t tail = ring->tail;
+  uint64_t capacity = ring->mask + 1;
+  uint64_t available;
+  uint64_t first;
+  int      pushed;
+
+  available = capacity - (tail - ring->cachedHead);
+  if(available < (uint64_t) count) {
+    ring->cachedHead = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    available = capacity - (tail - ring->cachedHead);
+  }
+
+  pushed = (available < (uint64_t) count) ? (int) available : count;
+  if(pushed < count) {
+    __atomic_store_n(&ring->overflows, ring->overflows + (count - pushed), __ATOMIC_RELAXED);
+  }
+
+  // Copy in at most two pieces: up to the end of the buffer, then from its start.
+  first = capacity - (tail & ring->mask);
+  if(first > (uint64_t) pushed) {
+    first = pushed;
+  }
+
+  memcpy(ring->records + (tail & ring->mask), records, first * sizeof(MacRecord));
+  memcpy(ring->records, records + first, (pushed - first) * sizeof(MacRecord));
+
+  __atomic_store_n(&ring->tail, tail + pushed, __ATOMIC_RELEASE);
+
+  return pushed;
+}
+
+/**
+ * Removes up to max records from the ring.  May only be called by the consumer.
+ *
+ * @param ring (SpscRing *) - the ring to remove records from
+ * @param records (MacRecord *) - where the removed records are copied
+ * @param max (int) - the maximum number of records to remove
+ *
+ * @return (int) the number of records removed, 0 if the ring was empty
+ */
+int spscRingPop(SpscRing *ring, MacRecord *records, int max) {
+  uint64_t head = ring->head;
+  uint64_t capacity = ring->mask + 1;
+  uint64_t ready;
+  uint64_t first;
+  int      popped;
+
+  ready = ring->cachedTail - head;
+  if(ready < (uint64_t) max) {
+    ring->cachedTail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    ready = ring->cachedTail - head;
+  }
+
+  popped = (ready < (uint64_t) max) ? (int) ready : max;
+  if(!popped) {
+    return 0;
+  }
+
+  first = capacity - (head & ring->mask);
+  if(first > (uint64_t) popped) {
+    first = popped;
+  }
+
+  memcpy(records, ring->records + (head & ring->mask), first * sizeof(MacRecord));
+  memcpy(records + first, ring->records, (popped - first) * sizeof(MacRecord));
+
+  __atomic_store_n(&ring->head, head + popped, __ATOMIC_RELEASE);
+
+  return popped;
+}
+
+/**
+ * Returns the number of records the producer has dropped because the ring was full.  Safe
+ * to call from any thread.
+ *
+ * @param ring (SpscRing *) - the ring to query
+ *
+ * @return (uint64_t) the number of records dropped
+ */
+uint64_t spscRingOverflows(SpscRing *ring) {
+  return __atomic_load_n(&ring->overflows, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,121 @@
+/**
+ * This file implements the slab allocator described in StationSlab.h.  Chunks are aligned
+ * to a cache line and records are carved out of them back to back, so records allocated
+ * together (as stations usually are when a capture starts) share cache lines and pages
+ * instead of being scattered across the heap.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "StationSlab.h"
+
+struct StationSlabChunkStruct {
+  StationSlabChunk *next;
+  char              records[] __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+};
+
+/**
+ * Initializes an empty slab.  No memory is allocated until the first record is requested.
+ *
+ * @param slab (StationSlab *) - the slab to initialize
+ * @param recordSize (size_t) - the size of every record, which must be at least the size of
+ *  a pointer
+ * @param limit (unsigned int) - the maximum number of records handed out at once, or 0 for
+ *  no limit
+ *
+ * @return (int) 0 on success, -1 if recordSize is too small
+ */
+int initStationSlab(StationSlab *slab, size_t recordSize, unsigned int limit) {
+  memset(slab, 0, sizeof(StationSlab));
+
+  if(recordSize < sizeof(void *)) {
+    return -1;
+  }
+
+  slab->recordSize = recordSize;
+  slab->limit = limit;
+
+  return 0;
+}
+
+/**
+ * Frees every chunk of the slab, and with them every record, whether or not it was freed.
+ *
+ * @param slab (StationSlab *) - the slab to destroy
+ */
+void destroyStationSlab(StationSlab *slab) {
+  StationSlabChunk *chunk;
+
+  while(slab->chunks) {
+    chunk = slab->chunks;
+    slab->chunks = chunk->next;
+
+    free(chunk);
+  }
+
+  slab->freeList = NULL;
+  slab->unused = NULL;
+  slab->chunkEnd = NULL;
+  slab->reserved = 0;
+  slab->allocated = 0;
+}
+
+/**
+ * Hands out a zeroed record, reusing a freed one if possible.
+ *
+ * @param slab (StationSlab *) - the slab from which the record should be taken
+ *
+ * @return (void *) the record, or NULL if the slab's limit has been reached or memory could
+ *  not be allocated
+ */
+void *stationSlabAlloc(StationSlab *slab) {
+  StationSlabChunk *chunk;
+  void             *record;
+  size_t            chunkSize;
+
+  if(slab->limit && slab->allocated >= slab->limit) {
+    return NULL;
+  }
+
+  if(slab->freeList) {
+    record = slab->freeList;
+    slab->freeList = *(void **) record;
+  } else {
+    if(slab->unused == slab->chunkEnd) {
+      // aligned_alloc() requires the size to be a multiple of the alignment.
+      chunkSize = sizeof(StationSlabChunk) + slab->recordSize * NETFREE_SLAB_CHUNK_RECORDS;
+      chunkSize = (chunkSize + NETFREE_CACHE_LINE_SIZE - 1) & ~((size_t) NETFREE_CACHE_LINE_SIZE - 1);
+
+      chunk = (StationSlabChunk *) aligned_alloc(NETFREE_CACHE_LINE_SIZE, chunkSize);
+      if(!chunk) {
+        return NULL;
+      }
+
+      chunk->next = slab->chunks;
+      slab->chunks = chunk;
+      slab->reserved += chunkSize;
+      slab->unused = chunk->records;
+      slab->chunkEnd = chunk->records + slab->recordSize * NETFREE_SLAB_CHUNK_RECORDS;
+    }
+
+    record = slab->unused;
+    slab->unused += slab->recordSize;
+  }
+
+  slab->allocated++;
+  memset(record, 0, slab->recordSize);
+
+  return record;
+}
+
+/**
+ * Returns a record to the slab so it can be handed out again.
+ *
+ * @param slab (StationSlab *) - the slab from which the record was taken
+ * @param record (void *) - the record to return
+ */
+void stationSlabFree(StationSlab *slab, void *record) {
+  *(void **) record = slab->freeList;
+  slab->freeList = record;
+  slab->allocated--;
+}
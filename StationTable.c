@@ -0,0 +1,127 @@
+/**
+ * This file implements the per-worker station table described in StationTable.h.  Slots are
+ * probed linearly from a multiplicative hash of the packed MAC address, which keeps a
+ * lookup within one or two cache lines for any reasonable load.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "StationTable.h"
+
+/**
+ * Initializes an empty table.
+ *
+ * @param table (StationTable *) - the table to initialize
+ * @param capacity (unsigned int) - the number of slots, which must be a power of 2
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
+ */
+int initStationTable(StationTable *table, unsigned int capacity) {
+  table->entries = (StationEntry *) calloc(capacity, sizeof(StationEntry));
+  table->capacity = capacity;
+  table->length = 0;
+
+  return table->entries ? 0 : -1;
+}
+
+/**
+ * Frees the memory held by the table.
+ *
+ * @param table (StationTable *) - the table to destroy
+ */
+void destroyStationTable(StationTable *table) {
+  free(table->entries);
+
+  table->entries = NULL;
+  table->length = 0;
+}
+
+/**
+ * Removes every entry from the table without releasing its memory.
+ *
+ * @param table (StationTable *) - the table to clear
+ */
+void clearStationTable(StationTable *table) {
+  if(table->length) {
+    memset(table->entries, 0, table->capacity * sizeof(StationEntry));
+    table->length = 0;
+  }
+}
+
+/**
+ * Records packets from the specified MAC address.
+ *
+ * @param table (StationTable *) - the table to update
+ * @param macAddress (MacAddress) - the MAC address that sent the packets
+ * @param bssid (MacAddress) - the BSSID the packets were sent in, or 0 if it is unknown
+ * @param packets (uint32_t) - the number of packets received
+ * @param timestamp (int64_t) - the time, in nanoseconds, the last of these packets was received
+ *
+ * @return (int) 0 on success.  -1 is returned if the MAC address is new and the table is
+ *  full, in which case the table should be merged and cleared before trying again.
+ */
+int stationTableAdd(StationTable *table, MacAddress macAddress, MacAddress bssid, uint32_t packets, int64_t timestamp) {
+  uint64_t      key = STATION_KEY(macAddress);
+  unsigned int  slot = STATION_HASH(key, table->capacity);
+  StationEntry *entry;
+
+  for(entry = &table->entries[slot]; entry->key; entry = &table->entries[slot]) {
+    if(entry->key == key) {
+      entry->packetsReceived += packets;
+      if(timestamp > entry->lastReceived) {
+        entry->lastReceived = timestamp;
+      }
+
+      if(bssid) {
+        entry->bssid = bssid;
+      }
+
+      return 0;
+    }
+
+    slot = (slot + 1) & (table->capacity - 1);
+  }
+
+  if(STATION_TABLE_FULL(table)) {
+    return -1;
+  }
+
+  entry->key = key;
+  entry->bssid = bssid;
+  entry->packetsReceived = packets;
+  entry->lastReceived = timestamp;
+  table->length++;
+
+  return 0;
+}
+
+/**
+ * Records a batch of MacRecords.  The slot for the record NETFREE_PREFETCH_DISTANCE ahead
+ * is prefetched while the current record is applied, so the cache misses of consecutive
+ * lookups overlap instead of being paid one after another.
+ *
+ * @param table (StationTable *) - the table to update
+ * @param records (MacRecord *) - the records to apply
+ * @param count (int) - the number of records
+ *
+ * @return (int) the number of records applied.  This is less than count only if the table
+ *  filled up, in which case the table should be merged and cleared before the remaining
+ *  records are applied.
+ */
+int stationTableAddBatch(StationTable *table, MacRecord *records, int count) {
+  int      recordIndex;
+  uint64_t key;
+
+  for(recordIndex = 0; recordIndex < count; recordIndex++) {
+    if(recordIndex + NETFREE_PREFETCH_DISTANCE < count) {
+      key = STATION_KEY(records[recordIndex + NETFREE_PREFETCH_DISTANCE].macAddress);
+      __builtin_prefetch(&table->entries[STATION_HASH(key, table->capacity)], 1);
+    }
+
+    if(stationTableAdd(table, records[recordIndex].macAddress, records[recordIndex].bssid, records[recordIndex].packets, records[recordIndex].timestamp)) {
+      break;
+    }
+  }
+
+  return recordIndex;
+}
@@ -0,0 +1,181 @@
+/**
+ * This file implements the pipeline statistics described in Stats.h.  The blocks are
+ * preallocated so a thread can register without allocating, and a block is never reused
+ * until the statistics are reset.
+ */
+#include <string.h>
+
+#include "Stats.h"
+
+StatsBlock statsBlocks[NETFREE_STATS_MAX_THREADS];
+int        statsBlockCount = 0;
+uint64_t   statsGauges[STAT_GAUGES];
+
+char *statsCounterNames[STAT_COUNTERS] = {
+  "frames received",
+  "frames parsed",
+  "frames kept",
+  "rejected (radiotap)",
+  "rejected (truncated)",
+  "rejected (bad FCS)",
+  "rejected (unwanted)",
+  "kernel received",
+  "kernel drops",
+  "interface drops",
+  "records enqueued",
+  "rejected (not data)"
+};
+
+char *statsGaugeNames[STAT_GAUGES] = {
+  "handoff drops",
+  "stations",
+  "station memory (bytes)"
+};
+
+char *statsHistogramNames[STAT_HISTOGRAMS] = {
+  "enqueue latency",
+  "ranking latency"
+};
+
+/**
+ * Zeroes every counter, gauge and histogram and forgets every registered block.  No thread
+ * may be using a block while the statistics are reset.
+ */
+void resetStats() {
+  memset(statsBlocks, 0, sizeof(statsBlocks));
+  memset(statsGauges, 0, sizeof(statsGauges));
+  statsBlockCount = 0;
+}
+
+/**
+ * Hands the calling thread a block of its own to count in.  Only the thread the block was
+ * handed to may write it.
+ *
+ * @return (StatsBlock *) the block, or NULL once NETFREE_STATS_MAX_THREADS blocks have been
+ *  handed out.  Blocks are never shared, since their counts are not updated atomically.
+ */
+StatsBlock *registerStatsBlock() {
+  int blockIndex = __atomic_fetch_add(&statsBlockCount, 1, __ATOMIC_RELAXED);
+
+  if(blockIndex >= NETFREE_STATS_MAX_THREADS) {
+    return NULL;
+  }
+
+  return &statsBlocks[blockIndex];
+}
+
+/**
+ * Publishes the current value of a gauge.
+ *
+ * @param gauge (int) - the gauge to set (one of the STAT_ gauge indices)
+ * @param value (uint64_t) - its value
+ */
+void setStatsGauge(int gauge, uint64_t value) {
+  __atomic_store_n(&statsGauges[gauge], value, __ATOMIC_RELAXED);
+}
+
+/**
+ * Adds the counters and histograms of a block to a snapshot, so callers can total a subset
+ * of the blocks (those of one interface, ...).  Its owner may keep counting meanwhile.
+ *
+ * @param snapshot (StatsSnapshot *) - where the block is added
+ * @param block (StatsBlock *) - the block to add
+ */
+void addStatsBlock(StatsSnapshot *snapshot, StatsBlock *block) {
+  int index;
+  int bucket;
+
+  for(index = 0; index < STAT_COUNTERS; index++) {
+    snapshot->counters[index] += __atomic_load_n(&block->counters[index], __ATOMIC_RELAXED);
+  }
+
+  for(index = 0; index < STAT_HISTOGRAMS; index++) {
+    for(bucket = 0; bucket < NETFREE_STATS_BUCKETS; bucket++) {
+      snapshot->histograms[index][bucket] += __atomic_load_n(&block->histograms[index][bucket], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+/**
+ * Sums every registered block into a snapshot.  Threads may keep counting while the
+ * snapshot is taken, so two values of a snapshot are not necessarily from the same instant.
+ *
+ * @param snapshot (StatsSnapshot *) - where the totals are stored
+ */
+void getStats(StatsSnapshot *snapshot) {
+  StatsBlock *block;
+  int         blockCount = __atomic_load_n(&statsBlockCount, __ATOMIC_RELAXED);
+  int         index;
+
+  memset(snapshot, 0, sizeof(StatsSnapshot));
+
+  if(blockCount > NETFREE_STATS_MAX_THREADS) {
+    blockCount = NETFREE_STATS_MAX_THREADS;
+  }
+
+  for(block = statsBlocks; block < statsBlocks + blockCount; block++) {
+    addStatsBlock(snapshot, block);
+  }
+
+  for(index = 0; index < STAT_GAUGES; index++) {
+    snapshot->gauges[index] = __atomic_load_n(&statsGauges[index], __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * Estimates a percentile of a histogram.  The estimate is the upper bound of the bucket the
+ * percentile falls in, so it is within a factor of 2 of the real value.
+ *
+ * @param snapshot (StatsSnapshot *) - the snapshot holding the histogram
+ * @param histogram (int) - the histogram to read (one of the STAT_ histogram indices)
+ * @param percentile (double) - the percentile, between 0 and 1
+ *
+ * @return (uint64_t) the estimate, in nanoseconds, or 0 if the histogram is empty
+ */
+uint64_t statsPercentile(StatsSnapshot *snapshot, int histogram, double percentile) {
+  uint64_t total = 0;
+  uint64_t seen = 0;
+  int      bucket;
+
+  for(bucket = 0; bucket < NETFREE_STATS_BUCKETS; bucket++) {
+    total += snapshot->histograms[histogram][bucket];
+  }
+
+  for(bucket = 0; bucket < NETFREE_STATS_BUCKETS; bucket++) {
+    seen += snapshot->histograms[histogram][bucket];
+    if(seen && seen >= percentile * total) {
+      return bucket ? 1ULL << bucket : 0;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Prints every counter and gauge, and the median, 99th percentile and maximum of every
+ * histogram.
+ *
+ * @param stream (FILE *) - where the statistics are printed
+ */
+void dumpStats(FILE *stream) {
+  StatsSnapshot snapshot;
+  int           index;
+
+  getStats(&snapshot);
+
+  fprintf(stream, "Statistics:\n");
+  for(index = 0; index < STAT_COUNTERS; index++) {
+    fprintf(stream, "\t%-24s%lu\n", statsCounterNames[index], (unsigned long) snapshot.counters[index]);
+  }
+
+  for(index = 0; index < STAT_GAUGES; index++) {
+    fprintf(stream, "\t%-24s%lu\n", statsGaugeNames[index], (unsigned long) snapshot.gauges[index]);
+  }
+
+  for(index = 0; index < STAT_HISTOGRAMS; index++) {
+    fprintf(stream, "\t%-24sp50 < %.1fus, p99 < %.1fus, max < %.1fus\n", statsHistogramNames[index],
+            statsPercentile(&snapshot, index, 0.5) / 1000.0,
+            statsPercentile(&snapshot, index, 0.99) / 1000.0,
+            statsPercentile(&snapshot, index, 1.0) / 1000.0);
+  }
+}
@@ -0,0 +1,246 @@
+/**
+ * Microbenchmarks of the MacQueue.h API.  Every combination of station count (100, 1k, 10k
+ * and 100k), workload and writer count is run against a fresh queue:
+ *
+ *  - uniform: every station is equally likely to send the next packet
+ *  - zipf:    station popularity follows a Zipf distribution with an exponent of 1
+ *  - churn:   stations arrive and leave continuously.  Packets come from a window of
+ *             stations that slides forward, and every fourth operation dequeues the top
+ *             station instead of recording a packet
+ *
+ * Each run first records one packet from every station, then times the workload's
+ * operations split across the writers, then times macQueuePeek() and finally times draining
+ * the queue with dequeueMac(), both from a single thread.  The operations are generated
+ * before the clock starts.
+ *
+ * The results are printed as CSV, one line per run and operation, with the queue
+ * implementation (the MAC_QUEUE the benchmark was built with) in the first column so
+ * implementations can be compared by concatenating their output:
+ *
+ *      make bench MAC_QUEUE=SpaceSavingMacQueue && ./bin/bench_mac_queue [-o operations]
+ *          [-t writers] [-S seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "MacQueue.h"
+#include "MacRecord.h"
+#include "Workload.h"
+
+#ifndef BENCH_MAC_QUEUE
+  #define BENCH_MAC_QUEUE "unknown"
+#endif
+
+#define WORKLOAD_UNIFORM  0
+#define WORKLOAD_ZIPF     1
+#define WORKLOAD_CHURN    2
+
+#define CHURN_DEQUEUE     0               // An operation that dequeues instead of recording a packet
+#define CHURN_SLIDE       4               // Operations per step the churn window slides
+
+#define BENCH_ZIPF_EXPONENT 1.0
+
+typedef struct BenchWriterStruct {
+  pthread_t         thread;
+  pthread_barrier_t *start;
+  MacAddress       *operations;
+  unsigned long     count;
+  int64_t           firstTimestamp;
+} BenchWriter;
+
+char *workloadNames[] = {"uniform", "zipf", "churn"};
+unsigned int stationCounts[] = {100, 1000, 10000, 100000};
+
+/**
+ * Returns CLOCK_MONOTONIC in nanoseconds.
+ */
+int64_t benchNow() {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return TIMESPEC_TO_NS(now);
+}
+
+/**
+ * Generates the operations of a run.  Every operation is the MAC address of the station
+ * that sends the next packet, or CHURN_DEQUEUE.
+ *
+ * @param workload (int) - one of the WORKLOAD_ constants
+ * @param stations (unsigned int) - the number of stations
+ * @param count (unsigned long) - the number of operations
+ * @param seed (uint64_t) - the seed of the generator
+ *
+ * @return (MacAddress *) the operations, which the caller must free
+ */
+MacAddress *generateOperations(int workload, unsigned int stations, unsigned long count, uint64_t seed) {
+  MacAddress    *operations = (MacAddress *) malloc(count * sizeof(MacAddress));
+  double        *cumulative = NULL;
+  uint64_t       state = seed ? seed : 1;
+  unsigned long  operation;
+
+  if(workload == WORKLOAD_ZIPF) {
+    cumulative = buildZipf(stations, BENCH_ZIPF_EXPONENT);
+  }
+
+  for(operation = 0; operation < count; operation++) {
+    if(workload == WORKLOAD_UNIFORM) {
+      operations[operation] = stationMac(nextRandom(&state) % stations);
+    } else if(workload == WORKLOAD_ZIPF) {
+      operations[operation] = stationMac(drawStation(cumulative, stations, &state));
+    } else if(operation % 4 == 3) {
+      operations[operation] = CHURN_DEQUEUE;
+    } else {
+      operations[operation] = stationMac(operation / CHURN_SLIDE + nextRandom(&state) % stations);
+    }
+  }
+
+  free(cumulative);
+
+  return operations;
+}
+
+/**
+ * The start routine of a writer.  It applies its share of the operations once every
+ * writer is ready.
+ *
+ * @param ptr (void *) - the BenchWriter to run
+ */
+void *runWriter(void *ptr) {
+  BenchWriter   *writer = (BenchWriter *) ptr;
+  unsigned long  operation;
+
+  pthread_barrier_wait(writer->start);
+
+  for(operation = 0; operation < writer->count; operation++) {
+    if(writer->operations[operation] == CHURN_DEQUEUE) {
+      dequeueMac(NULL);
+    } else {
+      enqueueMac(writer->operations[operation], writer->firstTimestamp + operation * 1000);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Prints one result line.
+ */
+void printResult(char *workload, unsigned int stations, int writers, char *operation, unsigned long count, int64_t elapsed) {
+  printf("%s,%s,%u,%d,%s,%lu,%.1f,%.0f\n", BENCH_MAC_QUEUE, workload, stations, writers, operation, count,
+         count ? (double) elapsed / count : 0.0, elapsed > 0 ? count * 1.0e9 / elapsed : 0.0);
+}
+
+/**
+ * Runs a workload against a fresh queue and prints its results.
+ *
+ * @param workload (int) - one of the WORKLOAD_ constants
+ * @param stations (unsigned int) - the number of stations
+ * @param writerCount (int) - the number of threads recording packets
+ * @param count (unsigned long) - the number of operations, split evenly across the writers
+ * @param seed (uint64_t) - the seed of the generator
+ */
+void runBenchmark(int workload, unsigned int stations, int writerCount, unsigned long count, uint64_t seed) {
+  BenchWriter       *writers = (BenchWriter *) calloc(writerCount, sizeof(BenchWriter));
+  MacAddress        *operations;
+  MacAddress         top;
+  pthread_barrier_t  start;
+  unsigned long      peeks;
+  unsigned long      dequeued;
+  unsigned int       station;
+  int64_t            began;
+  int                writerIndex;
+
+  operations = generateOperations(workload, stations, count, seed);
+  if(initMacQueue()) {
+    fprintf(stderr, "Could not allocate the MAC queue.\n");
+    exit(1);
+  }
+
+  for(station = 0; station < stations; station++) {
+    enqueueMac(stationMac(station), NETFREE_NS_PER_SECOND);
+  }
+
+  pthread_barrier_init(&start, NULL, writerCount + 1);
+  for(writerIndex = 0; writerIndex < writerCount; writerIndex++) {
+    writers[writerIndex].start = &start;
+    writers[writerIndex].operations = operations + writerIndex * (count / writerCount);
+    writers[writerIndex].count = count / writerCount;
+    writers[writerIndex].firstTimestamp = 2 * NETFREE_NS_PER_SECOND + writerIndex;
+    pthread_create(&writers[writerIndex].thread, NULL, runWriter, &writers[writerIndex]);
+  }
+
+  pthread_barrier_wait(&start);
+  began = benchNow();
+  for(writerIndex = 0; writerIndex < writerCount; writerIndex++) {
+    pthread_join(writers[writerIndex].thread, NULL);
+  }
+
+  printResult(workloadNames[workload], stations, writerCount, workload == WORKLOAD_CHURN ? "mixed" : "enqueue", (count / writerCount) * writerCount, benchNow() - began);
+  pthread_barrier_destroy(&start);
+
+  began = benchNow();
+  for(peeks = 0; peeks < count; peeks++) {
+    macQueuePeek(&top);
+  }
+
+  printResult(workloadNames[workload], stations, writerCount, "peek", peeks, benchNow() - began);
+
+  began = benchNow();
+  for(dequeued = 0; dequeueMac(&top); dequeued++);
+
+  printResult(workloadNames[workload], stations, writerCount, "dequeue", dequeued, benchNow() - began);
+
+  destroyMacQueue();
+  free(operations);
+  free(writers);
+}
+
+int main(int argc, char **argv) {
+  unsigned long  count = 1000000;
+  uint64_t       seed = 1;
+  int            writerCounts[2] = {1, 4};
+  int            option;
+  int            workload;
+  int            stationIndex;
+  int            writerIndex;
+
+  while((option = getopt(argc, argv, "o:t:S:")) != -1) {
+    switch(option) {
+      case 'o':
+        count = strtoul(optarg, NULL, 10);
+        break;
+      case 't':
+        writerCounts[1] = atoi(optarg);
+        break;
+      case 'S':
+        seed = strtoull(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-o operations] [-t writers] [-S seed]\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  if(writerCounts[1] < 1) {
+    fprintf(stderr, "At least one writer is required.\n");
+    exit(1);
+  }
+
+  printf("implementation,workload,stations,writers,operation,count,ns_per_op,ops_per_sec\n");
+
+  for(workload = WORKLOAD_UNIFORM; workload <= WORKLOAD_CHURN; workload++) {
+    for(stationIndex = 0; stationIndex < sizeof(stationCounts) / sizeof(stationCounts[0]); stationIndex++) {
+      for(writerIndex = 0; writerIndex < 2; writerIndex++) {
+        runBenchmark(workload, stationCounts[stationIndex], writerCounts[writerIndex], count, seed);
+        fflush(stdout);
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,254 @@
+/**
+ * An end-to-end benchmark of the capture pipeline.  Synthetic radiotap + 802.11 frames are
+ * written to an in-memory pcap file, which the scanner then replays as fast as it can, so
+ * the frames take exactly the path live frames take: the capture filter, the radiotap and
+ * 802.11 parser, the classifier, the handoff to the aggregation thread and enqueueMacBatch().
+ *
+ * Stations are drawn from a Zipf distribution (an exponent of 0 is uniform).  Besides the
+ * data frames stations send to the router, the mix contains frames the router sends,
+ * broadcasts, beacons and frames that failed their checksum, in configurable proportions.
+ *
+ *      make bench && ./bin/bench_pipeline [-n frames] [-s stations] [-z zipfExponent]
+ *          [-r routerShare] [-b broadcastShare] [-m managementShare] [-f badFcsShare]
+ *          [-S seed]
+ *
+ * The per-frame latency is the time from the scanner reading a frame until the frame's
+ * record reaches the MAC queue, as recorded in the STAT_ENQUEUE_LATENCY histogram.
+ */
+#define _GNU_SOURCE
+#include <pcap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include "scanner.h"
+#include "HeaderParser.h"
+#include "MacRecord.h"
+#include "Stats.h"
+#include "mac.h"
+#include "Workload.h"
+
+#define BENCH_ROUTER_MAC      0x02aa00000001ULL
+#define BENCH_DEVICE_MAC      0x02bb00000001ULL
+#define BENCH_BROADCAST_MAC   0xffffffffffffULL
+
+// Radiotap header with flags, rate, channel and antenna signal, padded to 16 bytes.
+#define BENCH_RADIOTAP_LENGTH 16
+#define BENCH_RADIOTAP_FIELDS ((1U << RADIOTAP_FLAGS) | (1U << RADIOTAP_RATE) | (1U << RADIOTAP_CHANNEL) | (1U << RADIOTAP_DBM_ANTSIGNAL))
+
+#define BENCH_FRAME_DATA      0x08
+#define BENCH_FRAME_BEACON    0x80
+#define BENCH_TO_DS           0x01
+#define BENCH_FROM_DS         0x02
+
+#define BENCH_MAX_FRAME       1600
+
+typedef struct BenchConfigStruct {
+  unsigned long frames;
+  unsigned int  stations;
+  double        zipfExponent;
+  double        routerShare;
+  double        broadcastShare;
+  double        managementShare;
+  double        badFcsShare;
+  uint64_t      seed;
+} BenchConfig;
+
+/**
+ * Writes a frame into buffer.
+ *
+ * @return (unsigned int) the length of the frame
+ */
+unsigned int buildFrame(u_char *buffer, uint8_t frameControl, uint8_t flags, MacAddress receiver, MacAddress transmitter, MacAddress address3, int badFcs, unsigned int payload) {
+  RadioTapHeader *radioTapHeader = (RadioTapHeader *) buffer;
+  u_char         *wifi = buffer + BENCH_RADIOTAP_LENGTH;
+  uint16_t        channel[2] = {htole16(2437), htole16(0x00a0)};
+
+  memset(buffer, 0, BENCH_RADIOTAP_LENGTH + 24);
+
+  radioTapHeader->version = 0;
+  radioTapHeader->headerLength = htole16(BENCH_RADIOTAP_LENGTH);
+  radioTapHeader->dataFieldsPresent = htole32(BENCH_RADIOTAP_FIELDS);
+  buffer[8] = badFcs ? RADIOTAP_FLAG_BAD_FCS : 0;
+  buffer[9] = 108;                                  // 54 Mb/s
+  memcpy(buffer + 10, channel, sizeof(channel));
+  buffer[14] = (u_char) -45;                        // dBm
+
+  wifi[0] = frameControl;
+  wifi[1] = flags;
+  unpackMac(receiver, (char *) wifi + 4);
+  unpackMac(transmitter, (char *) wifi + 10);
+  unpackMac(address3, (char *) wifi + 16);
+
+  memset(wifi + 24, 0xaa, payload);
+
+  return BENCH_RADIOTAP_LENGTH + 24 + payload;
+}
+
+/**
+ * Writes the synthetic capture to an in-memory file.
+ *
+ * @param config (BenchConfig *) - what to generate
+ * @param path (char *) - where the path of the file is stored
+ * @param pathSize (size_t) - the number of bytes available at path
+ *
+ * @return (int) 0 on success, -1 otherwise
+ */
+int writeCapture(BenchConfig *config, char *path, size_t pathSize) {
+  u_char              frame[BENCH_MAX_FRAME];
+  struct pcap_pkthdr  header;
+  pcap_t             *deadHandle;
+  pcap_dumper_t      *dumper;
+  FILE               *file;
+  double             *cumulative;
+  double              kind;
+  uint64_t            state = config->seed ? config->seed : 1;
+  MacAddress          station;
+  unsigned long       frameIndex;
+  unsigned int        payload;
+  int                 descriptor;
+
+  descriptor = memfd_create("netfree-bench", 0);
+  if(descriptor == -1 || !(file = fdopen(descriptor, "w+"))) {
+    return -1;
+  }
+
+  deadHandle = pcap_open_dead(DLT_IEEE802_11_RADIO, BENCH_MAX_FRAME);
+  dumper = pcap_dump_fopen(deadHandle, file);
+  if(!dumper) {
+    pcap_close(deadHandle);
+
+    return -1;
+  }
+
+  cumulative = buildZipf(config->stations, config->zipfExponent);
+  memset(&header, 0, sizeof(header));
+
+  for(frameIndex = 0; frameIndex < config->frames; frameIndex++) {
+    station = stationMac(drawStation(cumulative, config->stations, &state));
+    payload = 40 + nextRandom(&state) % (BENCH_MAX_FRAME - BENCH_RADIOTAP_LENGTH - 24 - 40);
+    kind = nextUniform(&state);
+
+    if(kind < config->managementShare) {
+      header.len = buildFrame(frame, BENCH_FRAME_BEACON, 0, BENCH_BROADCAST_MAC, BENCH_ROUTER_MAC, BENCH_ROUTER_MAC, 0, payload);
+    } else if((kind -= config->managementShare) < config->broadcastShare) {
+      header.len = buildFrame(frame, BENCH_FRAME_DATA, BENCH_FROM_DS, BENCH_BROADCAST_MAC, BENCH_ROUTER_MAC, station, 0, payload);
+    } else if((kind -= config->broadcastShare) < config->routerShare) {
+      header.len = buildFrame(frame, BENCH_FRAME_DATA, BENCH_FROM_DS, station, BENCH_ROUTER_MAC, BENCH_ROUTER_MAC, 0, payload);
+    } else {
+      kind -= config->routerShare;
+      header.len = buildFrame(frame, BENCH_FRAME_DATA, BENCH_TO_DS, BENCH_ROUTER_MAC, station, BENCH_ROUTER_MAC, kind < config->badFcsShare, payload);
+    }
+
+    // The file holds what a capture with the default snapshot length would have kept.
+    header.caplen = header.len < NETFREE_DEFAULT_SNAPLEN ? header.len : NETFREE_DEFAULT_SNAPLEN;
+    header.ts.tv_sec = frameIndex / 1000000;
+    header.ts.tv_usec = frameIndex % 1000000;
+
+    pcap_dump((u_char *) dumper, &header, frame);
+  }
+
+  free(cumulative);
+  pcap_dump_flush(dumper);
+  pcap_close(deadHandle);
+
+  // The descriptor stays open (and the file alive) until the benchmark exits.
+  snprintf(path, pathSize, "/proc/self/fd/%d", descriptor);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  BenchConfig   config = {1000000, 1000, 1.0, 0.10, 0.05, 0.10, 0.01, 1};
+  ScannerConfig scannerConfig;
+  StatsSnapshot stats;
+  struct rusage usage;
+  char          capturePath[64];
+  char          routerMac[NETFREE_MAC_SIZE];
+  char          deviceMac[NETFREE_MAC_SIZE];
+  double        elapsed;
+  int           option;
+
+  while((option = getopt(argc, argv, "n:s:z:r:b:m:f:S:")) != -1) {
+    switch(option) {
+      case 'n':
+        config.frames = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        config.stations = strtoul(optarg, NULL, 10);
+        break;
+      case 'z':
+        config.zipfExponent = atof(optarg);
+        break;
+      case 'r':
+        config.routerShare = atof(optarg);
+        break;
+      case 'b':
+        config.broadcastShare = atof(optarg);
+        break;
+      case 'm':
+        config.managementShare = atof(optarg);
+        break;
+      case 'f':
+        config.badFcsShare = atof(optarg);
+        break;
+      case 'S':
+        config.seed = strtoull(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n frames] [-s stations] [-z zipfExponent] [-r routerShare] [-b broadcastShare] [-m managementShare] [-f badFcsShare] [-S seed]\n", argv[0]);
+        exit(1);
+    }
+  }
+
+  if(!config.frames || !config.stations) {
+    fprintf(stderr, "At least one frame and one station are required.\n");
+    exit(1);
+  }
+
+  if(writeCapture(&config, capturePath, sizeof(capturePath))) {
+    fprintf(stderr, "Could not write the synthetic capture.\n");
+    exit(1);
+  }
+
+  unpackMac(BENCH_ROUTER_MAC, routerMac);
+  unpackMac(BENCH_DEVICE_MAC, deviceMac);
+
+  defaultScannerConfig(&scannerConfig);
+  scannerConfig.captureBackend = NETFREE_CAPTURE_REPLAY;
+  scannerConfig.replayFile = capturePath;
+  scannerConfig.replaySpeed = NETFREE_REPLAY_FASTEST;
+  scannerConfig.routerMac = routerMac;
+  scannerConfig.deviceMac = deviceMac;
+
+  if(initScanner(NULL, &scannerConfig)) {
+    exit(1);
+  }
+
+  scan();
+  while(!scanFinished()) {
+    usleep(1000);
+  }
+
+  elapsed = scanDuration();
+  getStats(&stats);
+  destroyScanner();
+  getrusage(RUSAGE_SELF, &usage);
+
+  printf("frames\t\t%lu\n", config.frames);
+  printf("stations\t%u (zipf %.2f)\n", config.stations, config.zipfExponent);
+  printf("kept\t\t%lu\n", (unsigned long) stats.counters[STAT_FRAMES_KEPT]);
+  printf("seconds\t\t%.3f\n", elapsed);
+  printf("frames/sec\t%.0f\n", config.frames / elapsed);
+  printf("ns/frame\t%.1f\n", elapsed * 1.0e9 / config.frames);
+  printf("latency p50\t< %.1fus\n", statsPercentile(&stats, STAT_ENQUEUE_LATENCY, 0.5) / 1000.0);
+  printf("latency p99\t< %.1fus\n", statsPercentile(&stats, STAT_ENQUEUE_LATENCY, 0.99) / 1000.0);
+  printf("peak RSS\t%ld KiB\n", usage.ru_maxrss);
+
+  return 0;
+}
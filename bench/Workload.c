@@ -0,0 +1,79 @@
+/**
+ * This file implements the workload generation described in Workload.h.
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "Workload.h"
+
+/**
+ * A xorshift64* generator.  The state must never be 0.
+ */
+uint64_t nextRandom(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+
+  return *state * 0x2545f4914f6cdd1dULL;
+}
+
+/**
+ * Returns a uniformly distributed double in [0, 1).
+ */
+double nextUniform(uint64_t *state) {
+  return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Builds the cumulative distribution of a Zipf distribution over the stations.
+ *
+ * @param stations (unsigned int) - the number of stations
+ * @param exponent (double) - the Zipf exponent; 0 gives every station the same weight
+ *
+ * @return (double *) the distribution, which the caller must free
+ */
+double *buildZipf(unsigned int stations, double exponent) {
+  double       *cumulative = (double *) malloc(stations * sizeof(double));
+  double        total = 0;
+  unsigned int  rank;
+
+  for(rank = 0; rank < stations; rank++) {
+    total += 1.0 / pow(rank + 1, exponent);
+    cumulative[rank] = total;
+  }
+
+  for(rank = 0; rank < stations; rank++) {
+    cumulative[rank] /= total;
+  }
+
+  return cumulative;
+}
+
+/**
+ * Draws a station from a distribution built by buildZipf().
+ */
+unsigned int drawStation(double *cumulative, unsigned int stations, uint64_t *state) {
+  double        target = nextUniform(state);
+  unsigned int  low = 0;
+  unsigned int  high = stations - 1;
+  unsigned int  middle;
+
+  while(low < high) {
+    middle = (low + high) / 2;
+    if(cumulative[middle] < target) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low;
+}
+
+/**
+ * Returns the MAC address of a station.  The index is scrambled so that popular stations
+ * are not neighbours in the MAC queue's hash tables.
+ */
+MacAddress stationMac(unsigned int station) {
+  return BENCH_STATION_PREFIX | ((station * 0x9e3779b1ULL) & 0xffffffffULL);
+}
@@ -0,0 +1,18 @@
+#ifndef _NETFREE_BENCH_WORKLOAD
+  #define _NETFREE_BENCH_WORKLOAD
+
+  #include <stdint.h>
+  #include "mac.h"
+
+  /**
+   * Deterministic workload generation shared by the benchmarks, so runs with the same seed
+   * see the same stations in the same order.
+   */
+  #define BENCH_STATION_PREFIX  0x020000000000ULL   // Locally administered, unicast
+
+  extern uint64_t     nextRandom(uint64_t *);
+  extern double       nextUniform(uint64_t *);
+  extern double      *buildZipf(unsigned int, double);
+  extern unsigned int drawStation(double *, unsigned int, uint64_t *);
+  extern MacAddress   stationMac(unsigned int);
+#endif
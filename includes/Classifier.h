@@ -0,0 +1,42 @@
+#ifndef _NETFREE_CLASSIFIER
+  #define _NETFREE_CLASSIFIER
+
+  #include <stdint.h>
+  #include "mac.h"
+
+  /**
+   * A Classifier compares the addresses of a batch of 802.11 frames against a small set of
+   * reference addresses (this device, the router, ...) and checks their group (broadcast or
+   * multicast) bit, producing one bitmask per frame.  The comparisons are done with AVX2 or
+   * SSE2 when the CPU supports them; the implementation is chosen once, at run time.
+   */
+  #define CLASSIFY_ADDRESSES                  4       // addr1 through addr4
+  #define NETFREE_CLASSIFIER_MAX_REFERENCES   7
+
+  // Stored in place of an address the frame does not carry; it matches nothing.
+  #define CLASSIFY_NO_ADDRESS                 (1ULL << 63)
+  #define CLASSIFY_GROUP_BIT                  (1ULL << 40)    // The I/G bit of the first octet
+
+  // Bits of a frame's mask.  address is 0 for addr1 through 3 for addr4.
+  #define CLASSIFY_MATCH(reference, address)  (1U << ((reference) * CLASSIFY_ADDRESSES + (address)))
+  #define CLASSIFY_GROUP(address)             (1U << (NETFREE_CLASSIFIER_MAX_REFERENCES * CLASSIFY_ADDRESSES + (address)))
+
+  typedef struct FrameAddressesStruct FrameAddresses;
+  struct FrameAddressesStruct {
+    MacAddress addresses[CLASSIFY_ADDRESSES];
+  } __attribute__((aligned(32)));
+
+  typedef struct ClassifierStruct Classifier;
+  typedef void (*ClassifyFunction)(const Classifier *, const FrameAddresses *, int, uint32_t *);
+
+  struct ClassifierStruct {
+    MacAddress        references[NETFREE_CLASSIFIER_MAX_REFERENCES];
+    int               referenceCount;
+    ClassifyFunction  classify;
+    const char       *implementation;
+  };
+
+  extern int  initClassifier(Classifier *, const MacAddress *, int);
+  extern int  setClassifierImplementation(Classifier *, const char *);
+  extern void classifyFrames(const Classifier *, const FrameAddresses *, int, uint32_t *);
+#endif
@@ -0,0 +1,59 @@
+#ifndef _NETFREE_EVENT_LOOP
+  #define _NETFREE_EVENT_LOOP
+
+  #include <stdint.h>
+  #include <signal.h>
+
+  /**
+   * A small epoll event loop.  A thread that owns a loop sleeps in epoll_wait() until one of
+   * its sources is ready, so it neither polls nor wakes up when there is nothing to do:
+   *
+   *  - descriptors owned by the caller (a pcap selectable fd, an eventfd, stdin, ...)
+   *  - timers, which the loop implements with timerfds
+   *  - signals, which the loop receives through a signalfd.  The signals must be blocked in
+   *    every thread, which is easiest done before any thread is started.
+   *
+   * Handlers run on the loop's thread, one at a time.  Any thread may stop a loop.
+   */
+  #ifndef NETFREE_EVENT_SOURCES
+    #define NETFREE_EVENT_SOURCES   8       // Sources per loop
+  #endif
+
+  /* Source kinds */
+  #define EVENT_SOURCE_DESCRIPTOR   0
+  #define EVENT_SOURCE_TIMER        1
+  #define EVENT_SOURCE_SIGNALS      2
+
+  typedef struct EventLoopStruct EventLoop;
+
+  /**
+   * Handles a ready source.  value is the epoll events of a descriptor, the number of
+   * expirations of a timer or the number of a signal received.
+   */
+  typedef void (*EventHandler)(EventLoop *, void *, uint64_t);
+
+  typedef struct EventSourceStruct EventSource;
+  struct EventSourceStruct {
+    int           descriptor;     // -1 when the slot is free
+    int           kind;
+    EventHandler  handler;
+    void         *context;
+  };
+
+  struct EventLoopStruct {
+    int           epoll;
+    int           wake;           // eventfd written by stopEventLoop()
+    int           stopped;
+    int           status;         // What runEventLoop() returns
+    EventSource   sources[NETFREE_EVENT_SOURCES];
+  };
+
+  extern int  initEventLoop(EventLoop *);
+  extern void destroyEventLoop(EventLoop *);
+  extern int  addEventDescriptor(EventLoop *, int, uint32_t, EventHandler, void *);
+  extern int  addEventTimer(EventLoop *, int, EventHandler, void *);
+  extern int  addEventSignals(EventLoop *, sigset_t *, EventHandler, void *);
+  extern void removeEventSource(EventLoop *, int);
+  extern int  runEventLoop(EventLoop *);
+  extern void stopEventLoop(EventLoop *, int);
+#endif
@@ -5,18 +5,39 @@
   #include <stdint.h>
   #include "mac.h"
 
-  #define WIFI_START(radioTapHeader)              (int) radioTapHeader->headerLength + radioTapHeader
-  #define WIFI_FLAG_PROTOCOL_VERSION(wifiHeader)  wifiHeader->frameControl & 0xc000
-  #define WIFI_FLAG_TYPE(wifiHeader)              wifiHeader->frameControl & 0x3000
-  #define WIFI_FLAG_SUBTYPE(wifiHeader)           wifiHeader->frameControl & 0x0f00
-  #define WIFI_FLAG_AP_TO                         wifiHeader->frameControl & 0x0080
-  #define WIFI_FLAG_AP_FROM                       wifiHeader->frameControl & 0x0040
-  #define WIFI_FLAG_MORE_FRAG                     wifiHeader->frameControl & 0x0020
-  #define WIFI_FLAG_RETRY                         wifiHeader->frameControl & 0x0010
-  #define WIFI_FLAG_POWER_MGT                     wifiHeader->frameControl & 0x0008
-  #define WIFI_FLAG_MORE_DATA                     wifiHeader->frameControl & 0x0004
-  #define WIFI_FLAG_WEP                           wifiHeader->frameControl & 0x0002
-  #define WIFI_FLAG_RSVD                          wifiHeader->frameControl & 0x0001
+  #define WIFI_START(radioTapHeader)              ((u_char *) (radioTapHeader) + (radioTapHeader)->headerLength)
+
+  /* 802.11 frame control.  The first byte holds the version, type and subtype, the second the flags. */
+  #define WIFI_FC_VERSION(fc0)        ((fc0) & 0x03)
+  #define WIFI_FC_TYPE(fc0)           (((fc0) >> 2) & 0x03)
+  #define WIFI_FC_SUBTYPE(fc0)        ((fc0) >> 4)
+  #define WIFI_FC_TO_DS               0x01
+  #define WIFI_FC_FROM_DS             0x02
+  #define WIFI_FC_MORE_FRAG           0x04
+  #define WIFI_FC_RETRY               0x08
+  #define WIFI_FC_POWER_MGT           0x10
+  #define WIFI_FC_MORE_DATA           0x20
+  #define WIFI_FC_PROTECTED           0x40
+  #define WIFI_FC_ORDER               0x80    // +HTC in QoS data frames
+
+  #define WIFI_TYPE_MANAGEMENT        0
+  #define WIFI_TYPE_CONTROL           1
+  #define WIFI_TYPE_DATA              2
+  #define WIFI_TYPE_EXTENSION         3
+
+  #define WIFI_SUBTYPE_QOS            0x08    // Set in the subtype of QoS data frames
+
+  /* FrameDescriptor flags */
+  #define FRAME_RETRY                 0x01
+  #define FRAME_PROTECTED             0x02
+  #define FRAME_QOS                   0x04
+  #define FRAME_HT_CONTROL            0x08
+  #define FRAME_TO_DS                 0x10
+  #define FRAME_FROM_DS               0x20
+
+  /* Reasons decodeFrame() rejects a frame */
+  #define FRAME_REJECT_TYPE           -1      // Not a version 0 data frame (management, control, ...)
+  #define FRAME_REJECT_TRUNCATED      -2      // Shorter than its header (and, if protected, its IV)
 
   #define IP_START(packetPtr)         packetPtr + sizeof(EthernetHeader)
   #define IP_VERSION(ipHeader)        ipHeader->versionAndHeaderLength >> 4
@@ -37,6 +58,45 @@
   #define TCP_FLAG_SYN(tcpHeader)     tcpHeader->flags & 0x002
   #define TCP_FLAG_FIN(tcpHeader)     tcpHeader->flags & 0x001
 
+  /* Radiotap fields (bit indices within the default radiotap namespace) */
+  #define RADIOTAP_TSFT               0
+  #define RADIOTAP_FLAGS              1
+  #define RADIOTAP_RATE               2
+  #define RADIOTAP_CHANNEL            3
+  #define RADIOTAP_FHSS               4
+  #define RADIOTAP_DBM_ANTSIGNAL      5
+  #define RADIOTAP_DBM_ANTNOISE       6
+  #define RADIOTAP_LOCK_QUALITY       7
+  #define RADIOTAP_TX_ATTENUATION     8
+  #define RADIOTAP_DB_TX_ATTENUATION  9
+  #define RADIOTAP_DBM_TX_POWER       10
+  #define RADIOTAP_ANTENNA            11
+  #define RADIOTAP_DB_ANTSIGNAL       12
+  #define RADIOTAP_DB_ANTNOISE        13
+  #define RADIOTAP_RX_FLAGS           14
+  #define RADIOTAP_TX_FLAGS           15
+  #define RADIOTAP_RTS_RETRIES        16
+  #define RADIOTAP_DATA_RETRIES       17
+  #define RADIOTAP_XCHANNEL           18
+  #define RADIOTAP_MCS                19
+  #define RADIOTAP_AMPDU_STATUS       20
+  #define RADIOTAP_VHT                21
+  #define RADIOTAP_TIMESTAMP          22
+  #define RADIOTAP_HE                 23
+  #define RADIOTAP_HE_MU              24
+  #define RADIOTAP_HE_MU_OTHER_USER   25
+  #define RADIOTAP_ZERO_LENGTH_PSDU   26
+  #define RADIOTAP_LSIG               27
+  #define RADIOTAP_TLV                28
+  #define RADIOTAP_RADIOTAP_NAMESPACE 29
+  #define RADIOTAP_VENDOR_NAMESPACE   30
+  #define RADIOTAP_EXT                31
+
+  #define RADIOTAP_FLAG_FCS           0x10    // The frame ends with its 4 byte FCS
+  #define RADIOTAP_FLAG_BAD_FCS       0x40    // The frame failed its FCS check
+
+  #define RADIOTAP_HAS(fields, field) ((fields)->present & (1U << (field)))
+
   typedef struct RadioTapHeaderStruct RadioTapHeader;
   struct RadioTapHeaderStruct {
     u_int8_t  version;
@@ -45,6 +105,71 @@
     u_int32_t dataFieldsPresent;
   };
 
+  /**
+   * Walks every field of a radiotap header in order, following extended present bitmaps and
+   * skipping vendor namespaces.  fieldIndex and fieldData describe the field most recently
+   * returned by nextRadioTapField().  fieldIndex is only meaningful while the iterator is in
+   * the radiotap namespace (i.e. not inside a vendor namespace).
+   */
+  typedef struct RadioTapIteratorStruct RadioTapIterator;
+  struct RadioTapIteratorStruct {
+    const u_char *header;
+    const u_char *end;
+    const u_char *data;               // Where the next field's data may start (before alignment)
+    const u_char *nextPresentWord;
+    const u_char *vendorNamespaceEnd; // Where the data of a vendor namespace that is about to start ends
+    u_int32_t     presentWord;
+    u_int32_t     remainingBits;
+    int           wordIndex;          // Index of presentWord among all present bitmaps
+    int           inVendorNamespace;
+    int           nextNamespace;      // The namespace that starts with the next present bitmap
+
+    int           fieldIndex;
+    const u_char *fieldData;
+    int           fieldSize;
+  };
+
+  /**
+   * The fields later stages care about, extracted from a radiotap header in a single pass.
+   * A field is only valid if its bit is set in present (see RADIOTAP_HAS()).
+   */
+  typedef struct RadioTapFieldsStruct RadioTapFields;
+  struct RadioTapFieldsStruct {
+    u_int64_t tsft;               // Hardware timestamp, in microseconds
+    u_int32_t present;
+    u_int16_t channelFrequency;   // MHz
+    u_int16_t channelFlags;
+    u_int8_t  flags;
+    u_int8_t  rate;               // 500 kbps units
+    int8_t    antennaSignal;      // dBm
+  };
+
+  extern int initRadioTapIterator(RadioTapIterator *, const u_char *, unsigned int);
+  extern int nextRadioTapField(RadioTapIterator *);
+  extern int parseRadioTap(const u_char *, unsigned int, RadioTapFields *);
+
+  /**
+   * What later stages need to know about an 802.11 data frame, decoded once by decodeFrame()
+   * so nothing downstream reads the raw header again.  The receiver and transmitter are addr1
+   * and addr2.  The BSSID is whichever address the To DS and From DS bits say it is, and 0
+   * for frames between two access points (both bits set), which carry none and are the only
+   * frames with a fourth address.
+   */
+  typedef struct FrameDescriptorStruct FrameDescriptor;
+  struct FrameDescriptorStruct {
+    MacAddress  transmitter;
+    MacAddress  receiver;
+    MacAddress  bssid;
+    MacAddress  address4;         // 0 unless both To DS and From DS are set
+    u_int8_t    type;
+    u_int8_t    subtype;
+    u_int8_t    flags;            // FRAME_ flags
+    u_int8_t    headerLength;     // Including the QoS and HT control fields
+    u_int16_t   payloadOffset;    // Past the header and, if the frame is protected, its IV
+  };
+
+  extern int decodeFrame(const u_char *, unsigned int, FrameDescriptor *);
+
   typedef struct EthernetHeaderStruct EthernetHeader;
   struct EthernetHeaderStruct {
     u_char  destination[NETFREE_MAC_SIZE];
@@ -52,17 +177,6 @@
     u_short type;
   };
 
-  typedef struct WiFiHeaderStruct WiFiHeader;
-  struct WiFiHeaderStruct {
-    u_int16_t frameControl;
-    u_int16_t connectionId;
-    u_char    addr1[NETFREE_MAC_SIZE];
-    u_char    addr2[NETFREE_MAC_SIZE];
-    u_char    addr3[NETFREE_MAC_SIZE];
-    u_int16_t sequenceNumber;
-    u_char    addr4[NETFREE_MAC_SIZE];
-  };
-
   typedef struct IpHeaderStruct IpHeader;
   struct IpHeaderStruct {
     u_char          versionAndHeaderLength;
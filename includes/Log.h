@@ -0,0 +1,97 @@
+#ifndef _NETFREE_LOG
+  #define _NETFREE_LOG
+
+  #include <stdint.h>
+
+  /**
+   * Logging that stays off the capture path.  While logging is started, a message is
+   * formatted into a record of the calling thread's own LogRing and a background thread
+   * writes the records to stderr, so a thread that logs never waits on stderr or on another
+   * thread.  A full ring drops the message and counts it instead.  Before logging is started
+   * (and after it is stopped), messages are written to stderr directly.
+   *
+   * Every call site is rate limited to NETFREE_LOG_SITE_RATE messages per second; the number
+   * of messages suppressed is appended to the next one the site logs.  Calls below
+   * NETFREE_LOG_LEVEL are compiled out entirely, arguments included.
+   */
+  #define NETFREE_LOG_DEBUG       0
+  #define NETFREE_LOG_INFO        1
+  #define NETFREE_LOG_WARNING     2
+  #define NETFREE_LOG_ERROR       3
+
+  #ifndef NETFREE_LOG_LEVEL
+    #define NETFREE_LOG_LEVEL       NETFREE_LOG_INFO
+  #endif
+
+  #ifndef NETFREE_CACHE_LINE_SIZE
+    #define NETFREE_CACHE_LINE_SIZE 64
+  #endif
+
+  #ifndef NETFREE_LOG_RING_SIZE
+    #define NETFREE_LOG_RING_SIZE   256     // Records per thread; must be a power of 2
+  #endif
+
+  #ifndef NETFREE_LOG_MESSAGE_SIZE
+    #define NETFREE_LOG_MESSAGE_SIZE 248    // Longer messages are truncated
+  #endif
+
+  #ifndef NETFREE_LOG_MAX_THREADS
+    #define NETFREE_LOG_MAX_THREADS 64
+  #endif
+
+  #ifndef NETFREE_LOG_SITE_RATE
+    #define NETFREE_LOG_SITE_RATE   10      // Messages per second per call site
+  #endif
+
+  #ifndef NETFREE_LOG_FLUSH_US
+    #define NETFREE_LOG_FLUSH_US    10000   // How long the logging thread sleeps when every ring is empty
+  #endif
+
+  typedef struct LogSiteStruct LogSite;
+  struct LogSiteStruct {
+    int       level;
+    int64_t   window;       // The second the count applies to
+    uint32_t  count;        // Messages logged during window
+    uint32_t  suppressed;   // Messages dropped by the rate limit since the site last logged
+  };
+
+  typedef struct LogRecordStruct LogRecord;
+  struct LogRecordStruct {
+    uint32_t  suppressed;
+    uint16_t  level;
+    uint16_t  length;
+    char      message[NETFREE_LOG_MESSAGE_SIZE];
+  };
+
+  typedef struct LogRingStruct LogRing;
+  struct LogRingStruct {
+    // Written by the thread that owns the ring; dropped is also reset by the logging thread.
+    uint64_t   tail __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+    uint64_t   dropped;
+
+    // Written by the logging thread only.
+    uint64_t   head __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+
+    LogRecord  records[NETFREE_LOG_RING_SIZE] __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+  };
+
+  /**
+   * Logs a printf-style message, without a trailing newline, at the specified level.  Each
+   * expansion has its own LogSite and thus its own rate limit.
+   */
+  #define NETFREE_LOG(level, ...)   do { \
+                                      if((level) >= NETFREE_LOG_LEVEL) { \
+                                        static LogSite logSite = {(level), 0, 0, 0}; \
+                                        logMessage(&logSite, __VA_ARGS__); \
+                                      } \
+                                    } while(0)
+
+  #define NETFREE_DEBUG(...)        NETFREE_LOG(NETFREE_LOG_DEBUG, __VA_ARGS__)
+  #define NETFREE_INFO(...)         NETFREE_LOG(NETFREE_LOG_INFO, __VA_ARGS__)
+  #define NETFREE_WARNING(...)      NETFREE_LOG(NETFREE_LOG_WARNING, __VA_ARGS__)
+  #define NETFREE_ERROR(...)        NETFREE_LOG(NETFREE_LOG_ERROR, __VA_ARGS__)
+
+  extern void startLogging();
+  extern void stopLogging();
+  extern void logMessage(LogSite *, const char *, ...) __attribute__((format(printf, 2, 3)));
+#endif
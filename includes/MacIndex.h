@@ -0,0 +1,36 @@
+#ifndef _NETFREE_MAC_INDEX
+  #define _NETFREE_MAC_INDEX
+
+  #include <stdint.h>
+  #include "StationTable.h"
+
+  /**
+   * A MacIndex maps MAC addresses, keyed with STATION_KEY(), to the element that ranks them
+   * in a MAC queue.  It is an open-addressing table with linear probing that grows as
+   * stations are added, so finding a station never depends on how the queue orders them.
+   */
+  #ifndef NETFREE_MAC_INDEX_SIZE
+    #define NETFREE_MAC_INDEX_SIZE  1024    // Initial number of slots; must be a power of 2
+  #endif
+
+  #define MAC_INDEX_PREFETCH(index, key)  __builtin_prefetch(&(index)->slots[STATION_HASH(key, (index)->capacity)])
+
+  typedef struct MacIndexSlotStruct MacIndexSlot;
+  struct MacIndexSlotStruct {
+    uint64_t  key;      // 0 marks an empty slot
+    void     *value;
+  };
+
+  typedef struct MacIndexStruct MacIndex;
+  struct MacIndexStruct {
+    MacIndexSlot *slots;
+    unsigned int  capacity;
+    unsigned int  length;
+  };
+
+  extern int  initMacIndex(MacIndex *, unsigned int);
+  extern void destroyMacIndex(MacIndex *);
+  extern void *macIndexFind(MacIndex *, uint64_t);
+  extern int  macIndexInsert(MacIndex *, uint64_t, void *);
+  extern void macIndexRemove(MacIndex *, uint64_t);
+#endif
@@ -1,10 +1,35 @@
 #ifndef _NETFREE_MAC_QUEUE
   #define _NETFREE_MAC_QUEUE
 
-  extern void initMacQueue();
+  #include <stddef.h>
+  #include "MacRecord.h"
+
+  /**
+   * The MAC queue ranks the stations heard while scanning.  Stations are partitioned by the
+   * BSSID of the network they were last heard in, so the stations of a single network can be
+   * counted, ranked, exported and dequeued on their own.  The whole queue is the union of its
+   * partitions: macQueuePeek() and dequeueMac() consider every station whatever its BSSID.
+   *
+   * Stations heard without a BSSID form the partition of BSSID 0, which also takes the
+   * stations of any BSSID seen once NETFREE_MAX_PARTITIONS partitions exist.
+   */
+  #ifndef NETFREE_MAX_PARTITIONS
+    #define NETFREE_MAX_PARTITIONS  256     // BSSIDs tracked in partitions of their own, counting BSSID 0
+  #endif
+
+  extern int  initMacQueue();
   extern void destroyMacQueue();
-  extern void enqueueMac(char *, double);
-  extern char *macQueuePeek(char *);
-  extern int  macQueueLength();
-  extern char *dequeueMac(char *);
+  extern void       enqueueMac(MacAddress, int64_t);
+  extern void       enqueueMacBatch(MacRecord *, int);
+  extern MacAddress *macQueuePeek(MacAddress *);
+  extern int        macQueueLength();
+  extern size_t     macQueueMemory();
+  extern int        exportMacQueue(StationState *, int);
+  extern void       importMacQueue(StationState *, int);
+  extern MacAddress *dequeueMac(MacAddress *);
+  extern int        macQueuePartitions(MacAddress *, int);
+  extern int        macQueuePartitionLength(MacAddress);
+  extern MacAddress *macQueuePartitionPeek(MacAddress, MacAddress *);
+  extern int        exportMacQueuePartition(MacAddress, StationState *, int);
+  extern MacAddress *dequeueMacFromPartition(MacAddress, MacAddress *);
 #endif
\ No newline at end of file
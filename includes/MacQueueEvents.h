@@ -0,0 +1,41 @@
+#ifndef _NETFREE_MAC_QUEUE_EVENTS
+  #define _NETFREE_MAC_QUEUE_EVENTS
+
+  #include "MacRecord.h"
+
+  /**
+   * Notifications of changes to the MAC queue, so consumers can block in poll()/epoll_wait()
+   * instead of polling the queue.  A subscription is an eventfd the queue adds to whenever
+   * one of the subscribed events occurs; reading the eventfd returns (and clears) the number
+   * of events since the last read.  The queues only look at the subscriptions when someone
+   * subscribed to the event at hand, so an unwatched queue pays a single relaxed load per
+   * change.
+   *
+   * Events are raised by whichever thread changed the queue, after the change is visible to
+   * macQueueLength() and macQueuePeek().  Since reports are delivered after the queue's locks
+   * are released, writers may deliver them out of order.  Each report therefore carries a
+   * generation that the writer takes while it still holds its lock, and the length and top
+   * of a report older than one already delivered are ignored.
+   */
+  #define MAC_QUEUE_EVENT_LENGTH    0x1   // The number of stations rose to the subscription's threshold
+  #define MAC_QUEUE_EVENT_TOP       0x2   // A different station is now ranked first
+  #define MAC_QUEUE_EVENT_EVICTED   0x4   // Stations were dropped to make room for others; adds one per station
+
+  #ifndef NETFREE_MAC_QUEUE_SUBSCRIBERS
+    #define NETFREE_MAC_QUEUE_SUBSCRIBERS 8
+  #endif
+
+  // The union of the events someone is subscribed to.
+  extern int      macQueueWatchedEvents;
+  extern uint64_t macQueueGeneration;
+
+  #define MAC_QUEUE_WATCHED(events)   (__atomic_load_n(&macQueueWatchedEvents, __ATOMIC_RELAXED) & (events))
+
+  // Takes the generation of a change to report; the queue's lock must still be held.
+  #define MAC_QUEUE_NEXT_GENERATION() __atomic_add_fetch(&macQueueGeneration, 1, __ATOMIC_ACQ_REL)
+
+  extern int  subscribeMacQueue(int, int);
+  extern void unsubscribeMacQueue(int);
+  extern int  waitMacQueueEvent(int, int);
+  extern void notifyMacQueue(uint64_t, int, MacAddress, int);
+#endif
@@ -0,0 +1,42 @@
+#ifndef _NETFREE_MAC_RECORD
+  #define _NETFREE_MAC_RECORD
+
+  #include <stdint.h>
+  #include "mac.h"
+
+  #define NETFREE_NS_PER_SECOND   1000000000LL
+  #define TIMESPEC_TO_NS(time)    ((int64_t) (time).tv_sec * NETFREE_NS_PER_SECOND + (time).tv_nsec)
+  #define NS_TO_SECONDS(ns)       ((double) (ns) / NETFREE_NS_PER_SECOND)
+
+  #ifndef NETFREE_BATCH_SIZE
+    #define NETFREE_BATCH_SIZE  256   // Maximum number of MacRecords handed over at once
+  #endif
+
+  /**
+   * A MacRecord is the compact descriptor the capture side produces for every frame it
+   * keeps.  Records are collected into batches so the station tables can apply many frames
+   * per lock acquisition and per clock read.
+   */
+  typedef struct MacRecordStruct MacRecord;
+  struct MacRecordStruct {
+    MacAddress  macAddress;
+    MacAddress  bssid;        // The network the frame was sent in; 0 if the frame did not say
+    uint32_t    packets;
+    int64_t     timestamp;    // CLOCK_MONOTONIC nanoseconds; 0 or less means "now"
+  };
+
+  /**
+   * A StationState is everything a MAC queue knows about a station, in a form that does not
+   * depend on the queue's implementation.  Queues export their stations as StationStates so
+   * they can be saved and restored later (see Snapshot.h).
+   */
+  typedef struct StationStateStruct StationState;
+  struct StationStateStruct {
+    MacAddress  macAddress;
+    uint32_t    packets;
+    uint32_t    error;          // How much packets may overcount, for queues that estimate
+    int64_t     lastReceived;   // CLOCK_MONOTONIC nanoseconds
+    double      weight;         // Packets received, decayed to lastReceived by queues that decay
+    MacAddress  bssid;          // The network the station was last heard in; 0 if unknown
+  };
+#endif
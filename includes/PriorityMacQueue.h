@@ -4,5 +4,26 @@
   #define NETFREE_REVCOUNT_WEIGHT   1.5
   #define NETFREE_TIMEDELTA_WEIGHT  0.5
 
+  // Define NETFREE_DECAYED_PRIORITY to rank by exponentially decayed packet counts instead.
+  #ifndef NETFREE_DECAY_HALF_LIFE
+    #define NETFREE_DECAY_HALF_LIFE 30.0    // Seconds after which a packet counts half as much
+  #endif
+
+  #ifndef NETFREE_HEAP_ARITY
+    #define NETFREE_HEAP_ARITY      4       // Children per heap node; 4 keeps a node's children on one cache line
+  #endif
+
+  #ifndef NETFREE_HEAP_SIZE
+    #define NETFREE_HEAP_SIZE       16      // Initial number of heap slots per partition in a shard; a heap doubles when full
+  #endif
+
+  #ifndef NETFREE_QUEUE_SHARDS
+    #define NETFREE_QUEUE_SHARDS    8       // Must be a power of 2
+  #endif
+
+  #ifndef NETFREE_MAX_STATIONS
+    #define NETFREE_MAX_STATIONS    0       // Stations tracked at once across every shard; 0 means no limit
+  #endif
+
   #include "MacQueue.h"
 #endif
\ No newline at end of file
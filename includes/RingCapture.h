@@ -0,0 +1,59 @@
+#ifndef _NETFREE_RING_CAPTURE
+  #define _NETFREE_RING_CAPTURE
+
+  #include <stdint.h>
+  #include <linux/if_packet.h>
+  #include <linux/filter.h>
+
+  #ifndef NETFREE_RING_BLOCK_SIZE
+    #define NETFREE_RING_BLOCK_SIZE   (1 << 20)   // Bytes per ring block; must be a multiple of the page size
+  #endif
+
+  #ifndef NETFREE_RING_BLOCK_COUNT
+    #define NETFREE_RING_BLOCK_COUNT  64
+  #endif
+
+  #ifndef NETFREE_RING_FRAME_SIZE
+    #define NETFREE_RING_FRAME_SIZE   2048        // Only used by the kernel to size tp_frame_nr with TPACKET_V3
+  #endif
+
+  #ifndef NETFREE_RING_RETIRE_MS
+    #define NETFREE_RING_RETIRE_MS    60          // A partially filled block is handed to us after this long
+  #endif
+
+  #ifndef NETFREE_FANOUT_MODE
+    #define NETFREE_FANOUT_MODE       PACKET_FANOUT_HASH
+  #endif
+
+  #ifndef NETFREE_RING_POLL_MS
+    #define NETFREE_RING_POLL_MS      250
+  #endif
+
+  /**
+   * Walks the frames of a retired TPACKET_V3 block.  The kernel stores the frames back to
+   * back, each one pointing to the next with tp_next_offset.
+   */
+  #define RING_FIRST_FRAME(block)       (struct tpacket3_hdr *) ((uint8_t *) (block) + (block)->hdr.bh1.offset_to_first_pkt)
+  #define RING_NEXT_FRAME(frame)        (struct tpacket3_hdr *) ((uint8_t *) (frame) + (frame)->tp_next_offset)
+  #define RING_FRAME_DATA(frame)        ((const u_char *) (frame) + (frame)->tp_mac)
+  #define RING_BLOCK_FRAME_COUNT(block) (block)->hdr.bh1.num_pkts
+
+  typedef void (*RingBlockHandler)(void *, struct tpacket_block_desc *);
+
+  typedef struct RingCaptureStruct RingCapture;
+  struct RingCaptureStruct {
+    int                  socket;
+    uint8_t             *map;
+    struct tpacket_req3  request;
+    unsigned int         currentBlock;
+    volatile int         breakLoop;
+  };
+
+  extern int  initRingCapture(RingCapture *, char *);
+  extern void destroyRingCapture(RingCapture *);
+  extern int  ringCaptureSetFilter(RingCapture *, struct sock_fprog *);
+  extern int  ringCaptureJoinFanout(RingCapture *, int);
+  extern int  ringCaptureLoop(RingCapture *, RingBlockHandler, void *);
+  extern void ringCaptureBreakLoop(RingCapture *);
+  extern int  ringCaptureStatistics(RingCapture *, unsigned int *, unsigned int *);
+#endif
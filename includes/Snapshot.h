@@ -0,0 +1,38 @@
+#ifndef _NETFREE_SNAPSHOT
+  #define _NETFREE_SNAPSHOT
+
+  #include <stdint.h>
+  #include "MacRecord.h"
+
+  /**
+   * Snapshots of the MAC queue, so a restarted scanner picks up where the last one stopped
+   * instead of rediscovering every station.  A snapshot file is a SnapshotHeader followed by
+   * recordCount fixed size records, each a StationState.  Records are read with a stride of
+   * the recordSize stored in the header, so a later version may append fields to
+   * StationState and still read (and be read by) files written by earlier versions; fields
+   * a file does not have are read as 0.  Version 2 appended the station's BSSID.
+   *
+   * A snapshot is written to a temporary file next to its destination, flushed to disk and
+   * then renamed over the destination, so a crash leaves either the old snapshot or the new
+   * one, never a partial file.  Times are stored as CLOCK_REALTIME nanoseconds since the
+   * monotonic clock restarts with the machine.
+   */
+  #define NETFREE_SNAPSHOT_MAGIC    "NFSNAPSH"
+  #define NETFREE_SNAPSHOT_VERSION  2
+
+  #ifndef NETFREE_SNAPSHOT_INTERVAL_MS
+    #define NETFREE_SNAPSHOT_INTERVAL_MS 30000  // How often the MAC queue is saved while scanning
+  #endif
+
+  typedef struct SnapshotHeaderStruct SnapshotHeader;
+  struct SnapshotHeaderStruct {
+    char      magic[8];       // NETFREE_SNAPSHOT_MAGIC, without its terminating '\0'
+    uint32_t  version;
+    uint32_t  recordSize;     // Bytes per record; sizeof(StationState) of the version that wrote it
+    uint64_t  recordCount;
+    int64_t   savedAt;        // CLOCK_REALTIME nanoseconds
+  };
+
+  extern int saveSnapshot(const char *);
+  extern int loadSnapshot(const char *);
+#endif
@@ -0,0 +1,22 @@
+#ifndef _NETFREE_SPACE_SAVING_MAC_QUEUE
+  #define _NETFREE_SPACE_SAVING_MAC_QUEUE
+
+  #ifndef NETFREE_SPACE_SAVING_SIZE
+    #define NETFREE_SPACE_SAVING_SIZE 1024    // Stations tracked at once; must be a power of 2
+  #endif
+
+  #include "MacQueue.h"
+
+  /**
+   * The estimated packet count of a tracked station.  The true count lies between
+   * count - error and count.
+   */
+  typedef struct StationEstimateStruct StationEstimate;
+  struct StationEstimateStruct {
+    MacAddress  macAddress;
+    uint32_t    count;
+    uint32_t    error;
+  };
+
+  extern int spaceSavingTopK(StationEstimate *, int);
+#endif
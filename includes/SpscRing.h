@@ -0,0 +1,43 @@
+#ifndef _NETFREE_SPSC_RING
+  #define _NETFREE_SPSC_RING
+
+  #include <stdint.h>
+  #include "MacRecord.h"
+
+  #ifndef NETFREE_CACHE_LINE_SIZE
+    #define NETFREE_CACHE_LINE_SIZE 64
+  #endif
+
+  #ifndef NETFREE_SPSC_RING_SIZE
+    #define NETFREE_SPSC_RING_SIZE  65536   // MacRecords per ring; must be a power of 2
+  #endif
+
+  /**
+   * A bounded, lock-free ring of MacRecords with exactly one producer thread and one
+   * consumer thread.  The producer and consumer indices live on separate cache lines, and
+   * each side keeps a private copy of the other side's index so it only touches the shared
+   * line when its copy says the ring is full (or empty).  The producer never waits: records
+   * that do not fit are dropped and counted in overflows.
+   */
+  typedef struct SpscRingStruct SpscRing;
+  struct SpscRingStruct {
+    // Written by the producer only.
+    uint64_t   tail __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+    uint64_t   cachedHead;
+    uint64_t   overflows;
+
+    // Written by the consumer only.
+    uint64_t   head __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+    uint64_t   cachedTail;
+
+    // Read-only after initSpscRing().
+    MacRecord *records __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+    uint64_t   mask;
+  };
+
+  extern int      initSpscRing(SpscRing *, unsigned int);
+  extern void     destroySpscRing(SpscRing *);
+  extern int      spscRingPush(SpscRing *, MacRecord *, int);
+  extern int      spscRingPop(SpscRing *, MacRecord *, int);
+  extern uint64_t spscRingOverflows(SpscRing *);
+#endif
@@ -0,0 +1,39 @@
+#ifndef _NETFREE_STATION_SLAB
+  #define _NETFREE_STATION_SLAB
+
+  #include <stddef.h>
+
+  /**
+   * A StationSlab hands out fixed-size station records from large contiguous chunks.  Freed
+   * records go on an intrusive free list (the first word of a free record points to the next
+   * one) and are reused before the chunks are extended, so once a capture reaches its steady
+   * state adding and removing stations never touches the heap.  All records are released at
+   * once by destroying the slab.
+   */
+  #ifndef NETFREE_CACHE_LINE_SIZE
+    #define NETFREE_CACHE_LINE_SIZE     64
+  #endif
+
+  #ifndef NETFREE_SLAB_CHUNK_RECORDS
+    #define NETFREE_SLAB_CHUNK_RECORDS  1024    // Records carved out of every chunk
+  #endif
+
+  typedef struct StationSlabChunkStruct StationSlabChunk;
+
+  typedef struct StationSlabStruct StationSlab;
+  struct StationSlabStruct {
+    StationSlabChunk *chunks;       // Most recent chunk first
+    void             *freeList;
+    char             *unused;       // Next never-used record of the newest chunk
+    char             *chunkEnd;
+    size_t            recordSize;
+    size_t            reserved;     // Bytes held in chunks
+    unsigned int      allocated;    // Records currently handed out
+    unsigned int      limit;        // Maximum records handed out at once; 0 means no limit
+  };
+
+  extern int          initStationSlab(StationSlab *, size_t, unsigned int);
+  extern void         destroyStationSlab(StationSlab *);
+  extern void        *stationSlabAlloc(StationSlab *);
+  extern void         stationSlabFree(StationSlab *, void *);
+#endif
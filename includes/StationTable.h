@@ -0,0 +1,49 @@
+#ifndef _NETFREE_STATION_TABLE
+  #define _NETFREE_STATION_TABLE
+
+  #include <stdint.h>
+  #include "MacRecord.h"
+
+  /**
+   * A StationTable is a small open-addressing hash table that accumulates packet counts per
+   * MAC address.  Capture workers each own one so they never contend on the MAC queue's
+   * lock for individual frames; the table is merged into the queue periodically instead.
+   */
+  #ifndef NETFREE_STATION_TABLE_SIZE
+    #define NETFREE_STATION_TABLE_SIZE  4096    // Must be a power of 2
+  #endif
+
+  // Keys carry this bit so the all-zero MAC address is distinguishable from an empty slot.
+  #define STATION_KEY_PRESENT         (1ULL << 48)
+  #define STATION_KEY(macAddress)     ((macAddress) | STATION_KEY_PRESENT)
+  #define STATION_KEY_MAC(key)        ((key) & MAC_ADDRESS_MASK)
+  #define STATION_TABLE_FULL(table)   ((table)->length * 4 >= (table)->capacity * 3)
+
+  // Multiplicative (Fibonacci) hash of a key from STATION_KEY() into a power of 2 sized table.
+  #define STATION_HASH(key, capacity)  ((unsigned int) (((key) * 0x9e3779b97f4a7c15ULL) >> 32) & ((capacity) - 1))
+
+  #ifndef NETFREE_PREFETCH_DISTANCE
+    #define NETFREE_PREFETCH_DISTANCE 4   // How many records ahead batch lookups are prefetched
+  #endif
+
+  typedef struct StationEntryStruct StationEntry;
+  struct StationEntryStruct {
+    uint64_t    key;
+    MacAddress  bssid;              // The last BSSID the station was heard with; 0 if none
+    uint32_t    packetsReceived;
+    int64_t     lastReceived;       // CLOCK_MONOTONIC nanoseconds
+  };
+
+  typedef struct StationTableStruct StationTable;
+  struct StationTableStruct {
+    StationEntry *entries;
+    unsigned int  capacity;
+    unsigned int  length;
+  };
+
+  extern int      initStationTable(StationTable *, unsigned int);
+  extern void     destroyStationTable(StationTable *);
+  extern void     clearStationTable(StationTable *);
+  extern int      stationTableAdd(StationTable *, MacAddress, MacAddress, uint32_t, int64_t);
+  extern int      stationTableAddBatch(StationTable *, MacRecord *, int);
+#endif
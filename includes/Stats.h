@@ -0,0 +1,82 @@
+#ifndef _NETFREE_STATS
+  #define _NETFREE_STATS
+
+  #include <stdio.h>
+  #include <stdint.h>
+
+  /**
+   * Pipeline statistics.  Every thread that counts something registers its own StatsBlock
+   * and is the only writer of it, so counting is a relaxed load and store on a cache line no
+   * other thread writes: there is no locked instruction and no sharing on the capture path.
+   * Readers sum the blocks with relaxed loads, which gives totals that may lag the writers
+   * slightly but never tear.  Values that have a single owner (the size of the MAC queue,
+   * drops reported by the kernel, ...) are published as gauges instead.
+   */
+  #ifndef NETFREE_CACHE_LINE_SIZE
+    #define NETFREE_CACHE_LINE_SIZE   64
+  #endif
+
+  #ifndef NETFREE_STATS_MAX_THREADS
+    #define NETFREE_STATS_MAX_THREADS 64
+  #endif
+
+  #ifndef NETFREE_STATS_INTERVAL_MS
+    #define NETFREE_STATS_INTERVAL_MS 10000   // How often the statistics are dumped while scanning; 0 disables it
+  #endif
+
+  // Bucket b > 0 of a histogram counts latencies in [2^(b-1), 2^b) nanoseconds; the last bucket is open ended.
+  #define NETFREE_STATS_BUCKETS       40
+
+  /* Counters */
+  #define STAT_FRAMES_RECEIVED    0   // Frames handed over by the capture backend
+  #define STAT_FRAMES_PARSED      1   // Frames whose headers were parsed and addresses classified
+  #define STAT_FRAMES_KEPT        2   // Frames whose transmitter was recorded
+  #define STAT_REJECT_RADIOTAP    3   // Frames with a truncated or malformed radiotap header
+  #define STAT_REJECT_TRUNCATED   4   // Frames too short to hold an 802.11 header
+  #define STAT_REJECT_BAD_FCS     5   // Frames that failed their checksum
+  #define STAT_REJECT_UNWANTED    6   // Frames sent by this device, the router, the BSSID or a group address
+  #define STAT_KERNEL_RECEIVED    7   // Frames that passed the kernel's filter
+  #define STAT_KERNEL_DROPS       8   // Frames the kernel dropped because the capture buffer was full
+  #define STAT_INTERFACE_DROPS    9   // Frames the driver dropped
+  #define STAT_RECORDS_ENQUEUED   10  // MacRecords applied to the MAC queue
+  #define STAT_REJECT_NOT_DATA    11  // Frames that are not 802.11 data frames
+  #define STAT_COUNTERS           12
+
+  /* Gauges */
+  #define STAT_HANDOFF_DROPS      0   // MacRecords dropped because the aggregation thread fell behind
+  #define STAT_STATIONS           1   // Stations in the MAC queue
+  #define STAT_STATION_MEMORY     2   // Bytes held for stations by the MAC queue and the workers' tables
+  #define STAT_GAUGES             3
+
+  /* Histograms */
+  #define STAT_ENQUEUE_LATENCY    0   // Age of each MacRecord when it reaches the MAC queue
+  #define STAT_RANKING_LATENCY    1   // Time taken to apply a batch of MacRecords to the MAC queue
+  #define STAT_HISTOGRAMS         2
+
+  typedef struct StatsBlockStruct StatsBlock;
+  struct StatsBlockStruct {
+    uint64_t counters[STAT_COUNTERS];
+    uint64_t histograms[STAT_HISTOGRAMS][NETFREE_STATS_BUCKETS];
+  } __attribute__((aligned(NETFREE_CACHE_LINE_SIZE)));
+
+  typedef struct StatsSnapshotStruct StatsSnapshot;
+  struct StatsSnapshotStruct {
+    uint64_t counters[STAT_COUNTERS];
+    uint64_t gauges[STAT_GAUGES];
+    uint64_t histograms[STAT_HISTOGRAMS][NETFREE_STATS_BUCKETS];
+  };
+
+  // Only the owner of a block writes it, so the increment does not need to be atomic as a whole.
+  #define STATS_BUMP(slot, amount)      __atomic_store_n(&(slot), __atomic_load_n(&(slot), __ATOMIC_RELAXED) + (amount), __ATOMIC_RELAXED)
+  #define STATS_ADD(block, counter, n)  STATS_BUMP((block)->counters[counter], n)
+  #define STATS_BUCKET(ns)              ((ns) <= 0 ? 0 : (64 - __builtin_clzll((uint64_t) (ns)) < NETFREE_STATS_BUCKETS ? 64 - __builtin_clzll((uint64_t) (ns)) : NETFREE_STATS_BUCKETS - 1))
+  #define STATS_RECORD(block, histogram, ns)  STATS_BUMP((block)->histograms[histogram][STATS_BUCKET(ns)], 1)
+
+  extern void         resetStats();
+  extern StatsBlock  *registerStatsBlock();
+  extern void         setStatsGauge(int, uint64_t);
+  extern void         addStatsBlock(StatsSnapshot *, StatsBlock *);
+  extern void         getStats(StatsSnapshot *);
+  extern uint64_t     statsPercentile(StatsSnapshot *, int, double);
+  extern void         dumpStats(FILE *);
+#endif
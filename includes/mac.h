@@ -1,6 +1,8 @@
 #ifndef _NETFREE_MAC_INTERFACE
   #define _NETFREE_MAC_INTERFACE
 
+  #include <stdint.h>
+
   #define NETFREE_MAC_SIZE          6   // Number of bytes in used to store a MAC address
   #define NETFREE_MAC_REGEX         "%.2hhx:%.2hhx:%.2hhx:%.2hhx:%.2hhx:%.2hhx"
   #define NETFREE_ARR_TO_MAC(chArr) chArr[0], chArr[1], chArr[2], chArr[3], chArr[4], chArr[5]
@@ -19,6 +21,40 @@
    */
   #define NETFREE_SYSTEM_ADD_FILE   "/address"
 
+  /**
+   * A MacAddress packs the octets of a MAC address into the low 48 bits of an integer, the
+   * first octet being the most significant.  Comparing or hashing two addresses is then a
+   * single integer operation, and an address is stored inline wherever it is used rather
+   * than behind a pointer.
+   */
+  typedef uint64_t MacAddress;
+
+  #define MAC_ADDRESS_MASK          0xffffffffffffULL
+  #define MAC_EQUALS(left, right)   ((left) == (right))
+
+  /**
+   * Packs NETFREE_MAC_SIZE octets into a MacAddress.
+   */
+  static inline MacAddress packMac(const void *octets) {
+    const unsigned char *octet = (const unsigned char *) octets;
+
+    return ((MacAddress) octet[0] << 40) | ((MacAddress) octet[1] << 32) | ((MacAddress) octet[2] << 24) |
+           ((MacAddress) octet[3] << 16) | ((MacAddress) octet[4] << 8) | (MacAddress) octet[5];
+  }
+
+  /**
+   * Unpacks a MacAddress into NETFREE_MAC_SIZE octets.  The octets are not NULL terminated.
+   */
+  static inline void unpackMac(MacAddress macAddress, void *octets) {
+    unsigned char *octet = (unsigned char *) octets;
+    int            octetIndex;
+
+    for(octetIndex = NETFREE_MAC_SIZE - 1; octetIndex >= 0; octetIndex--) {
+      octet[octetIndex] = (unsigned char) (macAddress & 0xff);
+      macAddress >>= 8;
+    }
+  }
+
   extern void initMac(char *netInterface);
   extern void destroyMac();
   extern int  getCurrentMacAddress(char *macAddress);
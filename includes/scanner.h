@@ -11,7 +11,62 @@
     #define PCAP_TIMEOUT_MS 5000
   #endif
 
-  extern int  initScanner(char *);
+  /* Capture backends */
+  #define NETFREE_CAPTURE_PCAP    0   // libpcap, one callback per frame
+  #define NETFREE_CAPTURE_RING    1   // AF_PACKET TPACKET_V3 ring, one callback per block
+  #define NETFREE_CAPTURE_REPLAY  2   // pcap/pcapng file recorded on a radiotap link
+
+  /* Replay speeds.  Any other positive value replays the file that many times faster. */
+  #define NETFREE_REPLAY_FASTEST  0.0   // As fast as the pipeline can consume frames
+  #define NETFREE_REPLAY_ORIGINAL 1.0   // With the inter-frame gaps of the recording
+
+  #ifndef NETFREE_DEFAULT_CAPTURE
+    #define NETFREE_DEFAULT_CAPTURE NETFREE_CAPTURE_PCAP
+  #endif
+
+  #ifndef NETFREE_DEFAULT_WORKERS
+    #define NETFREE_DEFAULT_WORKERS 1
+  #endif
+
+  #ifndef NETFREE_DEFAULT_SNAPLEN
+    #define NETFREE_DEFAULT_SNAPLEN 256   // Bytes kept per frame; enough for the radiotap and 802.11 headers
+  #endif
+
+  #define NETFREE_FILTER_SIZE 256
+
+  #ifndef NETFREE_MERGE_INTERVAL_MS
+    #define NETFREE_MERGE_INTERVAL_MS 100   // How often each worker merges its stations into the MAC queue
+  #endif
+
+  #ifndef NETFREE_REPLAY_TICK_FRAMES
+    #define NETFREE_REPLAY_TICK_FRAMES 256  // Frames between clock reads when replaying as fast as possible
+  #endif
+
+  #ifndef NETFREE_TOP_STATIONS
+    #define NETFREE_TOP_STATIONS 10         // Stations listed with the statistics when the queue can estimate them
+  #endif
+
+  typedef struct ScannerConfigStruct ScannerConfig;
+  struct ScannerConfigStruct {
+    int     captureBackend;
+    char   *replayFile;     // Only used by NETFREE_CAPTURE_REPLAY
+    double  replaySpeed;    // Only used by NETFREE_CAPTURE_REPLAY
+    int     captureWorkers; // Only used by NETFREE_CAPTURE_RING; workers per interface, which share it through PACKET_FANOUT
+    int     snapLength;     // Bytes of each frame copied out of the kernel
+    char   *bssid;          // Optional NETFREE_MAC_SIZE byte BSSID whose own frames are filtered out
+    char   *deviceMac;      // Optional NETFREE_MAC_SIZE byte MAC used instead of the interface's original one
+    char   *routerMac;      // Optional NETFREE_MAC_SIZE byte MAC used instead of looking the router up with arp
+    char   *snapshotFile;   // Optional file the MAC queue is restored from and periodically saved to (see Snapshot.h)
+    char  **captureInterfaces;    // Optional monitor interfaces captured instead of the one passed to initScanner()
+    int     captureInterfaceCount;
+  };
+
+  extern void defaultScannerConfig(ScannerConfig *);
+  extern int  initScanner(char *, ScannerConfig *);
   extern void destroyScanner();
+  extern int  startScan();
   extern void scan();
-#endif
\ No newline at end of file
+  extern int  scanFinished();
+  extern int  scanFinishedDescriptor();
+  extern double scanDuration();
+#endif
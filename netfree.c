@@ -9,14 +9,27 @@
 #include <errno.h>
 #include <curl/curl.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "netfree.h"
 #include "mac.h"
 #include "scanner.h"
 #include "MacQueue.h"
+#include "MacQueueEvents.h"
+#include "EventLoop.h"
 
 int scannerCreated = 0;
 
+EventLoop  mainLoop;
+int        trialReady = -1;       // eventfd signalled when the next station should be tried
+int        populatedEvent = -1;   // Fires once NETFREE_MIN_ADDRESSES stations are queued
+int        scanDoneEvent = -1;    // Fires if the capture ends (a replay runs out of frames)
+int        interactive = 0;       // Whether stdin is watched for answers
+int        awaitingAnswer = 0;
+MacAddress targetBssid = 0;       // The network given with -b, whose stations are tried first
+
 
 /**
  * Resets the device's MAC address to its original MAC address and exits the system with
@@ -27,6 +40,11 @@ int scannerCreated = 0;
 void exitSystem(int exitCode) {
   fprintf(stderr, "\n\nExiting NetFree\n");
 
+  if(scannerCreated) {
+    destroyScanner();
+    scannerCreated = 0;
+  }
+
   char originalMacAddress[NETFREE_MAC_SIZE];
   getOriginalMacAddress(originalMacAddress);
 
@@ -34,8 +52,6 @@ void exitSystem(int exitCode) {
   getCurrentMacAddress(currentMacAddress);
 
   if(!macEquals(originalMacAddress, currentMacAddress)) {
-    destroyScanner();
-
     fprintf(stderr, "Resetting to original MAC address.\n");
     setDeviceMacAddress(originalMacAddress);
   }
@@ -79,20 +95,191 @@ bool isConnectedToInternet() {
   return false;
 }
 
+/**
+ * Asks the main loop to try the next station.
+ */
+void requestTrial() {
+  uint64_t ready = 1;
+  ssize_t  written;
+
+  written = write(trialReady, &ready, sizeof(ready));
+  (void) written;
+}
+
+/**
+ * Stops the main loop when one of the shutdown signals is received, so the original MAC
+ * address is restored by exitSystem() on the main thread rather than in a signal handler.
+ *
+ * @param loop (EventLoop *) - the main loop
+ * @param context (void *) - unused
+ * @param signal (uint64_t) - the number of the signal received
+ */
+void handleShutdownSignal(EventLoop *loop, void *context, uint64_t signal) {
+  stopEventLoop(loop, (int) signal);
+}
+
+/**
+ * Starts trying stations once the scan has found enough of them, or once the capture ended
+ * with fewer.  Either way this only happens once.
+ *
+ * @param loop (EventLoop *) - the main loop
+ * @param context (void *) - unused
+ * @param events (uint64_t) - unused
+ */
+void handleScanReady(EventLoop *loop, void *context, uint64_t events) {
+  removeEventSource(loop, populatedEvent);
+  removeEventSource(loop, scanDoneEvent);
+  unsubscribeMacQueue(populatedEvent);
+  populatedEvent = -1;
+  scanDoneEvent = -1;
+
+  requestTrial();
+}
+
+/**
+ * Tries the best station left in the MAC queue: the device takes on its MAC address and, if
+ * that gets it onto the Internet, the user is asked whether to keep going.  Stations are
+ * tried one per call, so shutdown signals are handled between them.  When a BSSID was given,
+ * the stations heard on that network are tried before any other.
+ *
+ * @param loop (EventLoop *) - the main loop
+ * @param context (void *) - unused
+ * @param events (uint64_t) - unused
+ */
+void tryNextStation(EventLoop *loop, void *context, uint64_t events) {
+  MacAddress nextMac;
+  char       macAddress[NETFREE_MAC_SIZE];
+  uint64_t   ready;
+  ssize_t    bytesRead;
+
+  bytesRead = read(trialReady, &ready, sizeof(ready));
+  (void) bytesRead;
+
+  if((!targetBssid || !dequeueMacFromPartition(targetBssid, &nextMac)) && !dequeueMac(&nextMac)) {
+    stopEventLoop(loop, 0);
+
+    return;
+  }
+
+  unpackMac(nextMac, macAddress);
+  if(setDeviceMacAddress(macAddress) || !isConnectedToInternet()) {
+    requestTrial();
+
+    return;
+  }
+
+  printf("I think I found one.  Check it out and let me know if it works or if you want to exit and reset the system back to normal.\n");
+  if(!interactive) {
+    requestTrial();
+
+    return;
+  }
+
+  printf("Next/Quit (N/Q): ");
+  fflush(stdout);
+  awaitingAnswer = 1;
+}
+
+/**
+ * Reads the user's answer to the question asked by tryNextStation().  Input that arrives
+ * while no question is asked is discarded.
+ *
+ * @param loop (EventLoop *) - the main loop
+ * @param context (void *) - unused
+ * @param events (uint64_t) - unused
+ */
+void readAnswer(EventLoop *loop, void *context, uint64_t events) {
+  char    answer[64];
+  ssize_t length;
+
+  length = read(STDIN_FILENO, answer, sizeof(answer));
+  if(length <= 0) {
+    // Without stdin, nobody can answer any more.
+    removeEventSource(loop, STDIN_FILENO);
+    interactive = 0;
+    if(awaitingAnswer) {
+      awaitingAnswer = 0;
+      requestTrial();
+    }
+
+    return;
+  }
+
+  if(!awaitingAnswer) {
+    return;
+  }
+
+  awaitingAnswer = 0;
+  if(answer[0] == 'Q' || answer[0] == 'q') {
+    stopEventLoop(loop, 0);
+  } else {
+    requestTrial();
+  }
+}
+
 int main(int argc, char **argv) {
   char *iface;
-  struct sigaction interruptHandler;
+  ScannerConfig scannerConfig;
   int status;
+  int option;
+  char bssid[NETFREE_MAC_SIZE];
+  char **monitorIfaces;
+
+  // Usage: netfree [-R] [-w workers] [-r capture.pcap] [-s replaySpeed] [-l snapLength] [-b bssid] [-p snapshotFile] [-i monitorIface ...] [iface]
+  defaultScannerConfig(&scannerConfig);
+
+  // Every -i adds a monitor interface to capture from, so there can be no more than argc of them.
+  monitorIfaces = (char **) malloc(argc * sizeof(char *));
+  scannerConfig.captureInterfaces = monitorIfaces;
+
+  while((option = getopt(argc, argv, "Rw:r:s:l:b:p:i:")) != -1) {
+    switch(option) {
+      case 'R':
+        scannerConfig.captureBackend = NETFREE_CAPTURE_RING;
+        break;
+      case 'w':
+        scannerConfig.captureWorkers = atoi(optarg);
+        break;
+      case 'r':
+        scannerConfig.captureBackend = NETFREE_CAPTURE_REPLAY;
+        scannerConfig.replayFile = optarg;
+        break;
+      case 's':
+        scannerConfig.replaySpeed = atof(optarg);
+        break;
+      case 'l':
+        scannerConfig.snapLength = atoi(optarg);
+        break;
+      case 'b':
+        if(sscanf(optarg, NETFREE_MAC_READ_REGEX, NETFREE_WR_TO_MAC(bssid)) != NETFREE_MAC_SIZE) {
+          fprintf(stderr, "Invalid BSSID: %s\n", optarg);
+          exit(1);
+        }
+
+        scannerConfig.bssid = bssid;
+        targetBssid = packMac(bssid);
+        break;
+      case 'p':
+        scannerConfig.snapshotFile = optarg;
+        break;
+      case 'i':
+        monitorIfaces[scannerConfig.captureInterfaceCount++] = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-R] [-w workers] [-r capture.pcap] [-s replaySpeed] [-l snapLength] [-b bssid] [-p snapshotFile] [-i monitorIface ...] [iface]\n", argv[0]);
+        exit(1);
+    }
+  }
 
-  if(argc == 1) {
+  if(optind >= argc) {
     fprintf(stdout, "Using default iface: " DEFAULT_IFACE "\n");
 
     iface = (char *) malloc((strlen(DEFAULT_IFACE) + 1) * sizeof(char));
     strcpy(iface, DEFAULT_IFACE);
   } else {
-    fprintf(stdout, "Using iface: %s\n", argv[1]);
+    fprintf(stdout, "Using iface: %s\n", argv[optind]);
 
-    iface = argv[1];
+    iface = argv[optind];
   }
 
   initMac(iface);
@@ -101,48 +288,46 @@ int main(int argc, char **argv) {
   getCurrentMacAddress(originalMacAddress);
   fprintf(stderr, "Original MAC Address: " NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(originalMacAddress));
 
-  // Intercept interrupts so the original MAC can be reset.
-  memset(&interruptHandler, 0, sizeof(interruptHandler));
-  interruptHandler.sa_handler = exitSystem;
-  sigemptyset(&(interruptHandler.sa_mask));
-  interruptHandler.sa_flags = SA_RESTART;
-
-  sigaction(SIGINT, &interruptHandler, NULL);
-  sigaction(SIGTERM, &interruptHandler, NULL);
-  sigaction(SIGQUIT, &interruptHandler, NULL);
-  sigaction(SIGHUP, &interruptHandler, NULL);
-  sigaction(SIGTSTP, &interruptHandler, NULL);
+  // Block the shutdown signals before the scanner starts any thread, so they are only
+  // received through the main loop and the original MAC is reset outside of a signal handler.
+  sigset_t shutdownSignals;
+  sigemptyset(&shutdownSignals);
+  sigaddset(&shutdownSignals, SIGINT);
+  sigaddset(&shutdownSignals, SIGTERM);
+  sigaddset(&shutdownSignals, SIGQUIT);
+  sigaddset(&shutdownSignals, SIGHUP);
+  sigaddset(&shutdownSignals, SIGTSTP);
+
+  if(initEventLoop(&mainLoop) || addEventSignals(&mainLoop, &shutdownSignals, handleShutdownSignal, NULL) == -1) {
+    fprintf(stderr, "Could not create the main event loop.\n");
+    exitSystem(1);
+  }
 
-  status = initScanner(iface);
+  status = initScanner(iface, &scannerConfig);
   if(status != 0) {
     exitSystem(status);
   }
 
-  scan();
+  scannerCreated = 1;
 
-  char macAddress[NETFREE_MAC_SIZE];
-  while(true) {
-    dequeueMac(macAddress);
-    status = setDeviceMacAddress(macAddress);
-
-    if(status) {
-      continue;
-    }
+  trialReady = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  populatedEvent = subscribeMacQueue(MAC_QUEUE_EVENT_LENGTH, NETFREE_MIN_ADDRESSES);
+  if(addEventDescriptor(&mainLoop, trialReady, EPOLLIN, tryNextStation, NULL) == -1 || addEventDescriptor(&mainLoop, populatedEvent, EPOLLIN, handleScanReady, NULL) == -1) {
+    fprintf(stderr, "Could not watch the MAC queue.\n");
+    exitSystem(1);
+  }
 
-    if(isConnectedToInternet()) {
-      char command;
+  status = startScan();
+  if(status != 0) {
+    exitSystem(status);
+  }
 
-      printf("I think I found one.  Check it out and let me know if it works or if you want to exit and reset the system back to normal.\n");
-      printf("Next/Quit (N/Q): ");
-      scanf("%c", &command);
+  scanDoneEvent = addEventDescriptor(&mainLoop, scanFinishedDescriptor(), EPOLLIN, handleScanReady, NULL);
 
-      if(command == 'Q' || command == 'q') {
-        break;
-      }
-    }
-  }
+  // stdin cannot be watched when it is a regular file; nobody answers then, so every station is tried.
+  interactive = addEventDescriptor(&mainLoop, STDIN_FILENO, EPOLLIN, readAnswer, NULL) != -1;
 
-  destroyScanner();
+  status = runEventLoop(&mainLoop);
 
-  exitSystem(0);
-}
\ No newline at end of file
+  exitSystem(status);
+}
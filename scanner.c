@@ -4,58 +4,243 @@
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 
 #include "scanner.h"
+#include "RingCapture.h"
+#include "StationTable.h"
+#include "MacRecord.h"
+#include "SpscRing.h"
 #include "HeaderParser.h"
+#include "Classifier.h"
 #include "MacQueue.h"
+#include "MacQueueEvents.h"
+#include "Stats.h"
+#include "Snapshot.h"
+#include "EventLoop.h"
+#include "Log.h"
 #include "mac.h"
 
-pcap_t     *pcapDevHandle;
-pthread_t   scannerThread;
+#ifdef NETFREE_SPACE_SAVING
+  #include "SpaceSavingMacQueue.h"
+#endif
+
+// Indices of the addresses frames are classified against.
+#define CLASSIFY_DEVICE 0
+#define CLASSIFY_ROUTER 1
+#define CLASSIFY_BSSID  2
+
+// A transmitter (addr2) we never want to become: ourselves, the router, the BSSID or a group address.
+#define UNWANTED_TRANSMITTER  (CLASSIFY_MATCH(CLASSIFY_DEVICE, 1) | CLASSIFY_MATCH(CLASSIFY_ROUTER, 1) | CLASSIFY_MATCH(CLASSIFY_BSSID, 1) | CLASSIFY_GROUP(1))
+#define ALL_DEVICE_ADDRESSES  (CLASSIFY_MATCH(CLASSIFY_DEVICE, 0) | CLASSIFY_MATCH(CLASSIFY_DEVICE, 1) | CLASSIFY_MATCH(CLASSIFY_DEVICE, 2) | CLASSIFY_MATCH(CLASSIFY_DEVICE, 3))
+
+/**
+ * An interface the scanner captures from (or, when replaying, the recording).  Each
+ * interface has its own handle and its own workers, and its frames go through the same
+ * aggregation thread as every other interface's, so a station heard on several radios ends
+ * up in the MAC queue once.
+ */
+typedef struct CaptureInterfaceStruct {
+  char         *name;
+  pcap_t       *pcapHandle;     // Only used by the pcap and replay backends
+  int           firstWorker;    // Index of the interface's first worker in captureWorkers
+  int           workerCount;
+} CaptureInterface;
+
+/**
+ * Each capture thread is a worker.  A worker gathers the addresses of the frames it parses,
+ * classifies them a batch at a time, collects a MacRecord for every frame it keeps and
+ * flushes the batch after every ring block or pcap_dispatch() call.  Workers never touch
+ * the MAC queue themselves: they hand records to the aggregation thread through their own
+ * SpscRing, so capture never waits on ranking work or on readers of the queue.  A lone
+ * worker hands over every batch.  When there are several workers, sharing an interface or
+ * capturing different ones, each one first accumulates its batches in a private
+ * StationTable and hands over the table's contents every NETFREE_MERGE_INTERVAL_MS, which
+ * coalesces repeated stations.  A worker signals the aggregation thread after every
+ * hand-over, so the aggregation thread sleeps whenever there is nothing to apply.  Each
+ * worker counts what happens to its frames in its own StatsBlock.
+ */
+typedef struct CaptureWorkerStruct {
+  SpscRing      handoff;
+  pthread_t     thread;
+  CaptureInterface *interface;
+  RingCapture   ring;
+  EventLoop     loop;         // Only used by the pcap backend
+  StationTable  stations;
+  FrameAddresses frames[NETFREE_BATCH_SIZE];
+  int           frameCount;
+  MacRecord     batch[NETFREE_BATCH_SIZE];
+  int           batchLength;
+  StatsBlock   *stats;
+  struct pcap_stat pcapStats;   // libpcap's totals when they were last added to stats
+  int64_t       now;          // Coarse CLOCK_MONOTONIC nanoseconds, refreshed by workerTick()
+  int64_t       lastMerge;
+  int64_t       lastCaptureStats;
+} CaptureWorker;
+
+CaptureInterface *captureInterfaces;
+int               captureInterfaceCount;
+CaptureWorker    *captureWorkers;
+int               captureWorkerCount;
+ScannerConfig     scannerConfig;
+
+pthread_t       aggregatorThread;
+StatsBlock     *aggregatorStats;
+EventLoop       aggregatorLoop;
+int             handoffReady = -1;    // eventfd the workers signal after handing records over
+int             handoffSignalled;     // Whether handoffReady was signalled since the aggregator last looked
+int             scanDone = -1;        // eventfd signalled when the aggregation thread finishes
+
+struct timespec captureStart;
+struct timespec captureEnd;     // Set when the aggregation thread finishes
+volatile int    scanStarted;
+volatile int    stopCapture;
+int             workersFinished;
+volatile int    aggregatorFinished;
+
+char *captureBackendNames[] = {"pcap", "ring", "replay"};
 
 char *deviceMacAddress;
 char *routerMacAddress;
+Classifier frameClassifier;
 
 /**
- * Initializes the scanner and prepares it for use later.
+ * Fills config with the default scanner configuration.
+ *
+ * @param config (ScannerConfig *) - the configuration to populate
  */
-int initScanner(char *iface) {
-  int                 status;
-  char                pcapError[PCAP_ERRBUF_SIZE];
+void defaultScannerConfig(ScannerConfig *config) {
+  config->captureBackend = NETFREE_DEFAULT_CAPTURE;
+  config->replayFile = NULL;
+  config->replaySpeed = NETFREE_REPLAY_FASTEST;
+  config->captureWorkers = NETFREE_DEFAULT_WORKERS;
+  config->snapLength = NETFREE_DEFAULT_SNAPLEN;
+  config->bssid = NULL;
+  config->deviceMac = NULL;
+  config->routerMac = NULL;
+  config->snapshotFile = NULL;
+  config->captureInterfaces = NULL;
+  config->captureInterfaceCount = 0;
+}
+
+/**
+ * Writes the pcap filter expression for the current configuration.  Only 802.11 data frames
+ * sent by a station other than this device, the router or the BSSID, and addressed to a
+ * unicast receiver, pass the filter.  Everything else is dropped by the kernel before it is
+ * copied to us.
+ *
+ * @param filter (char *) - where the expression is written
+ * @param filterSize (size_t) - the number of bytes available at filter
+ */
+void buildCaptureFilter(char *filter, size_t filterSize) {
+  int length;
+
+  // The group bit of addr1 (the first byte after frame control and duration) is set for broadcast and multicast.
+  length = snprintf(filter, filterSize, "type data and wlan[4] & 1 = 0"
+                    " and not wlan addr2 " NETFREE_MAC_REGEX
+                    " and not wlan addr2 " NETFREE_MAC_REGEX,
+                    NETFREE_ARR_TO_MAC(deviceMacAddress), NETFREE_ARR_TO_MAC(routerMacAddress));
+
+  if(scannerConfig.bssid && length >= 0 && (size_t) length < filterSize) {
+    snprintf(filter + length, filterSize - length, " and not wlan addr2 " NETFREE_MAC_REGEX, NETFREE_ARR_TO_MAC(scannerConfig.bssid));
+  }
+}
+
+/**
+ * Compiles the capture filter for the current configuration.  The program accepts at most
+ * the handle's snapshot length of each frame.
+ *
+ * @param handle (pcap_t *) - the handle the program is compiled for
+ * @param pcapFilter (struct bpf_program *) - where the program is stored
+ * @param netMask (bpf_u_int32) - the IPv4 netmask of the network being captured
+ *
+ * @return (int) 0 on success, nonzero otherwise
+ */
+int compileCaptureFilter(pcap_t *handle, struct bpf_program *pcapFilter, bpf_u_int32 netMask) {
+  char filter[NETFREE_FILTER_SIZE];
 
+  buildCaptureFilter(filter, sizeof(filter));
+
+  if(pcap_compile(handle, pcapFilter, filter, 1, netMask)) {
+    NETFREE_ERROR("Could not compile \"%s\":\n\t%s", filter, pcap_geterr(handle));
+
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Compiles the capture filter and installs it on a libpcap handle.
+ *
+ * @param handle (pcap_t *) - the handle to filter
+ * @param netMask (bpf_u_int32) - the IPv4 netmask of the network being captured
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int setPcapFilter(pcap_t *handle, bpf_u_int32 netMask) {
+  int                 status;
   struct bpf_program  pcapFilter;
 
-  bpf_u_int32         netAddr = 0,
-                      netMask = 0;
+  status = compileCaptureFilter(handle, &pcapFilter, netMask);
+  if(status) {
+    // An error occurred compiling the filter.
+    return -3;
+  }
 
-  scannerThread = (pthread_t) 0;
+  status = pcap_setfilter(handle, &pcapFilter);
+  pcap_freecode(&pcapFilter);
+  if(status) {
+    NETFREE_ERROR("An error occurred setting the pcap filter.");
 
-  deviceMacAddress = (char *) malloc(NETFREE_MAC_SIZE);
-  getOriginalMacAddress(deviceMacAddress);
+    return -4;
+  }
 
-  routerMacAddress = (char *) malloc(NETFREE_MAC_SIZE);
-  getRouterMacAddress(routerMacAddress);
+  return 0;
+}
 
-  pcapDevHandle = pcap_create(iface, pcapError);
+/**
+ * Opens the interface through libpcap, which also places the interface in monitor mode.
+ *
+ * @param interface (CaptureInterface *) - the interface on which to capture
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int openPcapCapture(CaptureInterface *interface) {
+  int                 status;
+  char                pcapError[PCAP_ERRBUF_SIZE];
+  pcap_t             *pcapDevHandle;
+
+  bpf_u_int32         netAddr = 0,
+                      netMask = 0;
+
+  pcapDevHandle = interface->pcapHandle = pcap_create(interface->name, pcapError);
   if(pcapDevHandle == NULL) {
-    fprintf(stderr, "Error while creating packet capture handle:\n");
-    fprintf(stderr, "%s\n", pcapError);
+    NETFREE_ERROR("Error while creating packet capture handle for %s:\n%s", interface->name, pcapError);
 
     return -6;
   }
 
+  // The timeout bounds how long frames can wait in the kernel before the selectable descriptor reports them.
+  pcap_set_timeout(pcapDevHandle, NETFREE_MERGE_INTERVAL_MS);
+
+  pcap_set_snaplen(pcapDevHandle, scannerConfig.snapLength);
+
   status = pcap_set_rfmon(pcapDevHandle, 1);
   if(status) {
     // An error occurred setting the device in promiscuous mode.
-    fprintf(stderr, "Could not start promiscuous mode. Make sure you have root (admin) privileges.\n");
+    NETFREE_ERROR("Could not start promiscuous mode on %s. Make sure you have root (admin) privileges.", interface->name);
 
     return -1;
   }
 
-  status = pcap_lookupnet(iface, &netAddr, &netMask, pcapError);
+  status = pcap_lookupnet(interface->name, &netAddr, &netMask, pcapError);
   if(status) {
     // An error occurred looking up the IPv4 network number and netmask.
-    fprintf(stderr, "Could not determine the IPv4 number or netmask:\n\t%s\n", pcapError);
+    NETFREE_ERROR("Could not determine the IPv4 number or netmask:\n\t%s", pcapError);
 
     return -2;
   }
@@ -63,50 +248,532 @@ int initScanner(char *iface) {
   status = pcap_activate(pcapDevHandle);
   if(status) {
     // An error occurred activating the device.
-    fprintf(stderr, "An error occurred trying to activate the device:\n\t%s\n", pcapError);
+    NETFREE_ERROR("An error occurred trying to activate %s:\n\t%s", interface->name, pcap_geterr(pcapDevHandle));
 
     return -7;
   }
 
   if(pcap_datalink(pcapDevHandle) != DLT_IEEE802_11_RADIO) {
     // This program requires Ethernet headers, but this device does not support these headers.
-    fprintf(stderr, "Header type not supported (Required: %d; Actual: %d).  Quitting.\n", DLT_IEEE802_11_RADIO, pcap_datalink(pcapDevHandle));
+    NETFREE_ERROR("Header type of %s not supported (Required: %d; Actual: %d).  Quitting.", interface->name, DLT_IEEE802_11_RADIO, pcap_datalink(pcapDevHandle));
 
     return -5;
   }
 
-  status = pcap_compile(pcapDevHandle, &pcapFilter, "tcp or udp", 1, netMask);
-  if(status) {
-    // An error occurred compiling the filter.
-    fprintf(stderr, "An error occurred compiling the pcap filter.\n");
+  // The worker waits in epoll on the selectable descriptor, so pcap_dispatch() must never block.
+  if(pcap_setnonblock(pcapDevHandle, 1, pcapError) || pcap_get_selectable_fd(pcapDevHandle) == -1) {
+    NETFREE_ERROR("The capture on %s cannot be waited on without blocking:\n\t%s", interface->name, pcapError);
+
+    return -11;
+  }
+
+  return setPcapFilter(pcapDevHandle, netMask);
+}
+
+/**
+ * Opens a recorded pcap or pcapng file so it can be replayed through the same path as a
+ * live capture.
+ *
+ * @param interface (CaptureInterface *) - the interface standing for the recording, whose
+ *  name is the path to the recording
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int openReplayCapture(CaptureInterface *interface) {
+  char    pcapError[PCAP_ERRBUF_SIZE];
+  pcap_t *pcapDevHandle;
+
+  if(!interface->name) {
+    NETFREE_ERROR("No capture file was given to replay.");
+
+    return -9;
+  }
+
+  pcapDevHandle = interface->pcapHandle = pcap_open_offline(interface->name, pcapError);
+  if(pcapDevHandle == NULL) {
+    NETFREE_ERROR("Could not open %s for replay:\n\t%s", interface->name, pcapError);
+
+    return -9;
+  }
+
+  if(pcap_datalink(pcapDevHandle) != DLT_IEEE802_11_RADIO) {
+    NETFREE_ERROR("Header type not supported (Required: %d; Actual: %d).  Quitting.", DLT_IEEE802_11_RADIO, pcap_datalink(pcapDevHandle));
 
+    return -5;
+  }
+
+  return setPcapFilter(pcapDevHandle, PCAP_NETMASK_UNKNOWN);
+}
+
+/**
+ * Opens a TPACKET_V3 ring on the interface for every one of its workers.  When the interface
+ * has more than one worker, its rings join a PACKET_FANOUT group of their own so the kernel
+ * spreads the interface's frames across them.  libpcap is only used to compile the filter,
+ * which is then attached directly to each ring's socket.
+ *
+ * @param interface (CaptureInterface *) - the interface on which to capture.  It must
+ *  already be in monitor mode.
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int openRingCapture(CaptureInterface *interface) {
+  int                 status;
+  int                 workerIndex;
+  int                 lastWorker = interface->firstWorker + interface->workerCount;
+  int                 fanoutGroup = (getpid() + (interface - captureInterfaces)) & 0xffff;
+  pcap_t             *filterHandle;
+  struct bpf_program  pcapFilter;
+  struct sock_fprog   socketFilter;
+
+  for(workerIndex = interface->firstWorker; workerIndex < lastWorker; workerIndex++) {
+    status = initRingCapture(&captureWorkers[workerIndex].ring, interface->name);
+    if(status) {
+      NETFREE_ERROR("Could not open a capture ring on %s (%d).  Make sure you have root (admin) privileges and the interface is in monitor mode.", interface->name, status);
+
+      return -8;
+    }
+
+    if(interface->workerCount > 1 && ringCaptureJoinFanout(&captureWorkers[workerIndex].ring, fanoutGroup)) {
+      NETFREE_ERROR("Could not add capture ring %d to fanout group %d.", workerIndex, fanoutGroup);
+
+      return -10;
+    }
+  }
+
+  // The program's accept value is the snapshot length, so the kernel also truncates the frames it keeps.
+  filterHandle = pcap_open_dead(DLT_IEEE802_11_RADIO, scannerConfig.snapLength);
+  status = compileCaptureFilter(filterHandle, &pcapFilter, PCAP_NETMASK_UNKNOWN);
+  pcap_close(filterHandle);
+  if(status) {
     return -3;
   }
 
-  status = pcap_setfilter(pcapDevHandle, &pcapFilter);
+  socketFilter.len = pcapFilter.bf_len;
+  socketFilter.filter = (struct sock_filter *) pcapFilter.bf_insns;
+
+  for(workerIndex = interface->firstWorker, status = 0; workerIndex < lastWorker && !status; workerIndex++) {
+    status = ringCaptureSetFilter(&captureWorkers[workerIndex].ring, &socketFilter);
+  }
+
+  pcap_freecode(&pcapFilter);
   if(status) {
-    fprintf(stderr, "An error occurred setting the pcap filter.\n");
+    NETFREE_ERROR("An error occurred setting the pcap filter.");
 
     return -4;
   }
 
-  initMacQueue();
+  return 0;
+}
+
+/**
+ * Lists the interfaces to capture from and gives each one its workers.  A recording stands
+ * for a single interface.
+ *
+ * @param iface (char *) - the interface to capture from when the configuration names none
+ *
+ * @return (int) 0 on success, -1 if memory could not be allocated
+ */
+int initCaptureInterfaces(char *iface) {
+  int interfaceIndex;
+  int workersPerInterface = 1;
+  int maxWorkersPerInterface;
 
-  fprintf(stderr, "Device MAC:\t" NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(deviceMacAddress));
-  fprintf(stderr, "Router MAC:\t" NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(routerMacAddress));
+  if(scannerConfig.captureBackend == NETFREE_CAPTURE_REPLAY) {
+    captureInterfaceCount = 1;
+  } else if(scannerConfig.captureInterfaces && scannerConfig.captureInterfaceCount > 0) {
+    captureInterfaceCount = scannerConfig.captureInterfaceCount;
+  } else {
+    captureInterfaceCount = 1;
+  }
+
+  // Only the ring backend can spread one interface across several sockets.
+  if(scannerConfig.captureBackend == NETFREE_CAPTURE_RING && scannerConfig.captureWorkers > 1) {
+    workersPerInterface = scannerConfig.captureWorkers;
+  }
+
+  // Every worker, and the aggregation thread, needs a StatsBlock of its own.
+  maxWorkersPerInterface = (NETFREE_STATS_MAX_THREADS - 1) / captureInterfaceCount;
+  if(workersPerInterface > maxWorkersPerInterface && maxWorkersPerInterface > 0) {
+    NETFREE_WARNING("Using %d capture workers per interface instead of %d.", maxWorkersPerInterface, workersPerInterface);
+    workersPerInterface = maxWorkersPerInterface;
+  }
+
+  captureInterfaces = (CaptureInterface *) calloc(captureInterfaceCount, sizeof(CaptureInterface));
+  if(!captureInterfaces) {
+    return -1;
+  }
+
+  for(interfaceIndex = 0; interfaceIndex < captureInterfaceCount; interfaceIndex++) {
+    if(scannerConfig.captureBackend == NETFREE_CAPTURE_REPLAY) {
+      captureInterfaces[interfaceIndex].name = scannerConfig.replayFile;
+    } else if(scannerConfig.captureInterfaces && scannerConfig.captureInterfaceCount > 0) {
+      captureInterfaces[interfaceIndex].name = scannerConfig.captureInterfaces[interfaceIndex];
+    } else {
+      captureInterfaces[interfaceIndex].name = iface;
+    }
+
+    captureInterfaces[interfaceIndex].firstWorker = interfaceIndex * workersPerInterface;
+    captureInterfaces[interfaceIndex].workerCount = workersPerInterface;
+  }
+
+  captureWorkerCount = captureInterfaceCount * workersPerInterface;
+
+  return 0;
+}
+
+/**
+ * Opens every capture interface with the configured backend.
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int openCaptureInterfaces() {
+  int interfaceIndex;
+  int status = 0;
+
+  for(interfaceIndex = 0; interfaceIndex < captureInterfaceCount && !status; interfaceIndex++) {
+    if(scannerConfig.captureBackend == NETFREE_CAPTURE_RING) {
+      status = openRingCapture(&captureInterfaces[interfaceIndex]);
+    } else if(scannerConfig.captureBackend == NETFREE_CAPTURE_REPLAY) {
+      status = openReplayCapture(&captureInterfaces[interfaceIndex]);
+    } else {
+      status = openPcapCapture(&captureInterfaces[interfaceIndex]);
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Releases the capture workers and interfaces, and whatever each worker holds.  No worker
+ * may be running.  Also releases what a failed initScanner() allocated.
+ */
+void destroyCaptureWorkers() {
+  int workerIndex;
+
+  for(workerIndex = 0; captureWorkers && workerIndex < captureWorkerCount; workerIndex++) {
+    destroyRingCapture(&captureWorkers[workerIndex].ring);
+    destroyStationTable(&captureWorkers[workerIndex].stations);
+    destroySpscRing(&captureWorkers[workerIndex].handoff);
+  }
+
+  free(captureWorkers);
+  free(captureInterfaces);
+
+  captureWorkers = NULL;
+  captureInterfaces = NULL;
+  captureWorkerCount = 0;
+  captureInterfaceCount = 0;
+}
+
+/**
+ * Initializes the scanner and prepares it for use later.
+ *
+ * @param iface (char *) - the interface on which to capture, unless config lists the
+ *  interfaces to capture from
+ * @param config (ScannerConfig *) - the scanner's configuration, or NULL to use the
+ *  defaults
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int initScanner(char *iface, ScannerConfig *config) {
+  MacAddress classifierReferences[CLASSIFY_BSSID + 1];
+  int status;
+  int interfaceIndex;
+  int workerIndex;
+
+  scanStarted = 0;
+  stopCapture = 0;
+  workersFinished = 0;
+  aggregatorFinished = 0;
+
+  if(config) {
+    scannerConfig = *config;
+  } else {
+    defaultScannerConfig(&scannerConfig);
+  }
+
+  if(initCaptureInterfaces(iface)) {
+    NETFREE_ERROR("Could not allocate the capture interfaces.");
+
+    return -14;
+  }
+
+  // Keep each worker's ring indices on their own cache lines.
+  captureWorkers = (CaptureWorker *) aligned_alloc(NETFREE_CACHE_LINE_SIZE, captureWorkerCount * sizeof(CaptureWorker));
+  if(!captureWorkers) {
+    NETFREE_ERROR("Could not allocate %d capture workers.", captureWorkerCount);
+    destroyCaptureWorkers();
+
+    return -14;
+  }
+
+  memset(captureWorkers, 0, captureWorkerCount * sizeof(CaptureWorker));
+  resetStats();
+  aggregatorStats = registerStatsBlock();
+  for(interfaceIndex = 0; interfaceIndex < captureInterfaceCount; interfaceIndex++) {
+    for(workerIndex = 0; workerIndex < captureInterfaces[interfaceIndex].workerCount; workerIndex++) {
+      captureWorkers[captureInterfaces[interfaceIndex].firstWorker + workerIndex].interface = &captureInterfaces[interfaceIndex];
+    }
+  }
+
+  for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+    captureWorkers[workerIndex].ring.socket = -1;
+    captureWorkers[workerIndex].loop.epoll = -1;
+    captureWorkers[workerIndex].loop.wake = -1;
+    captureWorkers[workerIndex].stats = registerStatsBlock();
+  }
+
+  if(!aggregatorStats || !captureWorkers[captureWorkerCount - 1].stats) {
+    NETFREE_ERROR("Cannot count the statistics of %d capture interfaces; at most %d are supported.", captureInterfaceCount, NETFREE_STATS_MAX_THREADS - 1);
+    destroyCaptureWorkers();
+
+    return -14;
+  }
+
+  for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+    if(initStationTable(&captureWorkers[workerIndex].stations, NETFREE_STATION_TABLE_SIZE) ||
+       initSpscRing(&captureWorkers[workerIndex].handoff, NETFREE_SPSC_RING_SIZE)) {
+      NETFREE_ERROR("Could not allocate the station table and handoff ring of capture worker %d.", workerIndex);
+      destroyCaptureWorkers();
+
+      return -14;
+    }
+  }
+
+  deviceMacAddress = (char *) malloc(NETFREE_MAC_SIZE);
+  routerMacAddress = (char *) malloc(NETFREE_MAC_SIZE);
+  if(!deviceMacAddress || !routerMacAddress) {
+    NETFREE_ERROR("Could not allocate the device and router MAC addresses.");
+    free(deviceMacAddress);
+    free(routerMacAddress);
+    deviceMacAddress = NULL;
+    routerMacAddress = NULL;
+    destroyCaptureWorkers();
+
+    return -14;
+  }
+
+  if(scannerConfig.deviceMac) {
+    memcpy(deviceMacAddress, scannerConfig.deviceMac, NETFREE_MAC_SIZE);
+  } else {
+    getOriginalMacAddress(deviceMacAddress);
+  }
+
+  if(scannerConfig.routerMac) {
+    memcpy(routerMacAddress, scannerConfig.routerMac, NETFREE_MAC_SIZE);
+  } else {
+    getRouterMacAddress(routerMacAddress);
+  }
+
+  classifierReferences[CLASSIFY_DEVICE] = packMac(deviceMacAddress);
+  classifierReferences[CLASSIFY_ROUTER] = packMac(routerMacAddress);
+  if(scannerConfig.bssid) {
+    classifierReferences[CLASSIFY_BSSID] = packMac(scannerConfig.bssid);
+  }
+
+  initClassifier(&frameClassifier, classifierReferences, scannerConfig.bssid ? CLASSIFY_BSSID + 1 : CLASSIFY_BSSID);
+
+  status = openCaptureInterfaces();
+  if(status) {
+    return status;
+  }
+
+  if(initMacQueue()) {
+    NETFREE_ERROR("Could not allocate the station queue.");
+
+    return -13;
+  }
+
+  if(scannerConfig.snapshotFile) {
+    status = loadSnapshot(scannerConfig.snapshotFile);
+    if(status >= 0) {
+      NETFREE_INFO("Restored %d stations from %s.", status, scannerConfig.snapshotFile);
+    } else if(status == -2) {
+      NETFREE_WARNING("Ignoring %s, which is not a station snapshot.", scannerConfig.snapshotFile);
+    }
+  }
+
+  NETFREE_INFO("Device MAC:\t" NETFREE_MAC_REGEX, NETFREE_ARR_TO_MAC(deviceMacAddress));
+  NETFREE_INFO("Router MAC:\t" NETFREE_MAC_REGEX, NETFREE_ARR_TO_MAC(routerMacAddress));
+  NETFREE_INFO("Classifier:\t%s", frameClassifier.implementation);
 
   return 0;
 }
 
+/**
+ * Publishes the gauges that describe the scanner as a whole: the records dropped between
+ * the workers and the aggregation thread, and the number of stations tracked and the memory
+ * held for them.
+ */
+void updateScannerGauges() {
+  uint64_t recordsDropped = 0;
+  int      workerIndex;
+
+  for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+    recordsDropped += spscRingOverflows(&captureWorkers[workerIndex].handoff);
+  }
+
+  setStatsGauge(STAT_HANDOFF_DROPS, recordsDropped);
+  setStatsGauge(STAT_STATIONS, macQueueLength());
+  setStatsGauge(STAT_STATION_MEMORY, macQueueMemory() + captureWorkerCount * NETFREE_STATION_TABLE_SIZE * sizeof(StationEntry));
+}
+
+/**
+ * Sums the statistics of the workers capturing an interface.  Gauges are not kept per
+ * interface, so they are left at 0.
+ *
+ * @param interface (CaptureInterface *) - the interface
+ * @param snapshot (StatsSnapshot *) - where the totals are stored
+ */
+void getInterfaceStats(CaptureInterface *interface, StatsSnapshot *snapshot) {
+  int workerIndex;
+
+  memset(snapshot, 0, sizeof(StatsSnapshot));
+  for(workerIndex = interface->firstWorker; workerIndex < interface->firstWorker + interface->workerCount; workerIndex++) {
+    addStatsBlock(snapshot, captureWorkers[workerIndex].stats);
+  }
+}
+
+/**
+ * Prints what each interface captured, when there is more than one.
+ *
+ * @param stream (FILE *) - where the statistics are printed
+ */
+void dumpInterfaceStats(FILE *stream) {
+  StatsSnapshot stats;
+  int           interfaceIndex;
+
+  if(captureInterfaceCount < 2) {
+    return;
+  }
+
+  fprintf(stream, "Interfaces:\n");
+  for(interfaceIndex = 0; interfaceIndex < captureInterfaceCount; interfaceIndex++) {
+    getInterfaceStats(&captureInterfaces[interfaceIndex], &stats);
+    fprintf(stream, "\t%-24s%lu received, %lu kept, %lu kernel drops, %lu interface drops\n", captureInterfaces[interfaceIndex].name,
+            (unsigned long) stats.counters[STAT_FRAMES_RECEIVED],
+            (unsigned long) stats.counters[STAT_FRAMES_KEPT],
+            (unsigned long) stats.counters[STAT_KERNEL_DROPS],
+            (unsigned long) stats.counters[STAT_INTERFACE_DROPS]);
+  }
+}
+
+/**
+ * Writes the stations with the largest estimated packet counts to the given stream.  Only the
+ * Space-Saving queue estimates counts, so the other queues write nothing.  The true count of
+ * each station lies between the two bounds written after its estimate.
+ *
+ * @param stream (FILE *) - where the stations are written
+ */
+void dumpTopStations(FILE *stream) {
+#ifdef NETFREE_SPACE_SAVING
+  StationEstimate estimates[NETFREE_TOP_STATIONS];
+  unsigned char   octets[NETFREE_MAC_SIZE];
+  int             estimateCount;
+  int             estimateIndex;
+
+  estimateCount = spaceSavingTopK(estimates, NETFREE_TOP_STATIONS);
+  if(estimateCount == 0) {
+    return;
+  }
+
+  fprintf(stream, "Top stations:\n");
+  for(estimateIndex = 0; estimateIndex < estimateCount; estimateIndex++) {
+    unpackMac(estimates[estimateIndex].macAddress, octets);
+    fprintf(stream, "\t" NETFREE_MAC_REGEX "       %lu packets (%lu to %lu)\n", NETFREE_ARR_TO_MAC(octets),
+            (unsigned long) estimates[estimateIndex].count,
+            (unsigned long) (estimates[estimateIndex].count - estimates[estimateIndex].error),
+            (unsigned long) estimates[estimateIndex].count);
+  }
+#endif
+}
+
+/**
+ * Releases the loops and descriptors set up by initEventLoops().  No thread may be running
+ * either loop.
+ */
+void destroyEventLoops() {
+  int workerIndex;
+
+  destroyEventLoop(&aggregatorLoop);
+  for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+    destroyEventLoop(&captureWorkers[workerIndex].loop);
+  }
+
+  if(handoffReady != -1) {
+    close(handoffReady);
+  }
+
+  if(scanDone != -1) {
+    close(scanDone);
+  }
+
+  handoffReady = -1;
+  scanDone = -1;
+}
+
 /**
  * Releases all resources used by the scanner.
  */
 void destroyScanner() {
-  if(scannerThread) {
-    pthread_cancel(scannerThread);
+  double          elapsed;
+  StatsSnapshot   stats;
+  unsigned long   framesCaptured;
+  int             interfaceIndex;
+  int             workerIndex;
+
+  if(scanStarted) {
+    // Ask every worker to stop and wait for it to merge what it has left.
+    stopCapture = 1;
+    for(interfaceIndex = 0; interfaceIndex < captureInterfaceCount; interfaceIndex++) {
+      if(captureInterfaces[interfaceIndex].pcapHandle) {
+        pcap_breakloop(captureInterfaces[interfaceIndex].pcapHandle);
+      }
+    }
+
+    for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+      stopEventLoop(&captureWorkers[workerIndex].loop, 0);
+      ringCaptureBreakLoop(&captureWorkers[workerIndex].ring);
+    }
+
+    for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+      pthread_join(captureWorkers[workerIndex].thread, NULL);
+    }
+
+    // The aggregator exits once it has drained what the workers handed over last.
+    pthread_join(aggregatorThread, NULL);
+    stopLogging();
+    destroyEventLoops();
+
+    updateScannerGauges();
+    getStats(&stats);
+    framesCaptured = stats.counters[STAT_FRAMES_RECEIVED];
+
+    elapsed = scanDuration();
+    if(elapsed > 0) {
+      NETFREE_INFO("Captured %lu frames in %.2fs (%.0f packets/sec, %s backend, %d interface(s), %d worker(s)).", framesCaptured, elapsed, framesCaptured / elapsed, captureBackendNames[scannerConfig.captureBackend], captureInterfaceCount, captureWorkerCount);
+    }
+
+    if(stats.gauges[STAT_HANDOFF_DROPS]) {
+      NETFREE_WARNING("Dropped %lu records because the aggregation thread fell behind.", (unsigned long) stats.gauges[STAT_HANDOFF_DROPS]);
+    }
+
+    dumpStats(stderr);
+    dumpInterfaceStats(stderr);
+    dumpTopStations(stderr);
+
+    if(scannerConfig.snapshotFile && saveSnapshot(scannerConfig.snapshotFile) < 0) {
+      NETFREE_ERROR("Could not save the stations to %s.", scannerConfig.snapshotFile);
+    }
   }
 
-  pcap_close(pcapDevHandle);
+  for(interfaceIndex = 0; interfaceIndex < captureInterfaceCount; interfaceIndex++) {
+    if(captureInterfaces[interfaceIndex].pcapHandle) {
+      pcap_close(captureInterfaces[interfaceIndex].pcapHandle);
+    }
+  }
+
+  destroyCaptureWorkers();
 
   free(deviceMacAddress);
   free(routerMacAddress);
@@ -121,48 +788,574 @@ void destroyScanner() {
  *=============================================================================*/
 
 /**
- * Receives and parses a packet from pcap.  The MAC addresses of the packet's sending and
- * receiving devices are read and added to the MAC queue as appropriate.
+ * Adds the frames the kernel passed to the worker, and the frames it dropped, to the
+ * worker's statistics.  A replayed file has no such counts.
+ *
+ * @param worker (CaptureWorker *) - the worker whose capture should be read
+ */
+void updateCaptureStats(CaptureWorker *worker) {
+  struct pcap_stat pcapStats;
+  unsigned int     received;
+  unsigned int     dropped;
+
+  if(scannerConfig.captureBackend == NETFREE_CAPTURE_RING) {
+    if(!ringCaptureStatistics(&worker->ring, &received, &dropped)) {
+      STATS_ADD(worker->stats, STAT_KERNEL_RECEIVED, received);
+      STATS_ADD(worker->stats, STAT_KERNEL_DROPS, dropped);
+    }
+  } else if(scannerConfig.captureBackend == NETFREE_CAPTURE_PCAP && !pcap_stats(worker->interface->pcapHandle, &pcapStats)) {
+    // libpcap reports totals, so only what changed since the last call is added.
+    STATS_ADD(worker->stats, STAT_KERNEL_RECEIVED, pcapStats.ps_recv - worker->pcapStats.ps_recv);
+    STATS_ADD(worker->stats, STAT_KERNEL_DROPS, pcapStats.ps_drop - worker->pcapStats.ps_drop);
+    STATS_ADD(worker->stats, STAT_INTERFACE_DROPS, pcapStats.ps_ifdrop - worker->pcapStats.ps_ifdrop);
+    worker->pcapStats = pcapStats;
+  }
+
+  worker->lastCaptureStats = worker->now;
+}
+
+/**
+ * Wakes the aggregation thread up after records were handed over.  The eventfd is only
+ * written when the aggregation thread has looked at the rings since it was last signalled,
+ * so a busy pipeline costs one write per wake-up rather than one per batch.
+ */
+void signalHandoff() {
+  uint64_t ready = 1;
+  ssize_t  written;
+
+  if(__atomic_load_n(&handoffSignalled, __ATOMIC_RELAXED) || __atomic_exchange_n(&handoffSignalled, 1, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+
+  written = write(handoffReady, &ready, sizeof(ready));
+  (void) written;
+}
+
+/**
+ * Hands the contents of the worker's station table to the aggregation thread and empties
+ * the table.
+ *
+ * @param worker (CaptureWorker *) - the worker whose table should be merged
+ */
+void mergeWorkerStations(CaptureWorker *worker) {
+  StationEntry *entry;
+  StationEntry *end = worker->stations.entries + worker->stations.capacity;
+  MacRecord     records[NETFREE_BATCH_SIZE];
+  int           recordCount = 0;
+
+  if(worker->stations.length) {
+    for(entry = worker->stations.entries; entry < end; entry++) {
+      if(!entry->key) {
+        continue;
+      }
+
+      records[recordCount].macAddress = STATION_KEY_MAC(entry->key);
+      records[recordCount].bssid = entry->bssid;
+      records[recordCount].packets = entry->packetsReceived;
+      records[recordCount].timestamp = entry->lastReceived;
+
+      if(++recordCount == NETFREE_BATCH_SIZE) {
+        spscRingPush(&worker->handoff, records, recordCount);
+        recordCount = 0;
+      }
+    }
+
+    spscRingPush(&worker->handoff, records, recordCount);
+    clearStationTable(&worker->stations);
+    signalHandoff();
+  }
+
+  worker->lastMerge = worker->now;
+}
+
+/**
+ * Hands the worker's batch of MacRecords on and empties it.  A lone worker pushes the batch
+ * to the aggregation thread; fanout workers fold it into their private station table.
+ *
+ * @param worker (CaptureWorker *) - the worker whose batch should be flushed
+ */
+void flushWorkerBatch(CaptureWorker *worker) {
+  int applied = 0;
+
+  if(captureWorkerCount == 1) {
+    if(worker->batchLength) {
+      spscRingPush(&worker->handoff, worker->batch, worker->batchLength);
+      signalHandoff();
+    }
+  } else {
+    while(applied < worker->batchLength) {
+      applied += stationTableAddBatch(&worker->stations, worker->batch + applied, worker->batchLength - applied);
+      if(applied < worker->batchLength) {
+        // The table is full, so merge it early to make room.
+        mergeWorkerStations(worker);
+      }
+    }
+  }
+
+  worker->batchLength = 0;
+}
+
+/**
+ * Classifies the frames the worker has gathered, turns the ones worth keeping into
+ * MacRecords and flushes the worker's batch.
+ *
+ * @param worker (CaptureWorker *) - the worker whose frames should be classified
+ */
+void flushWorkerFrames(CaptureWorker *worker) {
+  uint32_t   masks[NETFREE_BATCH_SIZE];
+  MacRecord *record;
+  char       octets[CLASSIFY_ADDRESSES][NETFREE_MAC_SIZE];
+  int        frameIndex;
+  int        address;
+  int        kept = 0;
+
+  classifyFrames(&frameClassifier, worker->frames, worker->frameCount, masks);
+
+  for(frameIndex = 0; frameIndex < worker->frameCount; frameIndex++) {
+    if(NETFREE_LOG_LEVEL <= NETFREE_LOG_DEBUG && (masks[frameIndex] & ALL_DEVICE_ADDRESSES) == ALL_DEVICE_ADDRESSES) {
+      for(address = 0; address < CLASSIFY_ADDRESSES; address++) {
+        unpackMac(worker->frames[frameIndex].addresses[address], octets[address]);
+      }
+
+      NETFREE_DEBUG("Received Packet:\n"
+                    "\tReceiver:\t" NETFREE_MAC_REGEX "\n"
+                    "\tTransmitter:\t" NETFREE_MAC_REGEX "\n"
+                    "\tBSSID:\t\t" NETFREE_MAC_REGEX "\n"
+                    "\tAddress 4:\t" NETFREE_MAC_REGEX,
+                    NETFREE_ARR_TO_MAC(octets[0]), NETFREE_ARR_TO_MAC(octets[1]), NETFREE_ARR_TO_MAC(octets[2]), NETFREE_ARR_TO_MAC(octets[3]));
+    }
+
+    // The transmitter is the station we may want to become, unless it is us or the router.
+    if(masks[frameIndex] & UNWANTED_TRANSMITTER) {
+      continue;
+    }
+
+    record = &worker->batch[worker->batchLength++];
+    record->macAddress = worker->frames[frameIndex].addresses[1];
+    record->bssid = (worker->frames[frameIndex].addresses[2] == CLASSIFY_NO_ADDRESS) ? 0 : worker->frames[frameIndex].addresses[2];
+    record->packets = 1;
+    record->timestamp = worker->now;
+    kept++;
+  }
+
+  if(worker->frameCount) {
+    STATS_ADD(worker->stats, STAT_FRAMES_PARSED, worker->frameCount);
+    STATS_ADD(worker->stats, STAT_FRAMES_KEPT, kept);
+    STATS_ADD(worker->stats, STAT_REJECT_UNWANTED, worker->frameCount - kept);
+  }
+
+  worker->frameCount = 0;
+  flushWorkerBatch(worker);
+}
+
+/**
+ * Flushes the worker's batch, refreshes the worker's coarse clock and merges its station
+ * table if the merge interval has elapsed.  Workers call this once per batch of frames (a
+ * ring block, a pcap_dispatch() call, ...) rather than once per frame.
+ *
+ * @param worker (CaptureWorker *) - the worker to update
+ */
+void workerTick(CaptureWorker *worker) {
+  struct timespec now;
+
+  flushWorkerFrames(worker);
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  worker->now = TIMESPEC_TO_NS(now);
+
+  if(captureWorkerCount > 1 && worker->now - worker->lastMerge >= NETFREE_MERGE_INTERVAL_MS * 1000000LL) {
+    mergeWorkerStations(worker);
+  }
+
+  if(worker->now - worker->lastCaptureStats >= NETFREE_MERGE_INTERVAL_MS * 1000000LL) {
+    updateCaptureStats(worker);
+  }
+}
+
+/**
+ * Parses a single captured frame.  The MAC addresses of the frame are gathered for
+ * flushWorkerFrames(), which classifies them a batch at a time and adds the frame's
+ * transmitter to the MAC queue as appropriate.  Every capture backend hands its frames to
+ * this function.
+ *
+ * @param worker (CaptureWorker *) - the worker that captured the frame
+ * @param packet (const u_char *) - the frame, starting with its radiotap header
+ * @param length (unsigned int) - the number of bytes captured
+ */
+void parseFrame(CaptureWorker *worker, const u_char *packet, unsigned int length) {
+  RadioTapFields radioTapFields;
+  FrameDescriptor descriptor;
+  FrameAddresses *frame;
+  int wifiOffset;
+  int status;
+
+  STATS_ADD(worker->stats, STAT_FRAMES_RECEIVED, 1);
+
+  wifiOffset = parseRadioTap(packet, length, &radioTapFields);
+  if(wifiOffset < 0) {
+    STATS_ADD(worker->stats, STAT_REJECT_RADIOTAP, 1);
+
+    return;
+  }
+
+  status = decodeFrame(packet + wifiOffset, length - wifiOffset, &descriptor);
+  if(status == FRAME_REJECT_TYPE) {
+    STATS_ADD(worker->stats, STAT_REJECT_NOT_DATA, 1);
+
+    return;
+  } else if(status) {
+    STATS_ADD(worker->stats, STAT_REJECT_TRUNCATED, 1);
+
+    return;
+  }
+
+  // A frame that failed its checksum cannot be trusted to carry real addresses.
+  if(RADIOTAP_HAS(&radioTapFields, RADIOTAP_FLAGS) && (radioTapFields.flags & RADIOTAP_FLAG_BAD_FCS)) {
+    STATS_ADD(worker->stats, STAT_REJECT_BAD_FCS, 1);
+
+    return;
+  }
+
+  frame = &worker->frames[worker->frameCount++];
+  frame->addresses[0] = descriptor.receiver;
+  frame->addresses[1] = descriptor.transmitter;
+  frame->addresses[2] = descriptor.bssid ? descriptor.bssid : CLASSIFY_NO_ADDRESS;
+  frame->addresses[3] = descriptor.address4 ? descriptor.address4 : CLASSIFY_NO_ADDRESS;
+
+  if(worker->frameCount == NETFREE_BATCH_SIZE) {
+    flushWorkerFrames(worker);
+  }
+}
+
+/**
+ * Receives a packet from pcap and hands it to the parser.
  *
- * @param args (u_char *) - unused
+ * @param args (u_char *) - the CaptureWorker that is capturing
  * @param header (const struct pcap_pkthdr) - the header for the packet that was received
  * @param packet (const u_char *) - the packet that was received
  */
 void receivePacket(u_char *args, const struct pcap_pkthdr *header, const u_char *packet) {
-  RadioTapHeader *radioTapHeader;
-  WiFiHeader *wifiHeader;
-  IpHeader *ipHeader;
+  parseFrame((CaptureWorker *) args, packet, header->caplen);
+}
+
+/**
+ * Receives a block retired by the capture ring and parses each of its frames in place.
+ *
+ * @param args (void *) - the CaptureWorker that owns the ring
+ * @param block (struct tpacket_block_desc *) - the block that was retired
+ */
+void receiveBlock(void *args, struct tpacket_block_desc *block) {
+  CaptureWorker       *worker = (CaptureWorker *) args;
+  struct tpacket3_hdr *frame;
+  uint32_t             frameIndex;
+
+  workerTick(worker);
+
+  frame = RING_FIRST_FRAME(block);
+  for(frameIndex = 0; frameIndex < RING_BLOCK_FRAME_COUNT(block); frameIndex++) {
+    parseFrame(worker, RING_FRAME_DATA(frame), frame->tp_snaplen);
+
+    frame = RING_NEXT_FRAME(frame);
+  }
+
+  flushWorkerFrames(worker);
+}
+
+/**
+ * Feeds every frame of the recording opened by openReplayCapture() to receivePacket().
+ * With a replaySpeed of NETFREE_REPLAY_FASTEST frames are delivered back to back.
+ * Otherwise the gap between two frames is the recorded gap divided by replaySpeed.
+ *
+ * @param worker (CaptureWorker *) - the worker replaying the file
+ */
+void replayCapture(CaptureWorker *worker) {
+  pcap_t             *pcapDevHandle = worker->interface->pcapHandle;
+  struct pcap_pkthdr *header;
+  const u_char       *packet;
+  struct timeval      firstTimestamp;
+  struct timespec     releaseTime;
+  double              offset;
+  int                 status;
+  int                 firstFrame = 1;
+  unsigned long       framesReplayed = 0;
+
+  while(!stopCapture && (status = pcap_next_ex(pcapDevHandle, &header, &packet)) >= 0) {
+    if(status == 0) {
+      continue;
+    }
+
+    if(scannerConfig.replaySpeed > 0) {
+      if(firstFrame) {
+        firstTimestamp = header->ts;
+        firstFrame = 0;
+      }
+
+      // Sleep until this frame's offset into the recording, scaled by the replay speed.
+      offset = ((double) (header->ts.tv_sec - firstTimestamp.tv_sec) + (1.0e-6 * (header->ts.tv_usec - firstTimestamp.tv_usec))) / scannerConfig.replaySpeed;
+
+      releaseTime.tv_sec = captureStart.tv_sec + (time_t) offset;
+      releaseTime.tv_nsec = captureStart.tv_nsec + (long) ((offset - (time_t) offset) * 1.0e9);
+      if(releaseTime.tv_nsec >= 1000000000L) {
+        releaseTime.tv_sec++;
+        releaseTime.tv_nsec -= 1000000000L;
+      }
+
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &releaseTime, NULL);
+    }
+
+    if(scannerConfig.replaySpeed > 0 || !(framesReplayed % NETFREE_REPLAY_TICK_FRAMES)) {
+      workerTick(worker);
+    }
+
+    receivePacket((u_char *) worker, header, packet);
+    framesReplayed++;
+  }
 
-  radioTapHeader = (RadioTapHeader *) radioTapHeader;
-  wifiHeader = (WiFiHeader *) (WIFI_START(radioTapHeader));
+  if(status == PCAP_ERROR) {
+    NETFREE_ERROR("An error occurred while replaying the capture:\n\t%s", pcap_geterr(pcapDevHandle));
+  }
+}
 
-  fprintf(stderr, "Received packet...\n");
+/**
+ * Reads every frame libpcap has ready without blocking.  The worker's loop calls this when
+ * the pcap selectable descriptor becomes readable, and stops once destroyScanner() breaks
+ * the capture or the capture fails.
+ *
+ * @param loop (EventLoop *) - the worker's loop
+ * @param context (void *) - the CaptureWorker that is capturing
+ * @param events (uint64_t) - unused
+ */
+void receivePcapFrames(EventLoop *loop, void *context, uint64_t events) {
+  CaptureWorker *worker = (CaptureWorker *) context;
+  pcap_t        *pcapDevHandle = worker->interface->pcapHandle;
+  int            status;
 
-  if(macEquals(deviceMacAddress, wifiHeader->addr1) && macEquals(deviceMacAddress, wifiHeader->addr2) && macEquals(deviceMacAddress, wifiHeader->addr3) && macEquals(deviceMacAddress, wifiHeader->addr4)) {
-    fprintf(stderr, "Received Packet:\n");
+  do {
+    status = pcap_dispatch(pcapDevHandle, NETFREE_BATCH_SIZE, receivePacket, (u_char *) worker);
+    workerTick(worker);
+  } while(status > 0 && !stopCapture);
 
-    fprintf(stderr, "\tControl Code:\t%d\n", WIFI_FLAG_TYPE(wifiHeader));
-    fprintf(stderr, "\tAddress 1:\t" NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(wifiHeader->addr1));
-    fprintf(stderr, "\tAddress 1:\t" NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(wifiHeader->addr2));
-    fprintf(stderr, "\tAddress 1:\t" NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(wifiHeader->addr3));
-    fprintf(stderr, "\tAddress 1:\t" NETFREE_MAC_REGEX "\n", NETFREE_ARR_TO_MAC(wifiHeader->addr4));
+  if(status == PCAP_ERROR) {
+    NETFREE_ERROR("An error occurred while capturing on %s:\n\t%s", worker->interface->name, pcap_geterr(pcapDevHandle));
+    stopEventLoop(loop, -1);
+  } else if(status == PCAP_ERROR_BREAK || stopCapture) {
+    stopEventLoop(loop, 0);
   }
 }
 
 /**
- * The start routine for the thread that will be responsible for listening to the
- * promiscuous port opened earlier indefinitely.  This thread will be cancelable at any
- * time.
+ * Ticks the worker every NETFREE_MERGE_INTERVAL_MS, so its statistics stay current while no
+ * frame arrives.
+ *
+ * @param loop (EventLoop *) - the worker's loop
+ * @param context (void *) - the CaptureWorker to tick
+ * @param expirations (uint64_t) - unused
+ */
+void tickWorker(EventLoop *loop, void *context, uint64_t expirations) {
+  workerTick((CaptureWorker *) context);
+}
+
+/**
+ * The start routine for a capture worker.  The worker listens to the promiscuous port
+ * opened earlier until destroyScanner() asks it to stop or, when replaying, until the
+ * recording runs out.
+ *
+ * @param ptr (void *) - the CaptureWorker to run
  */
 void *scanNetwork(void *ptr) {
-  int oldValue;
+  CaptureWorker *worker = (CaptureWorker *) ptr;
+
+  workerTick(worker);
+
+  if(scannerConfig.captureBackend == NETFREE_CAPTURE_RING) {
+    ringCaptureLoop(&worker->ring, receiveBlock, worker);
+  } else if(scannerConfig.captureBackend == NETFREE_CAPTURE_REPLAY) {
+    replayCapture(worker);
+  } else {
+    runEventLoop(&worker->loop);
+  }
+
+  flushWorkerFrames(worker);
+  mergeWorkerStations(worker);
+  updateCaptureStats(worker);
+  __atomic_add_fetch(&workersFinished, 1, __ATOMIC_RELEASE);
+  signalHandoff();
+
+  return NULL;
+}
+
+/**
+ * Applies a batch of MacRecords to the MAC queue, recording how old each record was when it
+ * got there and how long the queue took to apply the batch.
+ *
+ * @param records (MacRecord *) - the records to apply
+ * @param count (int) - the number of records
+ */
+void enqueueTimedBatch(MacRecord *records, int count) {
+  struct timespec now;
+  int64_t         start;
+  int             recordIndex;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  start = TIMESPEC_TO_NS(now);
+
+  // A record without a timestamp was received "now".
+  for(recordIndex = 0; recordIndex < count; recordIndex++) {
+    if(records[recordIndex].timestamp > 0) {
+      STATS_RECORD(aggregatorStats, STAT_ENQUEUE_LATENCY, start - records[recordIndex].timestamp);
+    } else {
+      STATS_RECORD(aggregatorStats, STAT_ENQUEUE_LATENCY, 0);
+    }
+  }
+
+  enqueueMacBatch(records, count);
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  STATS_RECORD(aggregatorStats, STAT_RANKING_LATENCY, TIMESPEC_TO_NS(now) - start);
+  STATS_ADD(aggregatorStats, STAT_RECORDS_ENQUEUED, count);
+}
+
+/**
+ * Drains every worker's SpscRing once and applies what it finds to the MAC queue, one batch
+ * per lock acquisition.  The aggregation loop calls this whenever a worker signals
+ * handoffReady.  If anything was drained, the handler signals itself so the loop comes back
+ * for the rest after any timer that is due.  Once every worker has finished and the rings
+ * are empty, the loop is stopped.
+ *
+ * @param loop (EventLoop *) - the aggregation loop
+ * @param context (void *) - unused
+ * @param events (uint64_t) - unused
+ */
+void drainHandoffs(EventLoop *loop, void *context, uint64_t events) {
+  MacRecord records[NETFREE_BATCH_SIZE];
+  uint64_t  ready;
+  ssize_t   bytesRead;
+  int       workerIndex;
+  int       popped;
+  int       drained = 0;
+  int       finished;
+
+  bytesRead = read(handoffReady, &ready, sizeof(ready));
+  (void) bytesRead;
+
+  // Cleared before the rings are read, so a worker that pushes after this signals again.
+  __atomic_store_n(&handoffSignalled, 0, __ATOMIC_SEQ_CST);
+
+  // Checked before draining so records pushed by a worker before it finished are not missed.
+  finished = __atomic_load_n(&workersFinished, __ATOMIC_ACQUIRE) == captureWorkerCount;
+
+  for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+    popped = spscRingPop(&captureWorkers[workerIndex].handoff, records, NETFREE_BATCH_SIZE);
+    if(popped) {
+      enqueueTimedBatch(records, popped);
+      drained += popped;
+    }
+  }
+
+  if(drained) {
+    signalHandoff();
+  } else if(finished) {
+    stopEventLoop(loop, 0);
+  }
+}
+
+/**
+ * Keeps the scanner's gauges current.  Runs every NETFREE_MERGE_INTERVAL_MS.
+ */
+void refreshGauges(EventLoop *loop, void *context, uint64_t expirations) {
+  updateScannerGauges();
+}
+
+/**
+ * Dumps the statistics.  Runs every NETFREE_STATS_INTERVAL_MS.
+ */
+void dumpStatsPeriodically(EventLoop *loop, void *context, uint64_t expirations) {
+  dumpStats(stderr);
+  dumpInterfaceStats(stderr);
+  dumpTopStations(stderr);
+}
+
+/**
+ * Saves the MAC queue to the configured snapshot file.  Runs every
+ * NETFREE_SNAPSHOT_INTERVAL_MS.
+ */
+void saveSnapshotPeriodically(EventLoop *loop, void *context, uint64_t expirations) {
+  if(saveSnapshot(scannerConfig.snapshotFile) < 0) {
+    NETFREE_WARNING("Could not save the stations to %s.", scannerConfig.snapshotFile);
+  }
+}
+
+/**
+ * Prepares the loops the pcap workers and the aggregation thread run.  The aggregation loop
+ * wakes up when a worker hands records over and for its timers; a pcap worker's loop wakes
+ * up when libpcap has frames on its interface and to tick the worker.
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int initEventLoops() {
+  CaptureWorker *worker;
+  int            status;
+
+  handoffSignalled = 0;
+  handoffReady = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  status = initEventLoop(&aggregatorLoop);
+  if(scannerConfig.captureBackend == NETFREE_CAPTURE_PCAP) {
+    for(worker = captureWorkers; worker < captureWorkers + captureWorkerCount; worker++) {
+      status |= initEventLoop(&worker->loop);
+    }
+  }
+
+  if(status || handoffReady == -1) {
+    return -12;
+  }
+
+  status = addEventDescriptor(&aggregatorLoop, handoffReady, EPOLLIN, drainHandoffs, NULL) == -1;
+  status |= addEventTimer(&aggregatorLoop, NETFREE_MERGE_INTERVAL_MS, refreshGauges, NULL) == -1;
+  if(NETFREE_STATS_INTERVAL_MS) {
+    status |= addEventTimer(&aggregatorLoop, NETFREE_STATS_INTERVAL_MS, dumpStatsPeriodically, NULL) == -1;
+  }
 
-  fprintf(stderr, "Starting scan...\n");
+  if(scannerConfig.snapshotFile) {
+    status |= addEventTimer(&aggregatorLoop, NETFREE_SNAPSHOT_INTERVAL_MS, saveSnapshotPeriodically, NULL) == -1;
+  }
 
-  pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldValue);
-  pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldValue);
+  if(scannerConfig.captureBackend == NETFREE_CAPTURE_PCAP) {
+    for(worker = captureWorkers; worker < captureWorkers + captureWorkerCount; worker++) {
+      status |= addEventDescriptor(&worker->loop, pcap_get_selectable_fd(worker->interface->pcapHandle), EPOLLIN, receivePcapFrames, worker) == -1;
+      status |= addEventTimer(&worker->loop, NETFREE_MERGE_INTERVAL_MS, tickWorker, worker) == -1;
+    }
+  }
 
-  pcap_loop(pcapDevHandle, -1, receivePacket, NULL);
+  return status ? -12 : 0;
+}
+
+/**
+ * The start routine for the aggregation thread.  It runs the aggregation loop until every
+ * worker has finished and everything they handed over is in the MAC queue.  Along the way
+ * the loop keeps the scanner's gauges current, dumps the statistics every
+ * NETFREE_STATS_INTERVAL_MS and, if a snapshot file is configured, saves the MAC queue
+ * every NETFREE_SNAPSHOT_INTERVAL_MS.
+ *
+ * @param ptr (void *) - unused
+ */
+void *aggregateStations(void *ptr) {
+  uint64_t done = 1;
+  ssize_t  bytesWritten;
+
+  updateScannerGauges();
+
+  if(runEventLoop(&aggregatorLoop)) {
+    NETFREE_ERROR("The aggregation thread stopped waiting for records.");
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &captureEnd);
+  __atomic_store_n(&aggregatorFinished, 1, __ATOMIC_RELEASE);
+
+  bytesWritten = write(scanDone, &done, sizeof(done));
+  (void) bytesWritten;
+
+  return NULL;
 }
 
 /*=============================================================================
@@ -172,16 +1365,104 @@ void *scanNetwork(void *ptr) {
  *=============================================================================*/
 
 /**
- * Starts scanning for possible MAC addresses to spoof.  This method starts a new thread
- * that will continue populating a list of MAC addresses until the scanner is destroyed (by
- * calling destroyScanner()).  This method is guaranteed not to return until at least
- * NETFREE_MIN_ADDRESSES, which is defined in scanner.h, addresses are found.
+ * Starts scanning for possible MAC addresses to spoof without waiting for any.  This method
+ * starts a thread per capture worker and the aggregation thread, which will continue
+ * populating the MAC queue until the scanner is destroyed (by calling destroyScanner()).
+ *
+ * @return (int) 0 on success, a negative integer otherwise
+ */
+int startScan() {
+  int workerIndex;
+  int status;
+
+  NETFREE_INFO("Starting scan...");
+
+  scanDone = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  status = initEventLoops();
+  if(status || scanDone == -1) {
+    NETFREE_ERROR("Could not set up the scanner's event loops.");
+    destroyEventLoops();
+
+    return status ? status : -12;
+  }
+
+  startLogging();
+
+  clock_gettime(CLOCK_MONOTONIC, &captureStart);
+  for(workerIndex = 0; workerIndex < captureWorkerCount; workerIndex++) {
+    pthread_create(&captureWorkers[workerIndex].thread, NULL, scanNetwork, &captureWorkers[workerIndex]);
+  }
+
+  pthread_create(&aggregatorThread, NULL, aggregateStations, NULL);
+
+  scanStarted = 1;
+
+  return 0;
+}
+
+/**
+ * Starts scanning for possible MAC addresses to spoof (see startScan()).  This method is
+ * guaranteed not to return until at least NETFREE_MIN_ADDRESSES, which is defined in
+ * scanner.h, addresses are found, unless the capture ends first (e.g. a replayed file runs
+ * out of frames) or could not be started.
  */
 void scan() {
-  pthread_create(&scannerThread, NULL, scanNetwork, NULL);
+  struct pollfd waits[2];
+  int           populated;
 
-  // Give the system to populate.
-  while(macQueueLength() < NETFREE_MIN_ADDRESSES) {
-    sleep(1);
+  if(startScan()) {
+    return;
   }
-}
\ No newline at end of file
+
+  // The subscription fires as soon as the queue is large enough, and scanDone when the capture ends.
+  populated = subscribeMacQueue(MAC_QUEUE_EVENT_LENGTH, NETFREE_MIN_ADDRESSES);
+
+  waits[0].fd = populated;
+  waits[0].events = POLLIN;
+  waits[1].fd = scanDone;
+  waits[1].events = POLLIN;
+
+  while(macQueueLength() < NETFREE_MIN_ADDRESSES && !scanFinished()) {
+    poll(waits, 2, populated == -1 ? NETFREE_MERGE_INTERVAL_MS : -1);
+  }
+
+  unsubscribeMacQueue(populated);
+}
+
+/**
+ * Returns a descriptor that becomes readable once the scan has finished (see
+ * scanFinished()), so callers can wait for it in poll() or epoll.
+ *
+ * @return (int) the descriptor, which belongs to the scanner, or -1 if no scan was started
+ */
+int scanFinishedDescriptor() {
+  return scanStarted ? scanDone : -1;
+}
+
+/**
+ * Determines whether the scan has finished, which only happens on its own when a replayed
+ * file runs out of frames.  By then every frame has reached the MAC queue.
+ *
+ * @return (int) 1 if the scan has finished, 0 otherwise
+ */
+int scanFinished() {
+  return __atomic_load_n(&aggregatorFinished, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Returns how long the scan has run: from the call to scan() until the last frame reached
+ * the MAC queue or, if the scan is still running, until now.
+ *
+ * @return (double) the duration of the scan, in seconds
+ */
+double scanDuration() {
+  struct timespec end;
+
+  if(scanFinished()) {
+    end = captureEnd;
+  } else {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+  }
+
+  return (double) (end.tv_sec - captureStart.tv_sec) + (1.0e-9 * (end.tv_nsec - captureStart.tv_nsec));
+}
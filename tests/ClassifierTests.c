@@ -0,0 +1,113 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "Classifier.h"
+
+// Not a multiple of any vector width, so a batch never ends on a whole vector.
+#define CLASSIFIER_TEST_FRAMES  61
+
+FrameAddresses classifierFrames[CLASSIFIER_TEST_FRAMES];
+uint32_t       scalarMasks[CLASSIFIER_TEST_FRAMES];
+uint32_t       vectorMasks[CLASSIFIER_TEST_FRAMES];
+
+/**
+ * Returns a random 48-bit unicast address.
+ */
+MacAddress randomUnicastAddress(unsigned int *seed) {
+  MacAddress address = ((MacAddress) rand_r(seed) << 24) ^ (MacAddress) rand_r(seed);
+
+  return address & 0xffffffffffffULL & ~CLASSIFY_GROUP_BIT;
+}
+
+/**
+ * Fills classifierFrames with addresses drawn from the references, group addresses,
+ * missing addresses and unrelated unicast addresses.
+ */
+void randomizeFrames(const MacAddress *references, int referenceCount, unsigned int *seed) {
+  int frameIndex;
+  int address;
+
+  for(frameIndex = 0; frameIndex < CLASSIFIER_TEST_FRAMES; frameIndex++) {
+    for(address = 0; address < CLASSIFY_ADDRESSES; address++) {
+      switch(rand_r(seed) % 5) {
+        case 0:
+          classifierFrames[frameIndex].addresses[address] = references[rand_r(seed) % referenceCount];
+          break;
+        case 1:
+          classifierFrames[frameIndex].addresses[address] = randomUnicastAddress(seed) | CLASSIFY_GROUP_BIT;
+          break;
+        case 2:
+          classifierFrames[frameIndex].addresses[address] = CLASSIFY_NO_ADDRESS;
+          break;
+        default:
+          classifierFrames[frameIndex].addresses[address] = randomUnicastAddress(seed);
+      }
+    }
+  }
+}
+
+void test_classifyFrames_implementationsAgree() {
+  const char  *implementations[] = {"sse2", "avx2"};
+  MacAddress   references[NETFREE_CLASSIFIER_MAX_REFERENCES];
+  Classifier   classifier;
+  unsigned int seed = 7;
+  int          implementation;
+  int          reference;
+  int          round;
+  int          compared = 0;
+
+  for(round = 0; round < 16; round++) {
+    for(reference = 0; reference < NETFREE_CLASSIFIER_MAX_REFERENCES; reference++) {
+      references[reference] = randomUnicastAddress(&seed);
+    }
+
+    // One of the references is the broadcast address, as the scanner's BSSID may be.
+    references[round % NETFREE_CLASSIFIER_MAX_REFERENCES] = 0xffffffffffffULL;
+    randomizeFrames(references, NETFREE_CLASSIFIER_MAX_REFERENCES, &seed);
+
+    initClassifier(&classifier, references, 1 + round % NETFREE_CLASSIFIER_MAX_REFERENCES);
+    setClassifierImplementation(&classifier, "scalar");
+    classifyFrames(&classifier, classifierFrames, CLASSIFIER_TEST_FRAMES, scalarMasks);
+
+    for(implementation = 0; implementation < 2; implementation++) {
+      // Only the implementations the CPU supports can be compared.
+      if(setClassifierImplementation(&classifier, implementations[implementation])) {
+        continue;
+      }
+
+      memset(vectorMasks, 0xff, sizeof(vectorMasks));
+      classifyFrames(&classifier, classifierFrames, CLASSIFIER_TEST_FRAMES, vectorMasks);
+
+      int differences = memcmp(scalarMasks, vectorMasks, sizeof(scalarMasks));
+      expect(&differences)->to->equal(0);
+      compared++;
+    }
+  }
+
+  bool vectorized = compared > 0;
+  expect(&vectorized)->toBe->True();
+}
+
+void test_classifyFrames_groupAndMissingAddresses() {
+  MacAddress     reference = 0x001122334455ULL;
+  FrameAddresses frame = {{reference, 0xffffffffffffULL, CLASSIFY_NO_ADDRESS, CLASSIFY_NO_ADDRESS | CLASSIFY_GROUP_BIT}};
+  Classifier     classifier;
+  uint32_t       mask;
+
+  initClassifier(&classifier, &reference, 1);
+  classifyFrames(&classifier, &frame, 1, &mask);
+
+  bool expected = mask == (CLASSIFY_MATCH(0, 0) | CLASSIFY_GROUP(1));
+  expect(&expected)->toBe->True();
+}
+
+void addClassifierTests() {
+  describe("Classifier Tests");
+    describe("classifyFrames()");
+      test("should produce the same masks with every implementation", test_classifyFrames_implementationsAgree);
+      test("should only set the group bit of addresses the frame carries", test_classifyFrames_groupAndMissingAddresses);
+    endDescribe();
+  endDescribe();
+}
@@ -0,0 +1,133 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "EventLoop.h"
+
+#define STOP_STATUS   7
+
+EventLoop eventLoop;
+int       handlerCalls;
+int       firstPipe[2];
+int       secondPipe[2];
+
+/**
+ * Counts its calls and stops the loop on the third.
+ */
+void stopOnThirdCall(EventLoop *loop, void *context, uint64_t expirations) {
+  handlerCalls += expirations;
+  if(handlerCalls >= 3) {
+    stopEventLoop(loop, STOP_STATUS);
+  }
+}
+
+/**
+ * Stops the loop passed as ptr from another thread after a short while.
+ */
+void *stopFromThread(void *ptr) {
+  struct timespec delay = {0, 10000000L};
+
+  nanosleep(&delay, NULL);
+  stopEventLoop((EventLoop *) ptr, STOP_STATUS);
+
+  return NULL;
+}
+
+/**
+ * Removes both pipes, whichever of them is ready first.
+ */
+void removeBothPipes(EventLoop *loop, void *context, uint64_t events) {
+  handlerCalls++;
+  removeEventSource(loop, firstPipe[0]);
+  removeEventSource(loop, secondPipe[0]);
+}
+
+/**
+ * Stops the loop once the sources before it had their chance to run.
+ */
+void stopLoop(EventLoop *loop, void *context, uint64_t expirations) {
+  stopEventLoop(loop, STOP_STATUS);
+}
+
+void beforeEach_eventLoop() {
+  handlerCalls = 0;
+  initEventLoop(&eventLoop);
+}
+
+void afterEach_eventLoop() {
+  destroyEventLoop(&eventLoop);
+}
+
+void test_addEventTimer_firesUntilStopped() {
+  int timer = addEventTimer(&eventLoop, 1, stopOnThirdCall, NULL);
+  bool added = timer != -1;
+  expect(&added)->toBe->True();
+
+  int status = runEventLoop(&eventLoop);
+  expect(&status)->to->equal(STOP_STATUS);
+
+  expect(&handlerCalls)->to->equal(3);
+}
+
+void test_stopEventLoop_fromAnotherThread() {
+  pthread_t thread;
+
+  // Without any source, only the stop request can wake the loop up.
+  pthread_create(&thread, NULL, stopFromThread, &eventLoop);
+
+  int status = runEventLoop(&eventLoop);
+  expect(&status)->to->equal(STOP_STATUS);
+
+  pthread_join(thread, NULL);
+}
+
+void test_removeEventSource_insideHandler() {
+  char byte = 0;
+
+  pipe(firstPipe);
+  pipe(secondPipe);
+  addEventDescriptor(&eventLoop, firstPipe[0], EPOLLIN, removeBothPipes, NULL);
+  addEventDescriptor(&eventLoop, secondPipe[0], EPOLLIN, removeBothPipes, NULL);
+  addEventTimer(&eventLoop, 10, stopLoop, NULL);
+
+  // Both pipes are ready in the same round, but the first handler removes the other.
+  write(firstPipe[1], &byte, 1);
+  write(secondPipe[1], &byte, 1);
+
+  int status = runEventLoop(&eventLoop);
+  expect(&status)->to->equal(STOP_STATUS);
+
+  expect(&handlerCalls)->to->equal(1);
+
+  // Descriptors added by the caller are left open.
+  bool open = fcntl(firstPipe[0], F_GETFD) != -1 && fcntl(secondPipe[0], F_GETFD) != -1;
+  expect(&open)->toBe->True();
+
+  close(firstPipe[0]);
+  close(firstPipe[1]);
+  close(secondPipe[0]);
+  close(secondPipe[1]);
+}
+
+void addEventLoopTests() {
+  describe("Event Loop Tests");
+    beforeEach(beforeEach_eventLoop);
+    afterEach(afterEach_eventLoop);
+
+    describe("addEventTimer()");
+      test("should call the handler every interval until the loop is stopped", test_addEventTimer_firesUntilStopped);
+    endDescribe();
+
+    describe("stopEventLoop()");
+      test("should wake the loop up from another thread", test_stopEventLoop_fromAnotherThread);
+    endDescribe();
+
+    describe("removeEventSource()");
+      test("should not call the handler of a source removed earlier in the same round", test_removeEventSource_insideHandler);
+    endDescribe();
+  endDescribe();
+}
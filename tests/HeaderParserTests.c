@@ -0,0 +1,191 @@
+#include <string.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "HeaderParser.h"
+
+u_char radioTapBuffer[64];
+
+/**
+ * Stores a little-endian present bitmap at the specified offset of radioTapBuffer.
+ */
+void setPresentWord(int offset, u_int32_t presentWord) {
+  radioTapBuffer[offset] = presentWord & 0xff;
+  radioTapBuffer[offset + 1] = (presentWord >> 8) & 0xff;
+  radioTapBuffer[offset + 2] = (presentWord >> 16) & 0xff;
+  radioTapBuffer[offset + 3] = (presentWord >> 24) & 0xff;
+}
+
+void beforeEach_parseRadioTap() {
+  memset(radioTapBuffer, 0, sizeof(radioTapBuffer));
+}
+
+void test_parseRadioTap_alignsFields() {
+  RadioTapFields fields;
+
+  // TSFT (8 @ 8), flags (16), rate (17), channel (2-aligned @ 18), antenna signal (22).
+  radioTapBuffer[2] = 23;
+  setPresentWord(4, (1 << RADIOTAP_TSFT) | (1 << RADIOTAP_FLAGS) | (1 << RADIOTAP_RATE) | (1 << RADIOTAP_CHANNEL) | (1 << RADIOTAP_DBM_ANTSIGNAL));
+  radioTapBuffer[8] = 0x2a;
+  radioTapBuffer[17] = 12;
+  radioTapBuffer[18] = 0x6c;
+  radioTapBuffer[19] = 0x09;
+  radioTapBuffer[22] = (u_char) -40;
+
+  int headerLength = parseRadioTap(radioTapBuffer, sizeof(radioTapBuffer), &fields);
+  expect(&headerLength)->to->equal(23);
+
+  int tsft = (int) fields.tsft;
+  expect(&tsft)->to->equal(0x2a);
+
+  int rate = fields.rate;
+  expect(&rate)->to->equal(12);
+
+  int frequency = fields.channelFrequency;
+  expect(&frequency)->to->equal(2412);
+
+  int signal = fields.antennaSignal;
+  expect(&signal)->to->equal(-40);
+}
+
+void test_parseRadioTap_extendedBitmaps() {
+  RadioTapFields fields;
+
+  // Three bitmaps, so the data starts at 16 and the first antenna signal follows the TSFT.
+  radioTapBuffer[2] = 28;
+  setPresentWord(4, (1 << RADIOTAP_TSFT) | (1 << RADIOTAP_DBM_ANTSIGNAL) | (1U << RADIOTAP_RADIOTAP_NAMESPACE) | (1U << RADIOTAP_EXT));
+  setPresentWord(8, (1 << RADIOTAP_DBM_ANTSIGNAL) | (1U << RADIOTAP_RADIOTAP_NAMESPACE) | (1U << RADIOTAP_EXT));
+  setPresentWord(12, 1 << RADIOTAP_DBM_ANTSIGNAL);
+  radioTapBuffer[16] = 0x11;
+  radioTapBuffer[24] = (u_char) -50;
+  radioTapBuffer[25] = (u_char) -51;
+
+  int headerLength = parseRadioTap(radioTapBuffer, sizeof(radioTapBuffer), &fields);
+  expect(&headerLength)->to->equal(28);
+
+  int tsft = (int) fields.tsft;
+  expect(&tsft)->to->equal(0x11);
+
+  int signal = fields.antennaSignal;
+  expect(&signal)->to->equal(-50);
+}
+
+void test_nextRadioTapField_skipsVendorNamespace() {
+  RadioTapIterator iterator;
+
+  // Flags (16), a vendor namespace header (18) with 3 bytes of data (24), then antenna signal (27).
+  radioTapBuffer[2] = 28;
+  setPresentWord(4, (1 << RADIOTAP_FLAGS) | (1U << RADIOTAP_VENDOR_NAMESPACE) | (1U << RADIOTAP_EXT));
+  setPresentWord(8, 1 | (1U << RADIOTAP_RADIOTAP_NAMESPACE) | (1U << RADIOTAP_EXT));
+  setPresentWord(12, 1 << RADIOTAP_DBM_ANTSIGNAL);
+  radioTapBuffer[22] = 3;
+
+  initRadioTapIterator(&iterator, radioTapBuffer, sizeof(radioTapBuffer));
+
+  nextRadioTapField(&iterator);
+  int offset = iterator.fieldData - radioTapBuffer;
+  expect(&offset)->to->equal(16);
+
+  nextRadioTapField(&iterator);
+  int field = iterator.fieldIndex;
+  expect(&field)->to->equal(RADIOTAP_DBM_ANTSIGNAL);
+
+  offset = iterator.fieldData - radioTapBuffer;
+  expect(&offset)->to->equal(27);
+
+  int status = nextRadioTapField(&iterator);
+  expect(&status)->to->equal(0);
+}
+
+void test_parseRadioTap_truncated() {
+  RadioTapFields fields;
+
+  radioTapBuffer[2] = 23;
+  setPresentWord(4, 1 << RADIOTAP_TSFT);
+
+  int headerLength = parseRadioTap(radioTapBuffer, 12, &fields);
+  expect(&headerLength)->to->equal(-1);
+}
+
+void test_decodeFrame_qosToDistribution() {
+  FrameDescriptor descriptor;
+  u_char          frame[40] = {0x88, WIFI_FC_TO_DS | WIFI_FC_RETRY | WIFI_FC_ORDER};
+
+  // addr1 (the BSSID, when sent to the distribution system) is 02:00:00:00:00:01.
+  frame[4] = 0x02;
+  frame[9] = 0x01;
+
+  int status = decodeFrame(frame, sizeof(frame), &descriptor);
+  expect(&status)->to->equal(0);
+
+  int headerLength = descriptor.headerLength;
+  expect(&headerLength)->to->equal(30);
+
+  int bssidIsReceiver = descriptor.bssid == descriptor.receiver && descriptor.bssid == 0x020000000001ULL;
+  expect(&bssidIsReceiver)->to->equal(1);
+
+  int flags = descriptor.flags;
+  expect(&flags)->to->equal(FRAME_QOS | FRAME_HT_CONTROL | FRAME_TO_DS | FRAME_RETRY);
+}
+
+void test_decodeFrame_protectedPayload() {
+  FrameDescriptor descriptor;
+  u_char          frame[40] = {0x08, WIFI_FC_FROM_DS | WIFI_FC_PROTECTED};
+
+  // The fourth byte of the IV announces an extended IV (CCMP).
+  frame[27] = 0x20;
+
+  decodeFrame(frame, sizeof(frame), &descriptor);
+
+  int payloadOffset = descriptor.payloadOffset;
+  expect(&payloadOffset)->to->equal(32);
+
+  int status = decodeFrame(frame, 26, &descriptor);
+  expect(&status)->to->equal(FRAME_REJECT_TRUNCATED);
+}
+
+void test_decodeFrame_fourAddresses() {
+  FrameDescriptor descriptor;
+  u_char          frame[40] = {0x08, WIFI_FC_TO_DS | WIFI_FC_FROM_DS};
+
+  // addr4 is 02:00:00:00:00:04.
+  frame[24] = 0x02;
+  frame[29] = 0x04;
+
+  decodeFrame(frame, sizeof(frame), &descriptor);
+
+  int hasAddress4 = descriptor.address4 == 0x020000000004ULL && descriptor.bssid == 0;
+  expect(&hasAddress4)->to->equal(1);
+}
+
+void test_decodeFrame_rejectsOtherTypes() {
+  FrameDescriptor descriptor;
+  u_char          ack[40] = {0xd4};
+  u_char          beacon[40] = {0x80};
+
+  int status = decodeFrame(ack, sizeof(ack), &descriptor);
+  expect(&status)->to->equal(FRAME_REJECT_TYPE);
+
+  status = decodeFrame(beacon, sizeof(beacon), &descriptor);
+  expect(&status)->to->equal(FRAME_REJECT_TYPE);
+}
+
+void addHeaderParserTests() {
+  describe("Header Parser Tests");
+    describe("parseRadioTap()");
+      beforeEach(beforeEach_parseRadioTap);
+
+      test("should align each field to its natural boundary", test_parseRadioTap_alignsFields);
+      test("should find the field data after extended present bitmaps", test_parseRadioTap_extendedBitmaps);
+      test("should skip the data of vendor namespaces", test_nextRadioTapField_skipsVendorNamespace);
+      test("should reject a header longer than the captured frame", test_parseRadioTap_truncated);
+    endDescribe();
+
+    describe("decodeFrame()");
+      test("should find the BSSID and the QoS and HT control fields of a frame to the DS", test_decodeFrame_qosToDistribution);
+      test("should skip the IV of a protected frame", test_decodeFrame_protectedPayload);
+      test("should record the fourth address of a frame between access points", test_decodeFrame_fourAddresses);
+      test("should reject control and management frames", test_decodeFrame_rejectsOtherTypes);
+    endDescribe();
+  endDescribe();
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "Log.h"
+
+char  logOutput[8192];
+FILE *logCapture;
+int   savedStderr;
+
+/**
+ * Sends everything written to stderr to a temporary file until releaseStderr() is called.
+ */
+void captureStderr() {
+  fflush(stderr);
+  logCapture = tmpfile();
+  savedStderr = dup(STDERR_FILENO);
+  dup2(fileno(logCapture), STDERR_FILENO);
+}
+
+/**
+ * Restores stderr and copies what was written to it into logOutput.
+ *
+ * @return (int) the number of lines written
+ */
+int releaseStderr() {
+  size_t length;
+  char  *line;
+  int    lines = 0;
+
+  fflush(stderr);
+  dup2(savedStderr, STDERR_FILENO);
+  close(savedStderr);
+
+  rewind(logCapture);
+  length = fread(logOutput, 1, sizeof(logOutput) - 1, logCapture);
+  logOutput[length] = '\0';
+  fclose(logCapture);
+
+  for(line = strchr(logOutput, '\n'); line; line = strchr(line + 1, '\n')) {
+    lines++;
+  }
+
+  return lines;
+}
+
+/**
+ * Returns the second of the clock the rate limit counts in.
+ */
+time_t logSecond() {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+  return now.tv_sec;
+}
+
+void beforeEach_log() {
+  resetMemoryTracking();
+}
+
+void afterEach_log() {
+  stopLogging();
+}
+
+void test_logMessage_limitsEachSite() {
+  LogSite site;
+  LogSite otherSite = {NETFREE_LOG_INFO, 0, 0, 0};
+  time_t  second;
+  int     lines;
+  int     message;
+
+  // The limit applies per second, so retry if the messages straddled two.
+  do {
+    site = (LogSite) {NETFREE_LOG_INFO, 0, 0, 0};
+    second = logSecond();
+
+    captureStderr();
+    for(message = 0; message < NETFREE_LOG_SITE_RATE + 5; message++) {
+      logMessage(&site, "message %d", message);
+    }
+
+    // Another site has a limit of its own.
+    logMessage(&otherSite, "other site");
+    lines = releaseStderr();
+  } while(logSecond() != second);
+
+  expect(&lines)->to->equal(NETFREE_LOG_SITE_RATE + 1);
+
+  int suppressed = site.suppressed;
+  expect(&suppressed)->to->equal(5);
+
+  // The next message the site logs reports what it suppressed.
+  site.window = 0;
+  captureStderr();
+  logMessage(&site, "after the limit");
+  releaseStderr();
+
+  expect(logOutput)->to->equalStr("after the limit (5 similar messages suppressed)\n");
+
+  suppressed = site.suppressed;
+  expect(&suppressed)->to->equal(0);
+}
+
+void test_logMessage_writesThroughLoggingThread() {
+  LogSite site = {NETFREE_LOG_INFO, 0, 0, 0};
+
+  captureStderr();
+  startLogging();
+  logMessage(&site, "queued %d", 1);
+
+  // Stopping writes what is waiting and frees the ring.
+  stopLogging();
+  releaseStderr();
+
+  expect(logOutput)->to->equalStr("queued 1\n");
+
+  int totalMemoryLeaked = totalUnfreedMemory();
+  expect(&totalMemoryLeaked)->to->equal(0);
+}
+
+void test_logMessage_writesDirectlyAfterStop() {
+  LogSite site = {NETFREE_LOG_INFO, 0, 0, 0};
+
+  startLogging();
+  stopLogging();
+
+  // No logging thread is left to write the message, so it must be written right away.
+  captureStderr();
+  logMessage(&site, "direct %s", "write");
+  releaseStderr();
+
+  expect(logOutput)->to->equalStr("direct write\n");
+}
+
+void addLogTests() {
+  describe("Log Tests");
+    beforeEach(beforeEach_log);
+    afterEach(afterEach_log);
+
+    describe("logMessage()");
+      test("should suppress the messages of a site past its rate and report how many", test_logMessage_limitsEachSite);
+      test("should hand messages to the logging thread while logging is started", test_logMessage_writesThroughLoggingThread);
+      test("should write messages directly once logging is stopped", test_logMessage_writesDirectlyAfterStop);
+    endDescribe();
+  endDescribe();
+}
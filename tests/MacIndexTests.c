@@ -0,0 +1,157 @@
+#include <stdint.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "MacIndex.h"
+
+#define TEST_INDEX_SIZE   16
+#define CLUSTER_KEYS      8
+
+MacIndex testIndex;
+uint64_t clusterKeys[CLUSTER_KEYS];
+
+/**
+ * Finds the first key, after the one given, whose home slot in an index of TEST_INDEX_SIZE
+ * slots is home.
+ */
+uint64_t keyWithHome(unsigned int home, uint64_t after) {
+  uint64_t key;
+
+  for(key = after + 1; STATION_HASH(STATION_KEY(key), TEST_INDEX_SIZE) != home; key++);
+
+  return key;
+}
+
+/**
+ * Fills clusterKeys with keys whose home slots (14, 14, 14, 15, 15, 0, 0 and 1) form a single
+ * probe run that wraps past the end of the table, from slot 14 through slot 5.
+ */
+void buildWrappingCluster() {
+  unsigned int homes[CLUSTER_KEYS] = {14, 14, 14, 15, 15, 0, 0, 1};
+  uint64_t     key = 0;
+  int          keyIndex;
+
+  for(keyIndex = 0; keyIndex < CLUSTER_KEYS; keyIndex++) {
+    key = keyWithHome(homes[keyIndex], key);
+    clusterKeys[keyIndex] = STATION_KEY(key);
+  }
+}
+
+void beforeEach_macIndex() {
+  resetMemoryTracking();
+  initMacIndex(&testIndex, TEST_INDEX_SIZE);
+}
+
+void afterEach_macIndex() {
+  destroyMacIndex(&testIndex);
+}
+
+void test_macIndexRemove_shiftsWrappedCluster() {
+  int victim;
+  int keyIndex;
+  int misplaced = 0;
+
+  buildWrappingCluster();
+
+  // Remove every key of the cluster in turn, from a fully built cluster each time.
+  for(victim = 0; victim < CLUSTER_KEYS; victim++) {
+    for(keyIndex = 0; keyIndex < CLUSTER_KEYS; keyIndex++) {
+      macIndexInsert(&testIndex, clusterKeys[keyIndex], &clusterKeys[keyIndex]);
+    }
+
+    macIndexRemove(&testIndex, clusterKeys[victim]);
+
+    for(keyIndex = 0; keyIndex < CLUSTER_KEYS; keyIndex++) {
+      void *expected = (keyIndex == victim) ? NULL : &clusterKeys[keyIndex];
+      misplaced += macIndexFind(&testIndex, clusterKeys[keyIndex]) != expected;
+    }
+
+    misplaced += testIndex.length != CLUSTER_KEYS - 1;
+
+    for(keyIndex = 0; keyIndex < CLUSTER_KEYS; keyIndex++) {
+      macIndexRemove(&testIndex, clusterKeys[keyIndex]);
+    }
+  }
+
+  expect(&misplaced)->to->equal(0);
+
+  int length = testIndex.length;
+  expect(&length)->to->equal(0);
+}
+
+void test_macIndexInsert_grows() {
+  uint64_t keys[100];
+  int      keyIndex;
+  int      missing = 0;
+
+  for(keyIndex = 0; keyIndex < 100; keyIndex++) {
+    keys[keyIndex] = STATION_KEY(0x020000000000ULL | keyIndex);
+    macIndexInsert(&testIndex, keys[keyIndex], &keys[keyIndex]);
+  }
+
+  // Storing a key again replaces its value.
+  macIndexInsert(&testIndex, keys[0], &keys[1]);
+
+  int length = testIndex.length;
+  expect(&length)->to->equal(100);
+
+  // Growth keeps the table below three quarters full.
+  int capacity = testIndex.capacity;
+  expect(&capacity)->to->equal(256);
+
+  for(keyIndex = 1; keyIndex < 100; keyIndex++) {
+    missing += macIndexFind(&testIndex, keys[keyIndex]) != &keys[keyIndex];
+  }
+
+  expect(&missing)->to->equal(0);
+
+  bool replaced = macIndexFind(&testIndex, keys[0]) == &keys[1];
+  expect(&replaced)->toBe->True();
+}
+
+void test_initMacIndex_roundsCapacity() {
+  uint64_t keys[9];
+  int      keyIndex;
+  int      missing = 0;
+
+  // A power of 2 is kept as it is.
+  int capacity = testIndex.capacity;
+  expect(&capacity)->to->equal(TEST_INDEX_SIZE);
+
+  // As sized from NETFREE_MAX_PARTITIONS * 2 when the limit is not a power of 2.
+  destroyMacIndex(&testIndex);
+  initMacIndex(&testIndex, 12);
+  capacity = testIndex.capacity;
+  expect(&capacity)->to->equal(16);
+
+  // Every slot is reachable through the probe mask.
+  for(keyIndex = 0; keyIndex < 9; keyIndex++) {
+    keys[keyIndex] = STATION_KEY(0x020000000000ULL | keyIndex);
+    macIndexInsert(&testIndex, keys[keyIndex], &keys[keyIndex]);
+  }
+
+  for(keyIndex = 0; keyIndex < 9; keyIndex++) {
+    missing += macIndexFind(&testIndex, keys[keyIndex]) != &keys[keyIndex];
+  }
+
+  expect(&missing)->to->equal(0);
+}
+
+void addMacIndexTests() {
+  describe("MAC Index Tests");
+    beforeEach(beforeEach_macIndex);
+    afterEach(afterEach_macIndex);
+
+    describe("initMacIndex()");
+      test("should round the capacity up to a power of 2", test_initMacIndex_roundsCapacity);
+    endDescribe();
+
+    describe("macIndexRemove()");
+      test("should keep every key reachable when removing from a run that wraps around", test_macIndexRemove_shiftsWrappedCluster);
+    endDescribe();
+
+    describe("macIndexInsert()");
+      test("should grow the index and keep every key", test_macIndexInsert_grows);
+    endDescribe();
+  endDescribe();
+}
@@ -0,0 +1,117 @@
+#include <fcntl.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "MacQueue.h"
+#include "MacQueueEvents.h"
+
+#define FIRST_MAC_ADDRESS   0x001122334401ULL
+#define SECOND_MAC_ADDRESS  0x001122334402ULL
+#define THIRD_MAC_ADDRESS   0x001122334403ULL
+#define FOURTH_MAC_ADDRESS  0x001122334404ULL
+
+void beforeEach_macQueueEvents() {
+  resetMemoryTracking();
+  initMacQueue();
+}
+
+void afterEach_macQueueEvents() {
+  destroyMacQueue();
+}
+
+void test_subscribeMacQueue_rearmsBelowThreshold() {
+  int descriptor = subscribeMacQueue(MAC_QUEUE_EVENT_LENGTH, 2);
+
+  enqueueMac(FIRST_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+  enqueueMac(SECOND_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+  int events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(1);
+
+  // Growing further does not fire again.
+  enqueueMac(THIRD_MAC_ADDRESS, 3 * NETFREE_NS_PER_SECOND);
+  events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(0);
+
+  dequeueMac(NULL);
+  dequeueMac(NULL);
+  events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(0);
+
+  // Having dropped below the threshold, reaching it again fires.
+  enqueueMac(FOURTH_MAC_ADDRESS, 4 * NETFREE_NS_PER_SECOND);
+  events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(1);
+
+  unsubscribeMacQueue(descriptor);
+}
+
+void test_notifyMacQueue_countsEvictions() {
+  int descriptor = subscribeMacQueue(MAC_QUEUE_EVENT_EVICTED, 0);
+  int lengthDescriptor = subscribeMacQueue(MAC_QUEUE_EVENT_LENGTH, 100);
+
+  notifyMacQueue(MAC_QUEUE_NEXT_GENERATION(), 10, 0, 3);
+  notifyMacQueue(MAC_QUEUE_NEXT_GENERATION(), 10, 0, 0);
+
+  // Evictions count even when reported late.
+  uint64_t older = MAC_QUEUE_NEXT_GENERATION();
+  notifyMacQueue(MAC_QUEUE_NEXT_GENERATION(), 10, 0, 1);
+  notifyMacQueue(older, 10, 0, 2);
+
+  int events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(6);
+
+  // Only the subscriptions to MAC_QUEUE_EVENT_EVICTED hear of them.
+  events = waitMacQueueEvent(lengthDescriptor, 0);
+  expect(&events)->to->equal(0);
+
+  unsubscribeMacQueue(descriptor);
+  unsubscribeMacQueue(lengthDescriptor);
+}
+
+void test_unsubscribeMacQueue_releasesSubscription() {
+  int descriptors[NETFREE_MAC_QUEUE_SUBSCRIBERS];
+  int subscriber;
+
+  for(subscriber = 0; subscriber < NETFREE_MAC_QUEUE_SUBSCRIBERS; subscriber++) {
+    descriptors[subscriber] = subscribeMacQueue(MAC_QUEUE_EVENT_TOP, 0);
+  }
+
+  int descriptor = subscribeMacQueue(MAC_QUEUE_EVENT_EVICTED, 0);
+  expect(&descriptor)->to->equal(-1);
+
+  unsubscribeMacQueue(descriptors[0]);
+  bool closed = fcntl(descriptors[0], F_GETFD) == -1;
+  expect(&closed)->toBe->True();
+
+  // The freed slot can be subscribed again.
+  descriptors[0] = subscribeMacQueue(MAC_QUEUE_EVENT_EVICTED, 0);
+  bool subscribed = descriptors[0] != -1;
+  expect(&subscribed)->toBe->True();
+
+  for(subscriber = 0; subscriber < NETFREE_MAC_QUEUE_SUBSCRIBERS; subscriber++) {
+    unsubscribeMacQueue(descriptors[subscriber]);
+  }
+
+  // Once nobody subscribes, the queues stop reporting.
+  int watched = MAC_QUEUE_WATCHED(MAC_QUEUE_EVENT_LENGTH | MAC_QUEUE_EVENT_TOP | MAC_QUEUE_EVENT_EVICTED);
+  expect(&watched)->to->equal(0);
+}
+
+void addMacQueueEventsTests() {
+  describe("MAC Queue Events Tests");
+    beforeEach(beforeEach_macQueueEvents);
+    afterEach(afterEach_macQueueEvents);
+
+    describe("subscribeMacQueue()");
+      test("should signal again once the queue has dropped below the threshold", test_subscribeMacQueue_rearmsBelowThreshold);
+    endDescribe();
+
+    describe("notifyMacQueue()");
+      test("should add every evicted station, including those of stale reports", test_notifyMacQueue_countsEvictions);
+    endDescribe();
+
+    describe("unsubscribeMacQueue()");
+      test("should close the eventfd and free the subscription", test_unsubscribeMacQueue_releasesSubscription);
+    endDescribe();
+  endDescribe();
+}
@@ -126,6 +126,30 @@ void *__wrap_calloc(size_t nitems, size_t size) {
   return tempPtr;
 }
 
+/**
+ * A wrapper for aligned_alloc() that allows the testing suite to track memory leaks.  The
+ * params and return value mirror that of the real aligned_alloc() function.
+ */
+void *__wrap_aligned_alloc(size_t alignment, size_t bytes) {
+  void *tempPtr = __real_aligned_alloc(alignment, bytes);
+
+  if(tempPtr == NULL) {
+    return NULL;
+  }
+
+  unfreedMemory += bytes;
+
+  MemoryRef *newRef = (MemoryRef *) __real_malloc(sizeof(MemoryRef));
+  *newRef = (MemoryRef) {
+    .ptr    = tempPtr,
+    .bytes  = bytes
+  };
+
+  addMemoryRef(newRef);
+
+  return tempPtr;
+}
+
 /**
  * A wrapper for realloc() that allows the testing suite to track memory leaks.  The params
  * and return value mirror that of the real realloc() function.
@@ -154,7 +178,14 @@ void *__wrap_realloc(void *oldPtr, size_t bytes) {
  * return value mirror that of the real free() function.
  */
 void __wrap_free(void *ptr) {
-  MemoryRef *oldRef = getMemoryRef(ptr);
+  MemoryRef *oldRef;
+
+  // Like the real free(), freeing NULL does nothing.
+  if(ptr == NULL) {
+    return;
+  }
+
+  oldRef = getMemoryRef(ptr);
 
   if(oldRef == NULL) {
     fprintf(stderr, "Could not find memory location to free.  Calling free anyways.\n");
@@ -0,0 +1,58 @@
+#include <string.h>
+
+#include "TestSuite.h"
+#include "Mocks.h"
+
+/**
+ * Makes the wrapper of a function call mock instead of the real function until resetMocks()
+ * is called.
+ *
+ * @param name (char *) - the name of the wrapped function
+ * @param mock (void *) - the function to call instead, with the same signature
+ */
+void mockFunction(char *name, void *mock) {
+  MockedFunction *mocked = (MockedFunction *) __real_calloc(1, sizeof(MockedFunction));
+
+  mocked->name = name;
+  mocked->mock = mock;
+  mocked->next = mockedFunctions;
+  mockedFunctions = mocked;
+}
+
+/**
+ * Removes every mock, so the wrapped functions call the real functions again.
+ */
+void resetMocks() {
+  MockedFunction *next;
+
+  while(mockedFunctions) {
+    next = mockedFunctions->next;
+    __real_free(mockedFunctions);
+    mockedFunctions = next;
+  }
+}
+
+/**
+ * Finds the mock most recently registered for a function.
+ *
+ * @param name (char *) - the name of the wrapped function
+ *
+ * @return (void *) the mock, or NULL if the function is not mocked
+ */
+void *findMock(char *name) {
+  MockedFunction *mocked;
+
+  for(mocked = mockedFunctions; mocked; mocked = mocked->next) {
+    if(!strcmp(mocked->name, name)) {
+      return mocked->mock;
+    }
+  }
+
+  return NULL;
+}
+
+int __wrap_macEquals(char *leftOperand, char *rightOperand) {
+  int (*mock)(char *, char *) = (int (*)(char *, char *)) findMock("macEquals");
+
+  return mock ? mock(leftOperand, rightOperand) : __real_macEquals(leftOperand, rightOperand);
+}
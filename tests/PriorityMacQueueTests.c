@@ -0,0 +1,249 @@
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "PriorityMacQueue.h"
+#include "MacQueueEvents.h"
+#include "Snapshot.h"
+
+#define FIRST_MAC_ADDRESS   0x001122334401ULL
+#define SECOND_MAC_ADDRESS  0x001122334402ULL
+#define THIRD_MAC_ADDRESS   0x001122334403ULL
+#define FIRST_BSSID         0x00aabbccdd01ULL
+#define SECOND_BSSID        0x00aabbccdd02ULL
+#define SNAPSHOT_TEST_PATH  "/tmp/netfree_test.snapshot"
+
+/**
+ * Expects a MAC address to be the test station whose last octet is given.
+ */
+void expectStation(MacAddress macAddress, int lastOctet) {
+  int octet = macAddress & 0xff;
+  expect(&octet)->to->equal(lastOctet);
+}
+
+void beforeEach_priorityMacQueue() {
+  resetMemoryTracking();
+  initMacQueue();
+}
+
+void afterEach_priorityMacQueue() {
+  destroyMacQueue();
+}
+
+void test_dequeueMac_highestPriorityFirst() {
+  MacAddress macAddress;
+
+  enqueueMac(FIRST_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+  enqueueMac(SECOND_MAC_ADDRESS, 3 * NETFREE_NS_PER_SECOND);
+  enqueueMac(THIRD_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+
+  dequeueMac(&macAddress);
+  expectStation(macAddress, 2);
+
+  dequeueMac(&macAddress);
+  expectStation(macAddress, 3);
+
+  dequeueMac(&macAddress);
+  expectStation(macAddress, 1);
+}
+
+void test_enqueueMac_raisesExistingStation() {
+  MacAddress macAddress;
+
+  enqueueMac(FIRST_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+  enqueueMac(SECOND_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+  enqueueMac(FIRST_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+
+  int queueLength = macQueueLength();
+  expect(&queueLength)->to->equal(2);
+
+  macQueuePeek(&macAddress);
+  expectStation(macAddress, 1);
+}
+
+void test_dequeueMac_shrinksQueue() {
+  enqueueMac(FIRST_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+  enqueueMac(SECOND_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+  dequeueMac(NULL);
+
+  int queueLength = macQueueLength();
+  expect(&queueLength)->to->equal(1);
+
+  dequeueMac(NULL);
+
+  MacAddress macAddress;
+  bool empty = (macQueuePeek(&macAddress) == NULL);
+  expect(&empty)->toBe->True();
+}
+
+void test_subscribeMacQueue_firesWhenLengthReached() {
+  int descriptor = subscribeMacQueue(MAC_QUEUE_EVENT_LENGTH, 2);
+
+  enqueueMac(FIRST_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+  int events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(0);
+
+  enqueueMac(SECOND_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+  events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(1);
+
+  unsubscribeMacQueue(descriptor);
+}
+
+void test_subscribeMacQueue_firesWhenTopChanges() {
+  enqueueMac(FIRST_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+
+  int descriptor = subscribeMacQueue(MAC_QUEUE_EVENT_TOP, 0);
+
+  enqueueMac(FIRST_MAC_ADDRESS, 2 * NETFREE_NS_PER_SECOND);
+  int events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(0);
+
+  enqueueMac(SECOND_MAC_ADDRESS, 9 * NETFREE_NS_PER_SECOND);
+  events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(1);
+
+  unsubscribeMacQueue(descriptor);
+}
+
+void test_dequeueMacFromPartition_onlyThatNetwork() {
+  MacRecord records[3] = {
+    {FIRST_MAC_ADDRESS, FIRST_BSSID, 1, 1 * NETFREE_NS_PER_SECOND},
+    {SECOND_MAC_ADDRESS, SECOND_BSSID, 1, 3 * NETFREE_NS_PER_SECOND},
+    {THIRD_MAC_ADDRESS, FIRST_BSSID, 1, 2 * NETFREE_NS_PER_SECOND}
+  };
+  MacAddress macAddress;
+
+  enqueueMacBatch(records, 3);
+
+  int partitionLength = macQueuePartitionLength(FIRST_BSSID);
+  expect(&partitionLength)->to->equal(2);
+
+  dequeueMacFromPartition(FIRST_BSSID, &macAddress);
+  expectStation(macAddress, 3);
+
+  macQueuePeek(&macAddress);
+  expectStation(macAddress, 2);
+}
+
+void test_enqueueMacBatch_movesStationToNewNetwork() {
+  MacRecord records[2] = {
+    {FIRST_MAC_ADDRESS, FIRST_BSSID, 1, 1 * NETFREE_NS_PER_SECOND},
+    {FIRST_MAC_ADDRESS, SECOND_BSSID, 1, 2 * NETFREE_NS_PER_SECOND}
+  };
+
+  enqueueMacBatch(records, 2);
+
+  int partitionLength = macQueuePartitionLength(FIRST_BSSID);
+  expect(&partitionLength)->to->equal(0);
+
+  partitionLength = macQueuePartitionLength(SECOND_BSSID);
+  expect(&partitionLength)->to->equal(1);
+}
+
+void test_loadSnapshot_clampsTimesBeforeBoot() {
+  SnapshotHeader header = {NETFREE_SNAPSHOT_MAGIC, NETFREE_SNAPSHOT_VERSION, sizeof(StationState), 1, 0};
+  StationState   state = {FIRST_MAC_ADDRESS, 10, 0, 0, 10, FIRST_BSSID};
+  MacAddress     macAddress;
+  FILE          *file;
+
+  // Heard in 1970, long before the monotonic clock started.
+  state.lastReceived = 1;
+
+  file = fopen(SNAPSHOT_TEST_PATH, "wb");
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(&state, sizeof(state), 1, file);
+  fclose(file);
+
+  int restored = loadSnapshot(SNAPSHOT_TEST_PATH);
+  unlink(SNAPSHOT_TEST_PATH);
+  expect(&restored)->to->equal(1);
+
+  exportMacQueue(&state, 1);
+  bool clamped = state.lastReceived == 0;
+  expect(&clamped)->toBe->True();
+
+  // A live station with fewer packets still ranks below the restored one.
+  enqueueMac(SECOND_MAC_ADDRESS, 5 * NETFREE_NS_PER_SECOND);
+  macQueuePeek(&macAddress);
+  expectStation(macAddress, 1);
+}
+
+void test_notifyMacQueue_ignoresStaleReports() {
+  int      descriptor = subscribeMacQueue(MAC_QUEUE_EVENT_LENGTH, 2);
+  uint64_t older = MAC_QUEUE_NEXT_GENERATION();
+  uint64_t newer = MAC_QUEUE_NEXT_GENERATION();
+  uint64_t newest = MAC_QUEUE_NEXT_GENERATION();
+
+  notifyMacQueue(newer, 2, 0, 0);
+  int events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(1);
+
+  // A report from before the queue grew must not re-arm the subscription.
+  notifyMacQueue(older, 0, 0, 0);
+  notifyMacQueue(newest, 2, 0, 0);
+  events = waitMacQueueEvent(descriptor, 0);
+  expect(&events)->to->equal(0);
+
+  unsubscribeMacQueue(descriptor);
+}
+
+void test_destroyMacQueue_releasesMemory() {
+  MacRecord records[3] = {
+    {FIRST_MAC_ADDRESS, FIRST_BSSID, 1, 1 * NETFREE_NS_PER_SECOND},
+    {SECOND_MAC_ADDRESS, SECOND_BSSID, 1, 3 * NETFREE_NS_PER_SECOND},
+    {THIRD_MAC_ADDRESS, 0, 1, 2 * NETFREE_NS_PER_SECOND}
+  };
+
+  enqueueMacBatch(records, 3);
+  destroyMacQueue();
+
+  int totalMemoryLeaked = totalUnfreedMemory();
+  expect(&totalMemoryLeaked)->to->equal(0);
+
+  // afterEach() destroys the queue again.
+  initMacQueue();
+}
+
+void addPriorityMacQueueTests() {
+  describe("Priority MAC Queue Tests");
+    beforeEach(beforeEach_priorityMacQueue);
+    afterEach(afterEach_priorityMacQueue);
+
+    describe("dequeueMac()");
+      test("should return MAC addresses in order of priority", test_dequeueMac_highestPriorityFirst);
+      test("should remove the MAC address from the queue", test_dequeueMac_shrinksQueue);
+    endDescribe();
+
+    describe("enqueueMac()");
+      test("should move a MAC address up when its priority increases", test_enqueueMac_raisesExistingStation);
+    endDescribe();
+
+    describe("enqueueMacBatch()");
+      test("should move a station to the network it was last heard in", test_enqueueMacBatch_movesStationToNewNetwork);
+    endDescribe();
+
+    describe("dequeueMacFromPartition()");
+      test("should only return stations of the requested network", test_dequeueMacFromPartition_onlyThatNetwork);
+    endDescribe();
+
+    describe("destroyMacQueue()");
+      test("should free all of the memory the queue allocated", test_destroyMacQueue_releasesMemory);
+    endDescribe();
+
+    describe("loadSnapshot()");
+      test("should restore stations heard before the clock started at time 0", test_loadSnapshot_clampsTimesBeforeBoot);
+    endDescribe();
+
+    describe("subscribeMacQueue()");
+      test("should signal once the queue holds the requested number of stations", test_subscribeMacQueue_firesWhenLengthReached);
+      test("should signal when a different station moves to the top", test_subscribeMacQueue_firesWhenTopChanges);
+    endDescribe();
+
+    describe("notifyMacQueue()");
+      test("should ignore the length of a report older than one delivered", test_notifyMacQueue_ignoresStaleReports);
+    endDescribe();
+  endDescribe();
+}
@@ -0,0 +1,248 @@
+#include <string.h>
+#include <stdio.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "SpaceSavingMacQueue.h"
+
+#define FIRST_MAC_ADDRESS   0x001122334401ULL
+#define SECOND_MAC_ADDRESS  0x001122334402ULL
+#define THIRD_MAC_ADDRESS   0x001122334403ULL
+#define NEW_MAC_ADDRESS     0x0011223344ffULL
+#define FIRST_BSSID         0x00aabbccdd01ULL
+#define SECOND_BSSID        0x00aabbccdd02ULL
+#define STREAM_STATIONS     (NETFREE_SPACE_SAVING_SIZE * 4)
+#define STREAM_PACKETS      (NETFREE_SPACE_SAVING_SIZE * 64)
+
+StationEstimate estimates[NETFREE_SPACE_SAVING_SIZE];
+uint32_t        trueCounts[STREAM_STATIONS];
+
+/**
+ * Finds the estimate of a station among those reported by spaceSavingTopK().
+ *
+ * @param macAddress (MacAddress) - the station
+ *
+ * @return (StationEstimate *) the estimate, or NULL if the station is not tracked
+ */
+StationEstimate *findEstimate(MacAddress macAddress) {
+  int estimateCount = spaceSavingTopK(estimates, NETFREE_SPACE_SAVING_SIZE);
+  int estimateIndex;
+
+  for(estimateIndex = 0; estimateIndex < estimateCount; estimateIndex++) {
+    if(estimates[estimateIndex].macAddress == macAddress) {
+      return &estimates[estimateIndex];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Fills every counter with a station that sent the given number of packets.
+ */
+void fillCounters(uint32_t packets) {
+  MacRecord record = {0, 0, packets, 0};
+  int       station;
+
+  for(station = 0; station < NETFREE_SPACE_SAVING_SIZE; station++) {
+    record.macAddress = 0x020000000000ULL | station;
+    record.timestamp = (station + 1) * NETFREE_NS_PER_SECOND;
+    enqueueMacBatch(&record, 1);
+  }
+}
+
+void beforeEach_spaceSavingMacQueue() {
+  resetMemoryTracking();
+  initMacQueue();
+}
+
+void afterEach_spaceSavingMacQueue() {
+  destroyMacQueue();
+}
+
+void test_enqueueMac_evictsSmallestCounter() {
+  fillCounters(3);
+
+  // The station heard first has the smallest count and the oldest packet.
+  enqueueMac(NEW_MAC_ADDRESS, (NETFREE_SPACE_SAVING_SIZE + 1) * NETFREE_NS_PER_SECOND);
+
+  int queueLength = macQueueLength();
+  expect(&queueLength)->to->equal(NETFREE_SPACE_SAVING_SIZE);
+
+  bool evicted = findEstimate(0x020000000000ULL) == NULL;
+  expect(&evicted)->toBe->True();
+
+  StationEstimate *estimate = findEstimate(NEW_MAC_ADDRESS);
+  bool tracked = estimate != NULL;
+  expect(&tracked)->toBe->True();
+
+  int count = estimate->count;
+  expect(&count)->to->equal(4);
+
+  int error = estimate->error;
+  expect(&error)->to->equal(3);
+}
+
+void test_enqueueMacBatch_boundsTrueCount() {
+  MacRecord    record = {0, 0, 1, 0};
+  unsigned int seed = 1;
+  int          packet;
+  int          station;
+  int          estimateCount;
+  int          estimateIndex;
+  int          outOfBounds = 0;
+
+  memset(trueCounts, 0, sizeof(trueCounts));
+
+  // A skewed stream: each packet picks the lower of two random stations.
+  for(packet = 0; packet < STREAM_PACKETS; packet++) {
+    station = rand_r(&seed) % STREAM_STATIONS;
+    if((int) (rand_r(&seed) % STREAM_STATIONS) < station) {
+      station = rand_r(&seed) % (station + 1);
+    }
+
+    record.macAddress = 0x020000000000ULL | station;
+    record.timestamp = (packet + 1) * NETFREE_NS_PER_SECOND;
+    enqueueMacBatch(&record, 1);
+    trueCounts[station]++;
+  }
+
+  estimateCount = spaceSavingTopK(estimates, NETFREE_SPACE_SAVING_SIZE);
+  expect(&estimateCount)->to->equal(NETFREE_SPACE_SAVING_SIZE);
+
+  for(estimateIndex = 0; estimateIndex < estimateCount; estimateIndex++) {
+    station = estimates[estimateIndex].macAddress & 0xffff;
+    if(estimates[estimateIndex].count - estimates[estimateIndex].error > trueCounts[station] ||
+       estimates[estimateIndex].count < trueCounts[station]) {
+      outOfBounds++;
+    }
+  }
+
+  expect(&outOfBounds)->to->equal(0);
+}
+
+void test_spaceSavingTopK_largestFirst() {
+  MacRecord records[3] = {
+    {FIRST_MAC_ADDRESS, 0, 2, 1 * NETFREE_NS_PER_SECOND},
+    {SECOND_MAC_ADDRESS, 0, 7, 2 * NETFREE_NS_PER_SECOND},
+    {THIRD_MAC_ADDRESS, 0, 4, 3 * NETFREE_NS_PER_SECOND}
+  };
+
+  enqueueMacBatch(records, 3);
+
+  int estimateCount = spaceSavingTopK(estimates, 2);
+  expect(&estimateCount)->to->equal(2);
+
+  bool largestFirst = estimates[0].macAddress == SECOND_MAC_ADDRESS && estimates[1].macAddress == THIRD_MAC_ADDRESS;
+  expect(&largestFirst)->toBe->True();
+}
+
+void test_importMacQueue_carriesErrorOver() {
+  StationState states[2] = {
+    {FIRST_MAC_ADDRESS, 10, 4, 1 * NETFREE_NS_PER_SECOND, 10, FIRST_BSSID},
+    {SECOND_MAC_ADDRESS, 6, 2, 2 * NETFREE_NS_PER_SECOND, 6, FIRST_BSSID}
+  };
+
+  enqueueMac(SECOND_MAC_ADDRESS, 1 * NETFREE_NS_PER_SECOND);
+  importMacQueue(states, 2);
+
+  StationEstimate *estimate = findEstimate(FIRST_MAC_ADDRESS);
+  int count = estimate->count;
+  int error = estimate->error;
+  expect(&count)->to->equal(10);
+  expect(&error)->to->equal(4);
+
+  // A station already tracked adds the imported packets and error to its own.
+  estimate = findEstimate(SECOND_MAC_ADDRESS);
+  count = estimate->count;
+  error = estimate->error;
+  expect(&count)->to->equal(7);
+  expect(&error)->to->equal(2);
+}
+
+void test_dequeueMacFromPartition_onlyThatNetwork() {
+  MacRecord records[3] = {
+    {FIRST_MAC_ADDRESS, FIRST_BSSID, 2, 1 * NETFREE_NS_PER_SECOND},
+    {SECOND_MAC_ADDRESS, SECOND_BSSID, 9, 2 * NETFREE_NS_PER_SECOND},
+    {THIRD_MAC_ADDRESS, FIRST_BSSID, 5, 3 * NETFREE_NS_PER_SECOND}
+  };
+  MacAddress macAddress;
+
+  enqueueMacBatch(records, 3);
+
+  dequeueMacFromPartition(FIRST_BSSID, &macAddress);
+  bool largestOfNetwork = macAddress == THIRD_MAC_ADDRESS;
+  expect(&largestOfNetwork)->toBe->True();
+
+  int partitionLength = macQueuePartitionLength(FIRST_BSSID);
+  expect(&partitionLength)->to->equal(1);
+
+  partitionLength = macQueuePartitionLength(SECOND_BSSID);
+  expect(&partitionLength)->to->equal(1);
+
+  dequeueMacFromPartition(FIRST_BSSID, &macAddress);
+  bool lastOfNetwork = macAddress == FIRST_MAC_ADDRESS;
+  expect(&lastOfNetwork)->toBe->True();
+
+  bool empty = dequeueMacFromPartition(FIRST_BSSID, &macAddress) == NULL;
+  expect(&empty)->toBe->True();
+
+  macQueuePeek(&macAddress);
+  bool otherNetworkKept = macAddress == SECOND_MAC_ADDRESS;
+  expect(&otherNetworkKept)->toBe->True();
+}
+
+void test_enqueueMacBatch_sharesPartitionPastLimit() {
+  MacRecord    record = {0, 0, 1, 0};
+  StationState states[2];
+  int          bssid;
+
+  // Partition 0 is taken by the stations heard without a BSSID.
+  for(bssid = 1; bssid <= NETFREE_MAX_PARTITIONS; bssid++) {
+    record.macAddress = 0x020000000000ULL | bssid;
+    record.bssid = 0x0a0000000000ULL | bssid;
+    enqueueMacBatch(&record, 1);
+  }
+
+  int partitionLength = macQueuePartitionLength(0);
+  expect(&partitionLength)->to->equal(1);
+
+  // Hearing the station again with its BSSID leaves it where it is.
+  enqueueMacBatch(&record, 1);
+  partitionLength = macQueuePartitionLength(0);
+  expect(&partitionLength)->to->equal(1);
+
+  int exported = exportMacQueuePartition(0, states, 2);
+  expect(&exported)->to->equal(1);
+
+  bool overflowStation = states[0].macAddress == record.macAddress;
+  expect(&overflowStation)->toBe->True();
+}
+
+void addSpaceSavingMacQueueTests() {
+  describe("Space-Saving MAC Queue Tests");
+    beforeEach(beforeEach_spaceSavingMacQueue);
+    afterEach(afterEach_spaceSavingMacQueue);
+
+    describe("enqueueMac()");
+      test("should evict the smallest counter and take its count as the error", test_enqueueMac_evictsSmallestCounter);
+    endDescribe();
+
+    describe("enqueueMacBatch()");
+      test("should keep every true count between count - error and count", test_enqueueMacBatch_boundsTrueCount);
+      test("should share partition 0 between the BSSIDs past NETFREE_MAX_PARTITIONS", test_enqueueMacBatch_sharesPartitionPastLimit);
+    endDescribe();
+
+    describe("spaceSavingTopK()");
+      test("should report the largest counts first", test_spaceSavingTopK_largestFirst);
+    endDescribe();
+
+    describe("importMacQueue()");
+      test("should carry the error of each station over", test_importMacQueue_carriesErrorOver);
+    endDescribe();
+
+    describe("dequeueMacFromPartition()");
+      test("should only return stations of the requested network", test_dequeueMacFromPartition_onlyThatNetwork);
+    endDescribe();
+  endDescribe();
+}
\ No newline at end of file
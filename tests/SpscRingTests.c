@@ -0,0 +1,134 @@
+#include <stdint.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "SpscRing.h"
+
+#define TEST_RING_SIZE  8
+
+SpscRing   testRing;
+MacRecord  pushedRecords[TEST_RING_SIZE * 2];
+MacRecord  poppedRecords[TEST_RING_SIZE * 2];
+MacAddress nextPushed;
+MacAddress nextPopped;
+
+/**
+ * Pushes records numbered from nextPushed on, so the order they come out in can be checked.
+ *
+ * @return (int) the number of records pushed
+ */
+int pushNumbered(int count) {
+  int recordIndex;
+  int pushed;
+
+  for(recordIndex = 0; recordIndex < count; recordIndex++) {
+    pushedRecords[recordIndex].macAddress = nextPushed + recordIndex;
+  }
+
+  pushed = spscRingPush(&testRing, pushedRecords, count);
+  nextPushed += pushed;
+
+  return pushed;
+}
+
+/**
+ * Pops up to max records and counts those that are not the next numbered record.
+ *
+ * @return (int) the number of records out of order
+ */
+int popNumbered(int max, int *popped) {
+  int recordIndex;
+  int outOfOrder = 0;
+
+  *popped = spscRingPop(&testRing, poppedRecords, max);
+  for(recordIndex = 0; recordIndex < *popped; recordIndex++) {
+    outOfOrder += poppedRecords[recordIndex].macAddress != nextPopped++;
+  }
+
+  return outOfOrder;
+}
+
+void beforeEach_spscRing() {
+  resetMemoryTracking();
+  initSpscRing(&testRing, TEST_RING_SIZE);
+  nextPushed = 1;
+  nextPopped = 1;
+}
+
+void afterEach_spscRing() {
+  destroySpscRing(&testRing);
+}
+
+void test_spscRingPop_keepsOrderAcrossWraps() {
+  int outOfOrder = 0;
+  int lost = 0;
+  int popped;
+  int round;
+
+  // Batches of 5 in a ring of 8 straddle its end on most rounds.
+  for(round = 0; round < 10; round++) {
+    lost += 5 - pushNumbered(5);
+    outOfOrder += popNumbered(5, &popped);
+    lost += 5 - popped;
+  }
+
+  expect(&outOfOrder)->to->equal(0);
+  expect(&lost)->to->equal(0);
+
+  bool wrapped = testRing.tail > 2 * TEST_RING_SIZE;
+  expect(&wrapped)->toBe->True();
+
+  int dropped = spscRingOverflows(&testRing);
+  expect(&dropped)->to->equal(0);
+}
+
+void test_spscRingPush_dropsWhatDoesNotFit() {
+  int popped;
+
+  pushNumbered(6);
+  int pushed = pushNumbered(5);
+  expect(&pushed)->to->equal(2);
+
+  int dropped = spscRingOverflows(&testRing);
+  expect(&dropped)->to->equal(3);
+
+  // The records that fit are all there, in order.
+  int outOfOrder = popNumbered(TEST_RING_SIZE * 2, &popped);
+  expect(&popped)->to->equal(TEST_RING_SIZE);
+  expect(&outOfOrder)->to->equal(0);
+
+  popped = spscRingPop(&testRing, poppedRecords, 1);
+  expect(&popped)->to->equal(0);
+}
+
+void test_spscRingOverflows_accumulates() {
+  int popped;
+
+  pushNumbered(TEST_RING_SIZE);
+  pushNumbered(4);
+  popNumbered(2, &popped);
+  pushNumbered(TEST_RING_SIZE);
+
+  // 4 dropped while full, then 6 of the 8 that followed the 2 freed slots.
+  int dropped = spscRingOverflows(&testRing);
+  expect(&dropped)->to->equal(10);
+}
+
+void addSpscRingTests() {
+  describe("SPSC Ring Tests");
+    beforeEach(beforeEach_spscRing);
+    afterEach(afterEach_spscRing);
+
+    describe("spscRingPop()");
+      test("should return records in the order pushed as the indices wrap", test_spscRingPop_keepsOrderAcrossWraps);
+    endDescribe();
+
+    describe("spscRingPush()");
+      test("should drop the records that do not fit in a full ring", test_spscRingPush_dropsWhatDoesNotFit);
+    endDescribe();
+
+    describe("spscRingOverflows()");
+      test("should count every record dropped since the ring was created", test_spscRingOverflows_accumulates);
+    endDescribe();
+  endDescribe();
+}
@@ -0,0 +1,108 @@
+#include <stdint.h>
+
+#include "TestSuite.h"
+#include "Assertions.h"
+#include "StationSlab.h"
+
+typedef struct TestRecordStruct {
+  void     *link;
+  uint64_t  value;
+} TestRecord;
+
+StationSlab testSlab;
+
+void beforeEach_stationSlab() {
+  resetMemoryTracking();
+  initStationSlab(&testSlab, sizeof(TestRecord), 0);
+}
+
+void afterEach_stationSlab() {
+  destroyStationSlab(&testSlab);
+}
+
+void test_stationSlabAlloc_reusesFreedRecord() {
+  TestRecord *first = (TestRecord *) stationSlabAlloc(&testSlab);
+  TestRecord *second = (TestRecord *) stationSlabAlloc(&testSlab);
+
+  first->value = 7;
+  second->value = 9;
+  stationSlabFree(&testSlab, first);
+
+  TestRecord *reused = (TestRecord *) stationSlabAlloc(&testSlab);
+  bool sameRecord = reused == first;
+  expect(&sameRecord)->toBe->True();
+
+  int value = reused->value;
+  expect(&value)->to->equal(0);
+
+  value = second->value;
+  expect(&value)->to->equal(9);
+
+  int allocated = testSlab.allocated;
+  expect(&allocated)->to->equal(2);
+}
+
+void test_stationSlabAlloc_growsByChunk() {
+  TestRecord *previous = NULL;
+  TestRecord *record;
+  size_t      chunkSize;
+  int         recordIndex;
+  int         scattered = 0;
+
+  previous = (TestRecord *) stationSlabAlloc(&testSlab);
+  chunkSize = testSlab.reserved;
+
+  // The records of a chunk are handed out back to back.
+  for(recordIndex = 1; recordIndex < NETFREE_SLAB_CHUNK_RECORDS; recordIndex++) {
+    record = (TestRecord *) stationSlabAlloc(&testSlab);
+    scattered += record != previous + 1;
+    previous = record;
+  }
+
+  expect(&scattered)->to->equal(0);
+
+  bool oneChunk = testSlab.reserved == chunkSize;
+  expect(&oneChunk)->toBe->True();
+
+  stationSlabAlloc(&testSlab);
+  bool twoChunks = testSlab.reserved == 2 * chunkSize;
+  expect(&twoChunks)->toBe->True();
+
+  destroyStationSlab(&testSlab);
+  int totalMemoryLeaked = totalUnfreedMemory();
+  expect(&totalMemoryLeaked)->to->equal(0);
+}
+
+void test_stationSlabAlloc_stopsAtLimit() {
+  void *records[3];
+  int   recordIndex;
+
+  initStationSlab(&testSlab, sizeof(TestRecord), 3);
+  for(recordIndex = 0; recordIndex < 3; recordIndex++) {
+    records[recordIndex] = stationSlabAlloc(&testSlab);
+  }
+
+  bool full = stationSlabAlloc(&testSlab) == NULL;
+  expect(&full)->toBe->True();
+
+  // Freeing a record makes room for one more.
+  stationSlabFree(&testSlab, records[1]);
+  bool room = stationSlabAlloc(&testSlab) != NULL;
+  expect(&room)->toBe->True();
+
+  full = stationSlabAlloc(&testSlab) == NULL;
+  expect(&full)->toBe->True();
+}
+
+void addStationSlabTests() {
+  describe("Station Slab Tests");
+    beforeEach(beforeEach_stationSlab);
+    afterEach(afterEach_stationSlab);
+
+    describe("stationSlabAlloc()");
+      test("should hand out a freed record again, zeroed", test_stationSlabAlloc_reusesFreedRecord);
+      test("should carve records out of a chunk before allocating another", test_stationSlabAlloc_growsByChunk);
+      test("should hand out no more records than the limit at once", test_stationSlabAlloc_stopsAtLimit);
+    endDescribe();
+  endDescribe();
+}
@@ -87,34 +87,6 @@ void executeEndDescribe() {
   --requiredIndentation;
 }
 
-/**
- * Executes the specified test.
- *
- * @param testCase (TestCase *) - the test case that should be executed
- */
-void executeTest(TestCase *testCase) {
-  struct timespec stopwatchStart;
-  struct timespec stopwatchStop;
-
-  currentTestDescription = testCase->description;
-
-  clock_gettime(CLOCK_MONOTONIC, &stopwatchStart);
-  testCase->test();
-  clock_gettime(CLOCK_MONOTONIC, &stopwatchStop);
-
-  double startTime = (double) stopwatchStart.tv_sec + (1.0e-9 * stopwatchStart.tv_nsec);
-  double endTime = (double) stopwatchStop.tv_sec + (1.0e-9 * stopwatchStop.tv_nsec);
-
-  int leakedMemory = totalUnfreedMemory();
-
-  printIndentation();
-  if(leakedMemory <= 0) {
-    fprintf(stderr, TC_SUCCESS_START "%s (%.5f)" TC_SUCCESS_END "\n", currentTestDescription, (endTime - startTime));
-  } else {
-    fprintf(stderr, TC_SUCCESS_START "%s (%.5f)" TC_SUCCESS_END TC_FAIL_COLOR " (%d bytes leaked)" TC_FAIL_END "\n", currentTestDescription, (endTime - startTime), leakedMemory);
-  }
-}
-
 /**
  * Runs all beforeEach() functions for the current describe block.  Since a describe block
  * inherits beforeEach() functions, this includes the beforeEach() functions of parent
@@ -144,7 +116,7 @@ void setUpTest(DescribeBlock *describeNode) {
  */
 void tearDownTest(DescribeBlock *describeNode) {
   if(describeNode->parent) {
-    setUpTest(describeNode->parent);
+    tearDownTest(describeNode->parent);
   }
 
   if(describeNode->_afterEach) {
@@ -152,6 +124,41 @@ void tearDownTest(DescribeBlock *describeNode) {
   }
 }
 
+/**
+ * Executes the specified test between the beforeEach() and afterEach() functions of its
+ * describe block.  Memory still allocated once the afterEach() functions have run is
+ * reported as leaked.
+ *
+ * @param testCase (TestCase *) - the test case that should be executed
+ * @param describeNode (DescribeBlock *) - the describe block the test belongs to
+ */
+void executeTest(TestCase *testCase, DescribeBlock *describeNode) {
+  struct timespec stopwatchStart;
+  struct timespec stopwatchStop;
+
+  currentTestDescription = testCase->description;
+
+  resetMemoryTracking();
+  setUpTest(describeNode);
+
+  clock_gettime(CLOCK_MONOTONIC, &stopwatchStart);
+  testCase->test();
+  clock_gettime(CLOCK_MONOTONIC, &stopwatchStop);
+
+  double startTime = (double) stopwatchStart.tv_sec + (1.0e-9 * stopwatchStart.tv_nsec);
+  double endTime = (double) stopwatchStop.tv_sec + (1.0e-9 * stopwatchStop.tv_nsec);
+
+  tearDownTest(describeNode);
+  int leakedMemory = totalUnfreedMemory();
+
+  printIndentation();
+  if(leakedMemory <= 0) {
+    fprintf(stderr, TC_SUCCESS_START "%s (%.5f)" TC_SUCCESS_END "\n", currentTestDescription, (endTime - startTime));
+  } else {
+    fprintf(stderr, TC_SUCCESS_START "%s (%.5f)" TC_SUCCESS_END TC_FAIL_COLOR " (%d bytes leaked)" TC_FAIL_END "\n", currentTestDescription, (endTime - startTime), leakedMemory);
+  }
+}
+
 /**
  * Traverses all tests and describe blocks under the current describe block in a preorder
  * traversal of the given describe node.
@@ -170,10 +177,7 @@ void traverseTests(DescribeBlock *testNode) {
     while(currentTest->next) {
       currentTest = currentTest->next;
 
-      setUpTest(testNode);
-      resetMemoryTracking();
-      executeTest(currentTest);
-      tearDownTest(testNode);
+      executeTest(currentTest, testNode);
     }
   }
 
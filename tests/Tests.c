@@ -1,10 +1,37 @@
 #include "TestSuite.h"
 #include "MacTests.h"
+#include "HeaderParserTests.h"
+#include "ClassifierTests.h"
+#include "MacQueueEventsTests.h"
+#include "StationSlabTests.h"
+#include "SpscRingTests.h"
+#include "MacIndexTests.h"
+#include "LogTests.h"
+#include "EventLoopTests.h"
+
+#ifdef NETFREE_SPACE_SAVING
+  #include "SpaceSavingMacQueueTests.h"
+#else
+  #include "PriorityMacQueueTests.h"
+#endif
 
 int main() {
   initTests();
 
   addMacTests();
+  addHeaderParserTests();
+  addClassifierTests();
+  addStationSlabTests();
+  addSpscRingTests();
+  addMacIndexTests();
+  addLogTests();
+  addEventLoopTests();
+#ifdef NETFREE_SPACE_SAVING
+  addSpaceSavingMacQueueTests();
+#else
+  addPriorityMacQueueTests();
+#endif
+  addMacQueueEventsTests();
 
   executeTests();
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_CLASSIFIER
+  #define _NETFREE_TESTS_CLASSIFIER
+
+  extern void addClassifierTests();
+
+#endif
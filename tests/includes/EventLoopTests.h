@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_EVENT_LOOP
+  #define _NETFREE_TESTS_EVENT_LOOP
+
+  extern void addEventLoopTests();
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_HEADER_PARSER
+  #define _NETFREE_TESTS_HEADER_PARSER
+
+  extern void addHeaderParserTests();
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_LOG
+  #define _NETFREE_TESTS_LOG
+
+  extern void addLogTests();
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_MAC_INDEX
+  #define _NETFREE_TESTS_MAC_INDEX
+
+  extern void addMacIndexTests();
+
+#endif
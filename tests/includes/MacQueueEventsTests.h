@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_MAC_QUEUE_EVENTS
+  #define _NETFREE_TESTS_MAC_QUEUE_EVENTS
+
+  extern void addMacQueueEventsTests();
+
+#endif
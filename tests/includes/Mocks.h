@@ -0,0 +1,24 @@
+#ifndef _C1MOORE_TEST_MOCKS
+  #define _C1MOORE_TEST_MOCKS
+
+  /**
+   * Functions listed in TEST_MOCKS (see the Makefile) are wrapped at link time.  A wrapper
+   * calls the mock registered for its function, if any, and the real function otherwise.
+   */
+  typedef struct MockedFunctionStruct MockedFunction;
+  struct MockedFunctionStruct {
+    char           *name;
+    void           *mock;
+    MockedFunction *next;
+  };
+
+  extern MockedFunction *mockedFunctions;
+
+  extern void  mockFunction(char *, void *);
+  extern void  resetMocks();
+  extern void *findMock(char *);
+
+  extern int __real_macEquals(char *, char *);
+  extern int __wrap_macEquals(char *, char *);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_PRIORITY_MAC_QUEUE
+  #define _NETFREE_TESTS_PRIORITY_MAC_QUEUE
+
+  extern void addPriorityMacQueueTests();
+
+#endif
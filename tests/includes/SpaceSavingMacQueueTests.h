@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_SPACE_SAVING_MAC_QUEUE
+  #define _NETFREE_TESTS_SPACE_SAVING_MAC_QUEUE
+
+  extern void addSpaceSavingMacQueueTests();
+
+#endif
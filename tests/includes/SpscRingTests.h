@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_SPSC_RING
+  #define _NETFREE_TESTS_SPSC_RING
+
+  extern void addSpscRingTests();
+
+#endif
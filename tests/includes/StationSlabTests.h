@@ -0,0 +1,6 @@
+#ifndef _NETFREE_TESTS_STATION_SLAB
+  #define _NETFREE_TESTS_STATION_SLAB
+
+  extern void addStationSlabTests();
+
+#endif
@@ -28,10 +28,12 @@
   extern void *__real_malloc  (size_t bytes);
   extern void *__real_realloc (void *ptr, size_t bytes);
   extern void *__real_calloc  (size_t nitems, size_t size);
+  extern void *__real_aligned_alloc (size_t alignment, size_t bytes);
   extern void  __real_free    (void *ptr);
   extern void *__wrap_malloc  (size_t bytes);
   extern void *__wrap_realloc (void *ptr, size_t bytes);
   extern void *__wrap_calloc  (size_t nitems, size_t size);
+  extern void *__wrap_aligned_alloc (size_t alignment, size_t bytes);
   extern void  __wrap_free    (void *ptr);
 
   /* Test Suite Functions */